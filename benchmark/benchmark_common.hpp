@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+
 #include "../external/cmd_line_parser/include/parser.hpp"
 #include "probe.hpp"
+#include "types.hpp"
 
 namespace autocomplete {
 
@@ -9,10 +13,44 @@ namespace benchmarking {
 static const uint32_t runs = 5;
 }
 
-// void tolower(std::string& str) {
-//     std::transform(str.begin(), str.end(), str.begin(),
-//                    [](unsigned char c) { return std::tolower(c); });
-// }
+template <typename Index>
+struct index_type_tag {
+    typedef Index type;
+};
+
+/*
+The index types every benchmark can be run on, by name: f is called with
+the index_type_tag of the type named by the --type argument. Returns false
+if the name is unknown.
+*/
+template <typename F>
+bool with_index_type(std::string const& type, F f) {
+    if (type == "ef_type1") {
+        f(index_type_tag<ef_autocomplete_type1>());
+    } else if (type == "ef_type2") {
+        f(index_type_tag<ef_autocomplete_type2>());
+    } else if (type == "ef_type3") {
+        f(index_type_tag<ef_autocomplete_type3>());
+    } else if (type == "ef_type4") {
+        f(index_type_tag<ef_autocomplete_type4>());
+    } else if (type == "ef_type5") {
+        f(index_type_tag<ef_autocomplete_type5>());
+    } else if (type == "ef_type1_st") {
+        f(index_type_tag<ef_autocomplete_type1_st>());
+    } else if (type == "ef_type2_st") {
+        f(index_type_tag<ef_autocomplete_type2_st>());
+    } else if (type == "ef_type3_st") {
+        f(index_type_tag<ef_autocomplete_type3_st>());
+    } else if (type == "ef_type4_st") {
+        f(index_type_tag<ef_autocomplete_type4_st>());
+    } else if (type == "ef_type5_st") {
+        f(index_type_tag<ef_autocomplete_type5_st>());
+    } else {
+        std::cerr << "unknown index type '" << type << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
 
 size_t load_queries(std::vector<std::string>& queries, uint32_t max_num_queries,
                     float percentage, std::istream& is = std::cin) {
@@ -28,12 +66,50 @@ size_t load_queries(std::vector<std::string>& queries, uint32_t max_num_queries,
         size_t end = size + std::ceil(last_token_size * percentage) + 1 +
                      1;  // retain at least one char
         for (size = query.size(); size > end; --size) query.pop_back();
-        // tolower(query);
         queries.push_back(query);
     }
     return queries.size();
 }
 
+/* the latencies of single queries, in microseconds */
+struct latencies {
+    void add(double musec) {
+        m_musec.push_back(musec);
+    }
+
+    size_t size() const {
+        return m_musec.size();
+    }
+
+    double avg() const {
+        double sum = 0.0;
+        for (auto x : m_musec) sum += x;
+        return m_musec.empty() ? 0.0 : sum / m_musec.size();
+    }
+
+    /* the p-th percentile, for p in [0,100] */
+    double percentile(double p) {
+        if (m_musec.empty()) return 0.0;
+        size_t i = std::min<size_t>(p / 100 * m_musec.size(),
+                                    m_musec.size() - 1);
+        std::nth_element(m_musec.begin(), m_musec.begin() + i, m_musec.end());
+        return m_musec[i];
+    }
+
+    void report(std::string const& what, essentials::json_lines& breakdowns) {
+        breakdowns.add(what + "_avg_musec", std::to_string(avg()));
+        breakdowns.add(what + "_p50_musec", std::to_string(percentile(50)));
+        breakdowns.add(what + "_p90_musec", std::to_string(percentile(90)));
+        breakdowns.add(what + "_p99_musec", std::to_string(percentile(99)));
+        breakdowns.add(what + "_p999_musec",
+                       std::to_string(percentile(99.9)));
+        breakdowns.add(what + "_max_musec", std::to_string(percentile(100)));
+    }
+
+private:
+    std::vector<double> m_musec;
+};
+
 void configure_parser_for_benchmarking(cmd_line_parser::parser& parser) {
     parser.add("type", "Index type.");
     parser.add("k", "top-k value.");
@@ -65,10 +141,15 @@ void configure_parser_for_benchmarking(cmd_line_parser::parser& parser) {
         breakdowns.add("num_queries", std::to_string(num_queries));            \
                                                                                \
         timer_probe probe(3);                                                  \
+        latencies query_latencies;                                             \
         for (uint32_t run = 0; run != benchmarking::runs; ++run) {             \
             for (auto const& query : queries) {                                \
+                auto start = clock_type::now();                                \
                 auto it = index.what##topk(query, k, probe);                   \
                 reported_strings += it.size();                                 \
+                query_latencies.add(std::chrono::duration<double, std::micro>( \
+                                        clock_type::now() - start)             \
+                                        .count());                             \
             }                                                                  \
         }                                                                      \
         std::cout << "#ignore: " << reported_strings << std::endl;             \
@@ -89,6 +170,7 @@ void configure_parser_for_benchmarking(cmd_line_parser::parser& parser) {
             std::to_string(musec_per_query(probe.get(0).elapsed()) +           \
                            musec_per_query(probe.get(1).elapsed()) +           \
                            musec_per_query(probe.get(2).elapsed())));          \
+        query_latencies.report("query", breakdowns);                           \
     }                                                                          \
                                                                                \
     int main(int argc, char** argv) {                                          \
@@ -108,21 +190,11 @@ void configure_parser_for_benchmarking(cmd_line_parser::parser& parser) {
                        parser.get<std::string>("num_terms_per_query"));        \
         breakdowns.add("percentage", std::to_string(keep));                    \
                                                                                \
-        if (type == "ef_type1") {                                              \
-            benchmark<ef_autocomplete_type1>(                                  \
+        bool ok = with_index_type(type, [&](auto tag) {                        \
+            benchmark<typename decltype(tag)::type>(                           \
                 index_filename, k, max_num_queries, keep, breakdowns);         \
-        } else if (type == "ef_type2") {                                       \
-            benchmark<ef_autocomplete_type2>(                                  \
-                index_filename, k, max_num_queries, keep, breakdowns);         \
-        } else if (type == "ef_type3") {                                       \
-            benchmark<ef_autocomplete_type3>(                                  \
-                index_filename, k, max_num_queries, keep, breakdowns);         \
-        } else if (type == "ef_type4") {                                       \
-            benchmark<ef_autocomplete_type4>(                                  \
-                index_filename, k, max_num_queries, keep, breakdowns);         \
-        } else {                                                               \
-            return 1;                                                          \
-        }                                                                      \
+        });                                                                    \
+        if (!ok) return 1;                                                     \
                                                                                \
         breakdowns.print();                                                    \
         return 0;                                                              \
@@ -0,0 +1,125 @@
+#include <iostream>
+
+#include "types.hpp"
+#include "delta_index.hpp"
+#include "benchmark_common.hpp"
+
+using namespace autocomplete;
+
+template <typename Index>
+double musec_per_query(Index& index, std::vector<std::string> const& queries,
+                       uint32_t k, bool conjunctive) {
+    nop_probe probe;
+    uint64_t reported_strings = 0;
+    essentials::timer_type timer;
+    timer.start();
+    for (uint32_t run = 0; run != benchmarking::runs; ++run) {
+        for (auto const& query : queries) {
+            auto it = conjunctive ? index.conjunctive_topk(query, k, probe)
+                                  : index.prefix_topk(query, k, probe);
+            reported_strings += it.size();
+        }
+    }
+    timer.stop();
+    std::cout << "#ignore: " << reported_strings << std::endl;
+    return timer.elapsed() / (benchmarking::runs * queries.size());
+}
+
+template <typename Index>
+bool benchmark(std::string const& index_filename, uint32_t k,
+               uint32_t max_num_queries, uint32_t num_insertions, float keep,
+               essentials::json_lines& breakdowns) {
+    delta_autocomplete<Index> index;
+    essentials::load(index, index_filename.c_str());
+
+    std::vector<std::string> queries;
+    uint32_t num_queries =
+        load_queries(queries, max_num_queries, keep, std::cin);
+    if (num_queries == 0) {  // the new completions are made from them
+        std::cerr << "no queries read from the standard input" << std::endl;
+        return false;
+    }
+    breakdowns.add("num_queries", std::to_string(num_queries));
+    breakdowns.add("num_insertions", std::to_string(num_insertions));
+
+    for (bool conjunctive : {false, true}) {
+        std::string what = conjunctive ? "conjunctive_" : "prefix_";
+        breakdowns.add(
+            what + "static_musec_per_query",
+            std::to_string(musec_per_query(index.static_index(), queries, k,
+                                           conjunctive)));
+    }
+
+    /* new completions: the queries followed by a new term */
+    std::vector<std::string> completions;
+    completions.reserve(num_insertions);
+    for (uint32_t i = 0; i != num_insertions; ++i) {
+        completions.push_back(queries[i % num_queries] + " new" +
+                              std::to_string(i));
+    }
+    essentials::uniform_int_rng<id_type> random_doc_id(0, num_insertions);
+
+    essentials::timer_type timer;
+    timer.start();
+    for (auto const& completion : completions) {
+        index.insert(random_doc_id.gen(), completion);
+    }
+    timer.stop();
+    breakdowns.add("insertions_per_sec",
+                   std::to_string(num_insertions / (timer.elapsed() / 1e6)));
+
+    for (bool conjunctive : {false, true}) {
+        std::string what = conjunctive ? "conjunctive_" : "prefix_";
+        breakdowns.add(what + "static_and_delta_musec_per_query",
+                       std::to_string(musec_per_query(index, queries, k,
+                                                      conjunctive)));
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    configure_parser_for_benchmarking(parser);
+    parser.add("num_insertions", "Number of completions to insert.", "-n",
+               false);
+    if (!parser.parse()) return 1;
+
+    auto type = parser.get<std::string>("type");
+    auto k = parser.get<uint32_t>("k");
+    auto index_filename = parser.get<std::string>("index_filename");
+    auto max_num_queries = parser.get<uint32_t>("max_num_queries");
+    auto keep = parser.get<float>("percentage");
+    uint32_t num_insertions = 100000;
+    if (parser.parsed("num_insertions")) {
+        num_insertions = parser.get<uint32_t>("num_insertions");
+    }
+
+    essentials::json_lines breakdowns;
+    breakdowns.new_line();
+    breakdowns.add("num_terms_per_query",
+                   parser.get<std::string>("num_terms_per_query"));
+    breakdowns.add("percentage", std::to_string(keep));
+
+    bool ok = false;
+    if (type == "ef_type1") {
+        ok = benchmark<ef_autocomplete_type1>(index_filename, k,
+                                              max_num_queries, num_insertions,
+                                              keep, breakdowns);
+    } else if (type == "ef_type2") {
+        ok = benchmark<ef_autocomplete_type2>(index_filename, k,
+                                              max_num_queries, num_insertions,
+                                              keep, breakdowns);
+    } else if (type == "ef_type3") {
+        ok = benchmark<ef_autocomplete_type3>(index_filename, k,
+                                              max_num_queries, num_insertions,
+                                              keep, breakdowns);
+    } else if (type == "ef_type4") {
+        ok = benchmark<ef_autocomplete_type4>(index_filename, k,
+                                              max_num_queries, num_insertions,
+                                              keep, breakdowns);
+    }
+    if (!ok) return 1;
+
+    breakdowns.print();
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include <iostream>
+
+#include "types.hpp"
+#include "benchmark_common.hpp"
+
+using namespace autocomplete;
+
+/* substitute, insert, delete or transpose a random byte of the last token */
+std::string add_typo(std::string s,
+                     essentials::uniform_int_rng<uint32_t>& rng) {
+    size_t begin = s.rfind(' ') + 1;  // npos + 1 == 0
+    uint32_t pos = begin + rng.gen() % (s.size() - begin);
+    char c = 'a' + rng.gen() % 26;
+    switch (rng.gen() % 4) {
+        case 0:
+            s[pos] = c;
+            break;
+        case 1:
+            s.insert(s.begin() + pos, c);
+            break;
+        case 2:
+            s.erase(s.begin() + pos);
+            break;
+        default:
+            if (pos + 1 < s.size()) {
+                std::swap(s[pos], s[pos + 1]);
+            } else {
+                s[pos] = c;
+            }
+    }
+    return s;
+}
+
+template <typename Index, typename TopK>
+double musec_per_query(Index& index, std::vector<std::string> const& queries,
+                       TopK topk) {
+    uint64_t reported_strings = 0;
+    essentials::timer_type timer;
+    timer.start();
+    for (uint32_t run = 0; run != benchmarking::runs; ++run) {
+        for (auto const& query : queries) {
+            reported_strings += topk(index, query).size();
+        }
+    }
+    timer.stop();
+    std::cout << "#ignore: " << reported_strings << std::endl;
+    return timer.elapsed() / (benchmarking::runs * queries.size());
+}
+
+/* fraction of the queries whose results contain the best
+   result of the corresponding query without typos */
+template <typename Index, typename TopK>
+double recall(Index& index, std::vector<std::string> const& queries,
+              std::vector<id_type> const& best, TopK topk) {
+    uint32_t recalled = 0;
+    uint32_t total = 0;
+    for (uint32_t i = 0; i != queries.size(); ++i) {
+        if (best[i] == global::invalid_term_id) continue;
+        ++total;
+        auto it = topk(index, queries[i]);
+        for (uint32_t j = 0; j != it.size(); ++j, ++it) {
+            if ((*it).score == best[i]) {
+                ++recalled;
+                break;
+            }
+        }
+    }
+    return total ? static_cast<double>(recalled) / total : 0.0;
+}
+
+template <typename Index>
+void benchmark(std::string const& index_filename, uint32_t k,
+               uint32_t max_num_queries, uint32_t max_edits, float keep,
+               essentials::json_lines& breakdowns) {
+    Index index;
+    essentials::load(index, index_filename.c_str());
+
+    std::vector<std::string> queries;
+    load_queries(queries, max_num_queries, keep, std::cin);
+
+    /* only the queries whose last token is long enough to allow a typo */
+    std::vector<std::string> typo_queries;
+    std::vector<std::string> clean_queries;
+    essentials::uniform_int_rng<uint32_t> rng(0, uint32_t(-1), 13);
+    for (auto const& query : queries) {
+        size_t last_token_size = query.size() - (query.rfind(' ') + 1);
+        if (last_token_size < constants::MIN_CHARS_FOR_ONE_EDIT) continue;
+        clean_queries.push_back(query);
+        typo_queries.push_back(add_typo(query, rng));
+    }
+    uint32_t num_queries = clean_queries.size();
+    breakdowns.add("num_queries", std::to_string(num_queries));
+    breakdowns.add("max_edits", std::to_string(max_edits));
+    if (num_queries == 0) return;
+
+    nop_probe probe;
+    auto exact = [&](Index& index, std::string const& query) {
+        return index.conjunctive_topk(query, k, probe);
+    };
+    auto fuzzy = [&](Index& index, std::string const& query) {
+        return index.fuzzy_conjunctive_topk(query, k, max_edits, probe);
+    };
+
+    std::vector<id_type> best;
+    best.reserve(num_queries);
+    for (auto const& query : clean_queries) {
+        auto it = exact(index, query);
+        best.push_back(it.size() ? (*it).score : global::invalid_term_id);
+    }
+
+    breakdowns.add(
+        "exact_musec_per_query",
+        std::to_string(musec_per_query(index, clean_queries, exact)));
+    breakdowns.add(
+        "fuzzy_musec_per_query",
+        std::to_string(musec_per_query(index, clean_queries, fuzzy)));
+    breakdowns.add(
+        "exact_musec_per_typo_query",
+        std::to_string(musec_per_query(index, typo_queries, exact)));
+    breakdowns.add(
+        "fuzzy_musec_per_typo_query",
+        std::to_string(musec_per_query(index, typo_queries, fuzzy)));
+    breakdowns.add("exact_recall_on_typo_queries",
+                   std::to_string(recall(index, typo_queries, best, exact)));
+    breakdowns.add("fuzzy_recall_on_typo_queries",
+                   std::to_string(recall(index, typo_queries, best, fuzzy)));
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    configure_parser_for_benchmarking(parser);
+    parser.add("max_edits", "Maximum number of typos in the last token.", "-e",
+               false);
+    if (!parser.parse()) return 1;
+
+    auto type = parser.get<std::string>("type");
+    auto k = parser.get<uint32_t>("k");
+    auto index_filename = parser.get<std::string>("index_filename");
+    auto max_num_queries = parser.get<uint32_t>("max_num_queries");
+    auto keep = parser.get<float>("percentage");
+    uint32_t max_edits = constants::MAX_FUZZY_EDITS;
+    if (parser.parsed("max_edits")) {
+        max_edits = parser.get<uint32_t>("max_edits");
+        if (max_edits > constants::MAX_FUZZY_EDITS) {
+            std::cerr << "max_edits must be at most "
+                      << constants::MAX_FUZZY_EDITS << std::endl;
+            return 1;
+        }
+    }
+
+    essentials::json_lines breakdowns;
+    breakdowns.new_line();
+    breakdowns.add("num_terms_per_query",
+                   parser.get<std::string>("num_terms_per_query"));
+    breakdowns.add("percentage", std::to_string(keep));
+
+    if (type == "ef_type1") {
+        benchmark<ef_autocomplete_type1>(index_filename, k, max_num_queries,
+                                         max_edits, keep, breakdowns);
+    } else if (type == "ef_type2") {
+        benchmark<ef_autocomplete_type2>(index_filename, k, max_num_queries,
+                                         max_edits, keep, breakdowns);
+    } else if (type == "ef_type3") {
+        benchmark<ef_autocomplete_type3>(index_filename, k, max_num_queries,
+                                         max_edits, keep, breakdowns);
+    } else if (type == "ef_type4") {
+        benchmark<ef_autocomplete_type4>(index_filename, k, max_num_queries,
+                                         max_edits, keep, breakdowns);
+    } else {
+        return 1;
+    }
+
+    breakdowns.print();
+    return 0;
+}
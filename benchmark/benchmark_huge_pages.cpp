@@ -0,0 +1,110 @@
+#include <iostream>
+
+#include "types.hpp"
+#include "huge_pages.hpp"
+#include "benchmark_common.hpp"
+#include "perf_counter.hpp"
+
+using namespace autocomplete;
+
+/* bytes of anonymous memory backed by huge pages, from /proc/self/smaps */
+uint64_t anon_huge_pages_bytes() {
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string line;
+    while (std::getline(smaps, line)) {
+        if (line.compare(0, 14, "AnonHugePages:") == 0) {
+            return std::stoull(line.substr(14)) * 1024;
+        }
+    }
+    return 0;
+}
+
+template <typename Index>
+void run(Index& index, std::vector<std::string> const& queries, uint32_t k,
+         essentials::json_lines& breakdowns) {
+    nop_probe probe;
+    auto dtlb_misses = perf_counter::dtlb_load_misses();
+    uint64_t reported_strings = 0;
+    essentials::timer_type timer;
+    timer.start();
+    dtlb_misses.start();
+    for (uint32_t run = 0; run != benchmarking::runs; ++run) {
+        for (auto const& query : queries) {
+            reported_strings += index.conjunctive_topk(query, k, probe).size();
+        }
+    }
+    dtlb_misses.stop();
+    timer.stop();
+    std::cout << "#ignore: " << reported_strings << std::endl;
+
+    double num_queries = benchmarking::runs * queries.size();
+    breakdowns.add("musec_per_query",
+                   std::to_string(timer.elapsed() / num_queries));
+    breakdowns.add("dtlb_misses_per_query",
+                   dtlb_misses.available()
+                       ? std::to_string(dtlb_misses.count() / num_queries)
+                       : "n/a");
+    breakdowns.add("anon_huge_pages_MiB",
+                   std::to_string(static_cast<double>(anon_huge_pages_bytes()) /
+                                  essentials::MiB));
+}
+
+/*
+Latency and dTLB misses of conjunctive_topk, before and after backing
+the arrays of the index with huge pages (see include/huge_pages.hpp).
+*/
+template <typename Index>
+void benchmark(std::string const& index_filename, uint32_t k,
+               uint32_t max_num_queries, float keep,
+               essentials::json_lines& breakdowns) {
+    Index index;
+    essentials::load(index, index_filename.c_str());
+
+    std::vector<std::string> queries;
+    load_queries(queries, max_num_queries, keep, std::cin);
+    breakdowns.add("num_queries", std::to_string(queries.size()));
+    if (queries.empty()) return;
+
+    breakdowns.add("huge_pages", std::string("false"));
+    run(index, queries, k, breakdowns);
+
+    auto advisor = use_huge_pages(index);
+    breakdowns.new_line();
+    breakdowns.add("huge_pages", std::string("true"));
+    breakdowns.add("advised_MiB",
+                   std::to_string(static_cast<double>(advisor.advised_bytes()) /
+                                  essentials::MiB));
+    breakdowns.add(
+        "collapsed_MiB",
+        std::to_string(static_cast<double>(advisor.collapsed_bytes()) /
+                       essentials::MiB));
+    run(index, queries, k, breakdowns);
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    configure_parser_for_benchmarking(parser);
+    if (!parser.parse()) return 1;
+
+    auto type = parser.get<std::string>("type");
+    auto k = parser.get<uint32_t>("k");
+    auto index_filename = parser.get<std::string>("index_filename");
+    auto max_num_queries = parser.get<uint32_t>("max_num_queries");
+    auto keep = parser.get<float>("percentage");
+
+    essentials::json_lines breakdowns;
+    breakdowns.new_line();
+    breakdowns.add("num_terms_per_query",
+                   parser.get<std::string>("num_terms_per_query"));
+    breakdowns.add("percentage", std::to_string(keep));
+
+    bool ok = with_index_type(type, [&](auto tag) {
+        benchmark<typename decltype(tag)::type>(index_filename, k,
+                                                max_num_queries, keep,
+                                                breakdowns);
+    });
+    if (!ok) return 1;
+
+    breakdowns.print();
+    return 0;
+}
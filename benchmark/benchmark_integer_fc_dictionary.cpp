@@ -22,6 +22,32 @@ void perf_test(Dictionary const& dict, std::vector<id_type> const& queries) {
 
     std::cout << "extract: " << (timer.average() * 1000.0) / queries.size()
               << " [ns/string]" << std::endl;
+
+    // locate the strings back, the last term being the suffix range
+    std::vector<completion_type> prefixes;
+    std::vector<range> suffixes;
+    prefixes.reserve(queries.size());
+    for (auto const& id : queries) {
+        uint8_t string_len = dict.extract(id, decoded);
+        prefixes.emplace_back(decoded.begin(),
+                              decoded.begin() + string_len - 1);
+        id_type last = decoded[string_len - 1];
+        suffixes.push_back({last, last});
+    }
+
+    timer.reset();
+    for (uint32_t i = 0; i != benchmarking::runs; ++i) {
+        timer.start();
+        for (uint32_t k = 0; k != prefixes.size(); ++k) {
+            range r = dict.locate_prefix(prefixes[k], suffixes[k]);
+            essentials::do_not_optimize_away(r.begin);
+        }
+        timer.stop();
+    }
+
+    std::cout << "locate_prefix: "
+              << (timer.average() * 1000.0) / queries.size() << " [ns/string]"
+              << std::endl;
 }
 
 #define exe(BUCKET_SIZE)                                                     \
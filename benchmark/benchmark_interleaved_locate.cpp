@@ -0,0 +1,123 @@
+#include <iostream>
+
+#include "types.hpp"
+#include "interleaved_locate.hpp"
+#include "benchmark_common.hpp"
+
+using namespace autocomplete;
+
+/*
+Time per query of locating the suffix of the queries in the dictionary
+and then their prefix in the trie, one query after the other, against
+the same searches run by groups of queries interleaved as coroutines
+(see interleaved_locate.hpp), whose results must be the same.
+*/
+struct query_type {
+    std::string string;
+    byte_range suffix;
+    completion_type prefix;
+};
+
+bool same(range const& l, range const& r) {
+    return l.begin == r.begin and l.end == r.end;
+}
+
+template <typename Locate>
+double musec_per_query(uint64_t num_queries, Locate locate) {
+    essentials::timer_type timer;
+    timer.start();
+    for (uint32_t run = 0; run != benchmarking::runs; ++run) locate();
+    timer.stop();
+    return timer.elapsed() / (benchmarking::runs * num_queries);
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("collection_basename", "Collection basename.");
+    parser.add("num_terms_per_query", "Number of terms per query.");
+    parser.add("max_num_queries", "Maximum number of queries to execute.");
+    parser.add("percentage",
+               "A float in [0,1] specifying how much we keep of the last token "
+               "in a query.");
+    if (!parser.parse()) return 1;
+
+    parameters params;
+    params.collection_basename = parser.get<std::string>("collection_basename");
+    params.load();
+
+    auto max_num_queries = parser.get<uint32_t>("max_num_queries");
+    auto keep = parser.get<float>("percentage");
+
+    fc_dictionary_type dict;
+    {
+        fc_dictionary_type::builder builder(params);
+        builder.build(dict);
+    }
+    ef_completion_trie trie;
+    {
+        ef_completion_trie::builder builder(params);
+        builder.build(trie);
+    }
+
+    std::vector<std::string> strings;
+    load_queries(strings, max_num_queries, keep, std::cin);
+    std::vector<query_type> queries(strings.size());
+    for (size_t i = 0; i != strings.size(); ++i) {
+        auto& q = queries[i];
+        q.string = strings[i];
+        parse(dict, q.string, q.prefix, q.suffix, true);
+    }
+    uint64_t num_queries = queries.size();
+
+    essentials::json_lines breakdowns;
+    breakdowns.new_line();
+    breakdowns.add("num_terms_per_query",
+                   parser.get<std::string>("num_terms_per_query"));
+    breakdowns.add("percentage", std::to_string(keep));
+    breakdowns.add("num_queries", std::to_string(num_queries));
+    if (queries.empty()) {
+        breakdowns.print();
+        return 0;
+    }
+
+    std::vector<range> suffix_lex_ranges(num_queries);
+    std::vector<range> expected(num_queries);
+    double sequential = musec_per_query(num_queries, [&] {
+        for (uint64_t i = 0; i != num_queries; ++i) {
+            auto const& q = queries[i];
+            suffix_lex_ranges[i] = dict.locate_prefix(q.suffix);
+            expected[i] = trie.locate_prefix(q.prefix, suffix_lex_ranges[i]);
+        }
+    });
+    breakdowns.add("sequential_musec_per_query", std::to_string(sequential));
+
+    std::vector<range> got_suffix_lex_ranges(num_queries);
+    std::vector<range> got(num_queries);
+    for (uint32_t group_size : {1, 2, 4, 8, 16, 32}) {
+        double interleaved = musec_per_query(num_queries, [&] {
+            interleave(num_queries, group_size, [&](uint64_t i) {
+                return locate_prefix(dict, queries[i].suffix,
+                                     got_suffix_lex_ranges[i]);
+            });
+            interleave(num_queries, group_size, [&](uint64_t i) {
+                return locate_prefix(trie, queries[i].prefix,
+                                     got_suffix_lex_ranges[i], got[i]);
+            });
+        });
+        for (uint64_t i = 0; i != num_queries; ++i) {
+            if (!same(got_suffix_lex_ranges[i], suffix_lex_ranges[i]) or
+                !same(got[i], expected[i])) {
+                std::cerr << "error: different result for '"
+                          << queries[i].string << "' with groups of "
+                          << group_size << " queries" << std::endl;
+                return 1;
+            }
+        }
+        breakdowns.add("interleaved_musec_per_query_g=" +
+                           std::to_string(group_size),
+                       std::to_string(interleaved));
+    }
+
+    breakdowns.print();
+    return 0;
+}
@@ -88,6 +88,9 @@ int main(int argc, char** argv) {
     if (type == "trie") {
         benchmark<ef_completion_trie>(params, queries, num_queries,
                                       num_terms_per_query, keep);
+    } else if (type == "interleaved_trie") {
+        benchmark<interleaved_completion_trie>(params, queries, num_queries,
+                                               num_terms_per_query, keep);
     } else if (type == "fc") {
         // benchmark<integer_fc_dictionary<4>>(params, queries, num_queries,
         //                                     num_terms_per_query, keep);
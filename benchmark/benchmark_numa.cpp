@@ -0,0 +1,140 @@
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "types.hpp"
+#include "numa.hpp"
+#include "benchmark_common.hpp"
+
+using namespace autocomplete;
+
+/*
+Throughput of conjunctive_topk with many threads sharing the replicas of
+the index, each thread with its own query_context. Thread i runs on node
+i % num_nodes. With placement "single_node", a single replica is loaded
+by a thread on node 0, as done by a server loading its index at startup,
+and shared by all the threads, so that the threads on the other nodes
+read remote memory; with placement "local", a replica per node is loaded
+by a thread bound to the node, so that the pages of the replica are
+allocated on that node, and shared by the threads of the node.
+*/
+template <typename Index>
+void run(std::string const& index_filename, uint32_t k,
+         std::vector<std::string> const& queries, uint32_t num_threads,
+         bool local, numa_topology const& numa,
+         essentials::json_lines& breakdowns) {
+    std::vector<std::unique_ptr<Index>> replicas(local ? numa.num_nodes()
+                                                       : 1);
+    auto node = [&](uint32_t i) { return i % numa.num_nodes(); };
+
+    if (local) {
+        numa.for_each_node([&](uint32_t node) {
+            replicas[node].reset(new Index());
+            essentials::load(*replicas[node], index_filename.c_str());
+        });
+    } else {
+        cpu_set_t affinity;
+        sched_getaffinity(0, sizeof(affinity), &affinity);
+        numa.bind_to_node(0);
+        replicas[0].reset(new Index());
+        essentials::load(*replicas[0], index_filename.c_str());
+        sched_setaffinity(0, sizeof(affinity), &affinity);
+    }
+
+    std::vector<uint64_t> reported_strings(num_threads, 0);
+    essentials::timer_type timer;
+    timer.start();
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i != num_threads; ++i) {
+        workers.emplace_back([&, i] {
+            numa.bind_to_node(node(i));
+            Index const& index = *replicas[local ? node(i) : 0];
+            typename Index::query_context ctx;
+            nop_probe probe;
+            for (uint32_t run = 0; run != benchmarking::runs; ++run) {
+                for (auto const& query : queries) {
+                    reported_strings[i] +=
+                        index.conjunctive_topk(ctx, query, k, probe).size();
+                }
+            }
+        });
+    }
+    for (auto& t : workers) t.join();
+    timer.stop();
+    uint64_t total = 0;
+    for (auto r : reported_strings) total += r;
+    std::cout << "#ignore: " << total << std::endl;
+
+    double num_queries =
+        static_cast<double>(benchmarking::runs) * queries.size() * num_threads;
+    breakdowns.add("placement",
+                   std::string(local ? "local" : "single_node"));
+    breakdowns.add("num_replicas", std::to_string(replicas.size()));
+    breakdowns.add("queries_per_sec",
+                   std::to_string(num_queries / (timer.elapsed() / 1000000)));
+}
+
+template <typename Index>
+void benchmark(std::string const& index_filename, uint32_t k,
+               uint32_t max_num_queries, float keep, uint32_t num_threads,
+               essentials::json_lines& breakdowns) {
+    numa_topology numa;
+    std::vector<std::string> queries;
+    load_queries(queries, max_num_queries, keep, std::cin);
+    breakdowns.add("num_queries", std::to_string(queries.size()));
+    breakdowns.add("num_threads", std::to_string(num_threads));
+    breakdowns.add("num_nodes", std::to_string(numa.num_nodes()));
+    if (queries.empty()) return;
+
+    run<Index>(index_filename, k, queries, num_threads, false, numa,
+               breakdowns);
+    breakdowns.new_line();
+    run<Index>(index_filename, k, queries, num_threads, true, numa,
+               breakdowns);
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    configure_parser_for_benchmarking(parser);
+    parser.add("num_threads",
+               "Number of querying threads (default: one per CPU).", "-t",
+               false);
+    if (!parser.parse()) return 1;
+
+    auto type = parser.get<std::string>("type");
+    auto k = parser.get<uint32_t>("k");
+    auto index_filename = parser.get<std::string>("index_filename");
+    auto max_num_queries = parser.get<uint32_t>("max_num_queries");
+    auto keep = parser.get<float>("percentage");
+    uint32_t num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    if (parser.parsed("num_threads")) {
+        num_threads = parser.get<uint32_t>("num_threads");
+        if (num_threads == 0) {
+            std::cerr << "num_threads must be at least 1" << std::endl;
+            return 1;
+        }
+    }
+
+    essentials::json_lines breakdowns;
+    breakdowns.new_line();
+    breakdowns.add("num_terms_per_query",
+                   parser.get<std::string>("num_terms_per_query"));
+    breakdowns.add("percentage", std::to_string(keep));
+
+    /* the types built on autocomplete can be shared by threads */
+    if (type == "ef_type1") {
+        benchmark<ef_autocomplete_type1>(index_filename, k, max_num_queries,
+                                         keep, num_threads, breakdowns);
+    } else if (type == "ef_type5") {
+        benchmark<ef_autocomplete_type5>(index_filename, k, max_num_queries,
+                                         keep, num_threads, breakdowns);
+    } else {
+        std::cerr << "type '" << type
+                  << "' cannot be shared by threads: ef_type1 or ef_type5 only"
+                  << std::endl;
+        return 1;
+    }
+
+    breakdowns.print();
+    return 0;
+}
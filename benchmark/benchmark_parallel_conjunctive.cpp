@@ -0,0 +1,115 @@
+#include <iostream>
+#include <thread>
+
+#include "types.hpp"
+#include "benchmark_common.hpp"
+
+using namespace autocomplete;
+
+/*
+Latency of conjunctive_topk with the heavy queries split into segments
+of doc_ids searched by a pool of threads (see segmented_search.hpp),
+against the latency of the same queries searched by a single thread.
+*/
+template <typename Index>
+double musec_per_query(Index& index, uint32_t k,
+                       std::vector<std::string> const& queries) {
+    nop_probe probe;
+    uint64_t reported_strings = 0;
+    essentials::timer_type timer;
+    timer.start();
+    for (uint32_t run = 0; run != benchmarking::runs; ++run) {
+        for (auto const& query : queries) {
+            reported_strings += index.conjunctive_topk(query, k, probe).size();
+        }
+    }
+    timer.stop();
+    std::cout << "#ignore: " << reported_strings << std::endl;
+    return timer.elapsed() / (benchmarking::runs * queries.size());
+}
+
+template <typename Index>
+void benchmark(Index& index, uint32_t k, uint32_t max_num_queries, float keep,
+               intra_query_parallelism const& parallelism,
+               essentials::json_lines& breakdowns) {
+    std::vector<std::string> queries;
+    load_queries(queries, max_num_queries, keep, std::cin);
+    breakdowns.add("num_queries", std::to_string(queries.size()));
+    breakdowns.add("num_threads",
+                   std::to_string(parallelism.pool->num_threads()));
+    breakdowns.add("num_segments", std::to_string(parallelism.num_segments));
+    breakdowns.add("min_candidates",
+                   std::to_string(parallelism.min_candidates));
+    if (queries.empty()) return;
+
+    double sequential = musec_per_query(index, k, queries);
+    index.set_parallelism(parallelism);
+    double parallel = musec_per_query(index, k, queries);
+    breakdowns.add("heavy_queries",
+                   std::to_string(index.parallel_queries() /
+                                  benchmarking::runs));
+    breakdowns.add("sequential_musec_per_query", std::to_string(sequential));
+    breakdowns.add("parallel_musec_per_query", std::to_string(parallel));
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    configure_parser_for_benchmarking(parser);
+    parser.add("num_threads",
+               "Number of threads of the pool, besides the querying one "
+               "(default: one per CPU, less one).",
+               "-t", false);
+    parser.add("num_segments",
+               "Number of segments of a heavy query (default: 4 per thread).",
+               "-s", false);
+    parser.add("min_candidates",
+               "Estimated number of candidates of a heavy query "
+               "(default: 10000).",
+               "-m", false);
+    if (!parser.parse()) return 1;
+
+    auto type = parser.get<std::string>("type");
+    auto k = parser.get<uint32_t>("k");
+    auto index_filename = parser.get<std::string>("index_filename");
+    auto max_num_queries = parser.get<uint32_t>("max_num_queries");
+    auto keep = parser.get<float>("percentage");
+    uint32_t num_threads =
+        std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    if (parser.parsed("num_threads")) {
+        num_threads = parser.get<uint32_t>("num_threads");
+    }
+    uint32_t num_segments = 4 * (num_threads + 1);
+    if (parser.parsed("num_segments")) {
+        num_segments = parser.get<uint32_t>("num_segments");
+    }
+    uint64_t min_candidates = 10000;
+    if (parser.parsed("min_candidates")) {
+        min_candidates = parser.get<uint64_t>("min_candidates");
+    }
+    intra_query_parallelism parallelism(
+        std::make_shared<search_pool>(num_threads), num_segments,
+        min_candidates);
+
+    essentials::json_lines breakdowns;
+    breakdowns.new_line();
+    breakdowns.add("num_terms_per_query",
+                   parser.get<std::string>("num_terms_per_query"));
+    breakdowns.add("percentage", std::to_string(keep));
+
+    if (type == "ef_type3") {
+        ef_autocomplete_type3 index;
+        essentials::load(index, index_filename.c_str());
+        benchmark(index, k, max_num_queries, keep, parallelism, breakdowns);
+    } else if (type == "ef_type4") {
+        ef_autocomplete_type4 index;
+        essentials::load(index, index_filename.c_str());
+        benchmark(index, k, max_num_queries, keep, parallelism, breakdowns);
+    } else {
+        std::cerr << "only ef_type3 and ef_type4 split heavy queries"
+                  << std::endl;
+        return 1;
+    }
+
+    breakdowns.print();
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <numeric>
+
+#include "types.hpp"
+#include "benchmark_common.hpp"
+
+using namespace autocomplete;
+
+/*
+Microbenchmark of the RMQ-based top-k of unsorted_list, i.e., of prefix_topk
+once the range of the completions has been located: report the k smallest
+values of random ranges whose size goes from 10^2 to the size of the list,
+by powers of ten, for each RMQ structure.
+*/
+template <typename RMQ>
+void benchmark(std::string const& rmq_name, std::vector<id_type> const& values,
+               uint32_t k, uint32_t num_queries,
+               essentials::json_lines& breakdowns) {
+    uint64_t num_values = values.size();
+    unsorted_list<RMQ> list;
+    list.build(values);
+
+    std::vector<id_type> topk(constants::MAX_K);
+    essentials::uniform_int_rng<uint64_t> rng(0, num_values - 1, 13);
+    for (uint64_t size = 100; size <= num_values; size *= 10) {
+        std::vector<range> ranges;
+        ranges.reserve(num_queries);
+        for (uint32_t i = 0; i != num_queries; ++i) {
+            uint64_t begin = rng.gen() % (num_values - size + 1);
+            ranges.push_back({begin, begin + size});
+        }
+
+        uint64_t reported = 0;
+        essentials::timer_type timer;
+        timer.start();
+        for (uint32_t run = 0; run != benchmarking::runs; ++run) {
+            for (auto r : ranges) reported += list.topk(r, k, topk);
+        }
+        timer.stop();
+        std::cout << "#ignore: " << reported << std::endl;
+
+        breakdowns.new_line();
+        breakdowns.add("rmq", rmq_name);
+        breakdowns.add("num_values", std::to_string(num_values));
+        breakdowns.add("bits_per_value",
+                       std::to_string(8.0 * list.bytes() / num_values));
+        breakdowns.add("k", std::to_string(k));
+        breakdowns.add("range_size", std::to_string(size));
+        breakdowns.add(
+            "nanosec_per_query",
+            std::to_string(1000 * timer.elapsed() /
+                           (benchmarking::runs * num_queries)));
+    }
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("k", "top-k value.");
+    parser.add("rmq",
+               "RMQ structure: 'cartesian_tree' or 'sparse_table' "
+               "(default both).",
+               "-r", false);
+    parser.add("num_values", "Number of values in the list (default 10^7).",
+               "-n", false);
+    parser.add("num_queries", "Number of ranges per size (default 10^5).",
+               "-q", false);
+    if (!parser.parse()) return 1;
+
+    auto k = parser.get<uint32_t>("k");
+    std::string rmq = "";
+    uint64_t num_values = 10000000;
+    uint32_t num_queries = 100000;
+    if (parser.parsed("rmq")) rmq = parser.get<std::string>("rmq");
+    if (parser.parsed("num_values")) {
+        num_values = parser.get<uint64_t>("num_values");
+    }
+    if (parser.parsed("num_queries")) {
+        num_queries = parser.get<uint32_t>("num_queries");
+    }
+    if (k == 0 or k > constants::MAX_K) {
+        std::cerr << "k must be in [1," << constants::MAX_K << "]"
+                  << std::endl;
+        return 1;
+    }
+    if (num_values < 100) {
+        std::cerr << "the list must have at least 100 values" << std::endl;
+        return 1;
+    }
+
+    /* a random permutation of the doc_ids, as for the completions */
+    std::vector<id_type> values(num_values);
+    std::iota(values.begin(), values.end(), 0);
+    std::shuffle(values.begin(), values.end(), std::mt19937_64(13));
+
+    essentials::json_lines breakdowns;
+    if (rmq == "" or rmq == "cartesian_tree") {
+        benchmark<cartesian_tree>("cartesian_tree", values, k, num_queries,
+                                  breakdowns);
+    }
+    if (rmq == "" or rmq == "sparse_table") {
+        benchmark<sparse_table_rmq>("sparse_table", values, k, num_queries,
+                                    breakdowns);
+    }
+
+    breakdowns.print();
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "types.hpp"
+#include "benchmark_common.hpp"
+
+using namespace autocomplete;
+
+/*
+Replay of typing sessions: every completion read from the input is typed
+one character at a time, i.e., one UTF-8 code point as read by the
+normaliser, and every keystroke issues the query made of the characters
+typed so far, e.g., "n", "ne", "new", "new ", "new y", ...
+The latency of the queries is reported by position of the keystroke in
+the session and by session, i.e., summed over the keystrokes of a session.
+With a mean inter-key delay, the sessions wait a random time between two
+keystrokes, as a user does, so that the queries find the caches as left
+by the idle time rather than by the previous query.
+*/
+
+template <typename Index>
+void benchmark(std::string const& index_filename, uint32_t k, bool prefix,
+               std::vector<std::string> const& sessions, double delay_millisec,
+               essentials::json_lines& breakdowns) {
+    Index index;
+    essentials::load(index, index_filename.c_str());
+
+    /* inter-key delays are log-normal, with the given mean */
+    const double sigma = 0.5;
+    std::mt19937 rng(13);
+    std::lognormal_distribution<double> delay(
+        std::log(std::max(delay_millisec, 1e-3)) - sigma * sigma / 2, sigma);
+
+    uint32_t runs = delay_millisec > 0 ? 1 : benchmarking::runs;
+    std::vector<latencies> by_position(constants::MAX_NUM_CHARS_PER_QUERY);
+    latencies keystrokes;
+    latencies by_session;
+    uint64_t reported_strings = 0;
+    nop_probe probe;
+    std::string query;
+
+    for (uint32_t run = 0; run != runs; ++run) {
+        for (auto const& session : sessions) {
+            double session_musec = 0.0;
+            auto begin = reinterpret_cast<uint8_t const*>(session.data());
+            auto end = begin + session.size();
+            size_t bytes = 0;
+            for (size_t i = 1;
+                 i <= by_position.size() and bytes != session.size(); ++i) {
+                if (delay_millisec > 0 and i > 1) {
+                    std::this_thread::sleep_for(
+                        std::chrono::duration<double, std::milli>(delay(rng)));
+                }
+                bytes += normaliser::char_length(begin + bytes, end);
+                query.assign(session, 0, bytes);
+                auto start = clock_type::now();
+                auto it = prefix ? index.prefix_topk(query, k, probe)
+                                 : index.conjunctive_topk(query, k, probe);
+                double musec = std::chrono::duration<double, std::micro>(
+                                   clock_type::now() - start)
+                                   .count();
+                reported_strings += it.size();
+                by_position[i - 1].add(musec);
+                keystrokes.add(musec);
+                session_musec += musec;
+            }
+            by_session.add(session_musec);
+        }
+    }
+    std::cout << "#ignore: " << reported_strings << std::endl;
+
+    breakdowns.add("num_sessions", std::to_string(sessions.size()));
+    breakdowns.add("num_keystrokes", std::to_string(keystrokes.size() / runs));
+    keystrokes.report("keystroke", breakdowns);
+    by_session.report("session", breakdowns);
+    for (size_t i = 0; i != by_position.size(); ++i) {
+        if (by_position[i].size() == 0) break;
+        breakdowns.new_line();
+        breakdowns.add("keystroke_position", std::to_string(i + 1));
+        breakdowns.add("num_keystrokes",
+                       std::to_string(by_position[i].size() / runs));
+        by_position[i].report("keystroke", breakdowns);
+    }
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("type", "Index type.");
+    parser.add("k", "top-k value.");
+    parser.add("index_filename", "Index filename.");
+    parser.add("max_num_sessions",
+               "Maximum number of completions, read from the standard input, "
+               "to type.");
+    parser.add("query_type",
+               "'conjunctive' (default) or 'prefix' top-k queries.", "-q",
+               false);
+    parser.add("delay",
+               "Mean delay between two keystrokes, in milliseconds "
+               "(default: 0, i.e., no delay).",
+               "-d", false);
+    if (!parser.parse()) return 1;
+
+    auto type = parser.get<std::string>("type");
+    auto k = parser.get<uint32_t>("k");
+    auto index_filename = parser.get<std::string>("index_filename");
+    auto max_num_sessions = parser.get<uint32_t>("max_num_sessions");
+    std::string query_type = "conjunctive";
+    if (parser.parsed("query_type")) {
+        query_type = parser.get<std::string>("query_type");
+    }
+    if (query_type != "conjunctive" and query_type != "prefix") {
+        std::cerr << "unknown query type '" << query_type << "'" << std::endl;
+        return 1;
+    }
+    bool prefix = query_type == "prefix";
+    double delay_millisec = 0.0;
+    if (parser.parsed("delay")) delay_millisec = parser.get<float>("delay");
+
+    std::vector<std::string> sessions;
+    std::string completion;
+    while (sessions.size() != max_num_sessions and
+           std::getline(std::cin, completion)) {
+        if (!completion.empty()) sessions.push_back(completion);
+    }
+
+    essentials::json_lines breakdowns;
+    breakdowns.new_line();
+    breakdowns.add("query_type", query_type);
+    breakdowns.add("delay_millisec", std::to_string(delay_millisec));
+
+    bool ok = with_index_type(type, [&](auto tag) {
+        benchmark<typename decltype(tag)::type>(index_filename, k, prefix,
+                                                sessions, delay_millisec,
+                                                breakdowns);
+    });
+    if (!ok) return 1;
+
+    breakdowns.print();
+    return 0;
+}
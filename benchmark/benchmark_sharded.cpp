@@ -0,0 +1,165 @@
+#include <chrono>
+#include <iostream>
+
+#include "types.hpp"
+#include "sharded_autocomplete.hpp"
+#include "benchmark_common.hpp"
+
+using namespace autocomplete;
+
+/*
+The cost of the fan-out of sharded_autocomplete: the time per query of
+the sharded index is compared with the time of its slowest shard alone,
+i.e., the time of the query if the shards ran in parallel with no cost
+to post the query, wait for the shards and merge their results. The
+shards are also timed one after the other, as by a single thread.
+*/
+template <typename Index>
+void benchmark(std::string const& shards_basename, uint32_t num_shards,
+               uint32_t k, bool prefix, uint32_t max_num_queries, float keep,
+               std::string const& index_filename,
+               essentials::json_lines& breakdowns) {
+    sharded_autocomplete<Index> sharded;
+    for (uint32_t i = 0; i != num_shards; ++i) {
+        auto basename = shards_basename + "." + std::to_string(i);
+        sharded.add_shard(basename + ".bin",
+                          load_shard_doc_ids(basename + ".ids"));
+    }
+
+    std::vector<std::string> queries;
+    uint32_t num_queries =
+        load_queries(queries, max_num_queries, keep, std::cin);
+    breakdowns.add("num_queries", std::to_string(num_queries));
+    breakdowns.add("num_shards", std::to_string(num_shards));
+    breakdowns.add("index_bytes", std::to_string(sharded.bytes()));
+    if (queries.empty()) return;
+
+    auto musec_per_query = [&](double time) {
+        return time / (benchmarking::runs * num_queries);
+    };
+    auto topk = [&](auto& index, std::string const& query, auto& probe) {
+        return prefix ? index.prefix_topk(query, k, probe)
+                      : index.conjunctive_topk(query, k, probe);
+    };
+
+    uint64_t reported_strings = 0;
+    timer_probe probe(3);
+    essentials::timer_type timer;
+    timer.start();
+    for (uint32_t run = 0; run != benchmarking::runs; ++run) {
+        for (auto const& query : queries) {
+            reported_strings += topk(sharded, query, probe).size();
+        }
+    }
+    timer.stop();
+    double sharded_musec = musec_per_query(timer.elapsed());
+
+    typedef std::chrono::high_resolution_clock clock_type;
+    double slowest = 0.0;
+    double all = 0.0;
+    nop_probe nop;
+    for (uint32_t run = 0; run != benchmarking::runs; ++run) {
+        for (auto const& query : queries) {
+            double max = 0.0;
+            for (uint32_t i = 0; i != num_shards; ++i) {
+                auto start = clock_type::now();
+                reported_strings += topk(sharded.shard_index(i), query, nop)
+                                        .size();
+                double elapsed = std::chrono::duration<double, std::micro>(
+                                     clock_type::now() - start)
+                                     .count();
+                max = std::max(max, elapsed);
+                all += elapsed;
+            }
+            slowest += max;
+        }
+    }
+
+    if (!index_filename.empty()) {
+        Index index;
+        essentials::load(index, index_filename.c_str());
+        essentials::timer_type timer;
+        timer.start();
+        for (uint32_t run = 0; run != benchmarking::runs; ++run) {
+            for (auto const& query : queries) {
+                reported_strings += topk(index, query, nop).size();
+            }
+        }
+        timer.stop();
+        breakdowns.add("unsharded_musec_per_query",
+                       std::to_string(musec_per_query(timer.elapsed())));
+    }
+    std::cout << "#ignore: " << reported_strings << std::endl;
+
+    breakdowns.add("sharded_musec_per_query", std::to_string(sharded_musec));
+    breakdowns.add(
+        "scatter_gather_musec_per_query",
+        std::to_string(musec_per_query(probe.get(1).elapsed())));
+    breakdowns.add(
+        "merge_musec_per_query",
+        std::to_string(musec_per_query(probe.get(2).elapsed())));
+    breakdowns.add("slowest_shard_musec_per_query",
+                   std::to_string(musec_per_query(slowest)));
+    breakdowns.add("sequential_shards_musec_per_query",
+                   std::to_string(musec_per_query(all)));
+    breakdowns.add("fan_out_overhead_musec_per_query",
+                   std::to_string(sharded_musec - musec_per_query(slowest)));
+}
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("type", "Index type of the shards.");
+    parser.add("k", "top-k value.");
+    parser.add("shards_basename",
+               "Basename of the shards, as given to script/build_shards.sh.");
+    parser.add("num_shards", "Number of shards.");
+    parser.add("num_terms_per_query", "Number of terms per query.");
+    parser.add("max_num_queries", "Maximum number of queries to execute.");
+    parser.add("percentage",
+               "A float in [0,1] specifying how much we keep of the last token "
+               "in a query: n x 100 <=> n%, for n in [0,1].");
+    parser.add("query_type",
+               "'conjunctive' (default) or 'prefix' top-k queries.", "-q",
+               false);
+    parser.add("index_filename",
+               "Index of the whole collection, to be timed as well.", "-i",
+               false);
+    if (!parser.parse()) return 1;
+
+    auto type = parser.get<std::string>("type");
+    auto k = parser.get<uint32_t>("k");
+    auto shards_basename = parser.get<std::string>("shards_basename");
+    auto num_shards = parser.get<uint32_t>("num_shards");
+    auto max_num_queries = parser.get<uint32_t>("max_num_queries");
+    auto keep = parser.get<float>("percentage");
+    std::string query_type = "conjunctive";
+    if (parser.parsed("query_type")) {
+        query_type = parser.get<std::string>("query_type");
+    }
+    if (query_type != "conjunctive" and query_type != "prefix") {
+        std::cerr << "unknown query type '" << query_type << "'" << std::endl;
+        return 1;
+    }
+    bool prefix = query_type == "prefix";
+    std::string index_filename;
+    if (parser.parsed("index_filename")) {
+        index_filename = parser.get<std::string>("index_filename");
+    }
+
+    essentials::json_lines breakdowns;
+    breakdowns.new_line();
+    breakdowns.add("num_terms_per_query",
+                   parser.get<std::string>("num_terms_per_query"));
+    breakdowns.add("percentage", std::to_string(keep));
+    breakdowns.add("query_type", query_type);
+
+    bool ok = with_index_type(type, [&](auto tag) {
+        benchmark<typename decltype(tag)::type>(
+            shards_basename, num_shards, k, prefix, max_num_queries, keep,
+            index_filename, breakdowns);
+    });
+    if (!ok) return 1;
+
+    breakdowns.print();
+    return 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace autocomplete {
+
+/*
+A hardware event of the calling thread, read with perf_event_open(2).
+The counter is not available if the kernel does not expose the event,
+e.g., in a virtual machine, or if /proc/sys/kernel/perf_event_paranoid
+forbids it: then available() is false and count() is always 0.
+*/
+struct perf_counter {
+    perf_counter(uint32_t type, uint64_t config) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    perf_counter(perf_counter const&) = delete;
+
+    ~perf_counter() {
+        if (available()) close(m_fd);
+    }
+
+    /* load misses of the data TLB */
+    static perf_counter dtlb_load_misses() {
+        return perf_counter(PERF_TYPE_HW_CACHE,
+                            PERF_COUNT_HW_CACHE_DTLB |
+                                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    }
+
+    bool available() const {
+        return m_fd >= 0;
+    }
+
+    void start() {
+        if (!available()) return;
+        ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    void stop() {
+        if (available()) ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    uint64_t count() const {
+        uint64_t value = 0;
+        if (available() and read(m_fd, &value, sizeof(value)) != 8) value = 0;
+        return value;
+    }
+
+private:
+    int m_fd;
+};
+
+}  // namespace autocomplete
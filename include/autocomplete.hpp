@@ -7,14 +7,65 @@
 
 namespace autocomplete {
 
+/*
+The candidates of the conjunctive step, i.e., the doc_ids of the
+intersection of the prefix terms, are checked against the forward index,
+unless the Strategy of autocomplete says to use_heap for the query: then
+they are checked against a min-heap of the posting lists of the suffix
+range, as in autocomplete3 (see autocomplete5.hpp).
+*/
+struct forward_strategy {
+    template <typename InvertedIndex, typename Range>
+    bool use_heap(InvertedIndex const&, completion_type const&, Range const&,
+                  uint32_t const) const {
+        return false;
+    }
+};
+
 template <typename Completions, typename Dictionary, typename InvertedIndex,
-          typename ForwardIndex>
+          typename ForwardIndex, typename RMQ = cartesian_tree,
+          typename Strategy = forward_strategy>
 struct autocomplete {
     typedef scored_string_pool::iterator iterator_type;
+    typedef min_heap<typename InvertedIndex::iterator_type,
+                     iterator_comparator<typename InvertedIndex::iterator_type>>
+        min_priority_queue_type;
+
+    typedef minimal_docids<RMQ, InvertedIndex> minimal_docids_type;
+
+    /*
+    The scratch memory of the queries. The index keeps a context of its own,
+    used by the queries without one; the queries given a context do not
+    modify the index, so that an index can be queried by many threads at
+    once, each with its own context (see numa.hpp).
+    */
+    struct query_context {
+        query_context() {
+            pool.resize(constants::POOL_SIZE, constants::MAX_K);
+            // NOTE: locate_prefix appends up to two terms to the prefix
+            prefix.reserve(constants::MAX_NUM_TERMS_PER_QUERY + 2);
+            suffix_lex_ranges.reserve(constants::MAX_FUZZY_RANGES);
+            unsorted_list<RMQ>::reserve(docs_queue);
+            minimal_docids_type::reserve(minimal_docs_queue);
+        }
 
-    autocomplete() {
-        m_pool.resize(constants::POOL_SIZE, constants::MAX_K);
-    }
+        scored_string_pool pool;
+        normaliser::buffer normalised;
+        completion_type prefix;
+        range_list suffix_lex_ranges;
+        typename InvertedIndex::intersection_iterator_type intersection;
+        min_priority_queue_type q;
+        typename unsorted_list<RMQ>::topk_queue_type docs_queue;
+        typename minimal_docids_type::min_priority_queue_type
+            minimal_docs_queue;
+        search_budget budget;
+
+        /* number of conjunctive steps run with the heap, and in total */
+        uint64_t heap_queries = 0;
+        uint64_t conjunctive_queries = 0;
+    };
+
+    autocomplete() {}
 
     autocomplete(parameters const& params)
         : autocomplete() {
@@ -32,69 +83,147 @@ struct autocomplete {
         fi_builder.build(m_forward_index);
     }
 
+    /* the queries of the index itself, with its own context:
+       see query_context to share the index among threads */
     template <typename Probe>
     iterator_type prefix_topk(std::string const& query, const uint32_t k,
                               Probe& probe) {
+        return prefix_topk(m_context, query, k, probe);
+    }
+
+    template <typename Probe>
+    iterator_type conjunctive_topk(std::string const& query, const uint32_t k,
+                                   Probe& probe) {
+        return conjunctive_topk(m_context, query, k, probe);
+    }
+
+    template <typename Probe>
+    iterator_type fuzzy_conjunctive_topk(std::string const& query,
+                                         const uint32_t k,
+                                         const uint32_t max_edits,
+                                         Probe& probe) {
+        return fuzzy_conjunctive_topk(m_context, query, k, max_edits, probe);
+    }
+
+    template <typename Probe>
+    iterator_type prefix_topk(query_context& ctx, std::string const& query,
+                              const uint32_t k, Probe& probe) const {
         assert(k <= constants::MAX_K);
 
         probe.start(0);
-        init();
-        completion_type prefix;
+        init(ctx);
+        completion_type& prefix = ctx.prefix;
         byte_range suffix;
         constexpr bool must_find_prefix = true;
-        if (!parse(m_dictionary, query, prefix, suffix, must_find_prefix)) {
-            return m_pool.begin();
+        if (!parse(m_dictionary, m_normaliser(query, ctx.normalised), prefix,
+                   suffix, must_find_prefix)) {
+            return ctx.pool.begin();
         }
         probe.stop(0);
 
         probe.start(1);
         range suffix_lex_range = m_dictionary.locate_prefix(suffix);
-        if (suffix_lex_range.is_invalid()) return m_pool.begin();
+        if (suffix_lex_range.is_invalid()) return ctx.pool.begin();
         suffix_lex_range.begin += 1;
         suffix_lex_range.end += 1;
         range r = m_completions.locate_prefix(prefix, suffix_lex_range);
-        if (r.is_invalid()) return m_pool.begin();
+        if (r.is_invalid()) return ctx.pool.begin();
+        constexpr bool unique = false;
+        auto deleted = m_tombstones.load();
         uint32_t num_completions =
-            m_unsorted_docs_list.topk(r, k, m_pool.scores());
+            m_unsorted_docs_list.topk(r, k, ctx.pool.scores(),
+                                      ctx.docs_queue, unique, *deleted);
         probe.stop(1);
 
         probe.start(2);
-        auto it = extract_strings(num_completions);
+        auto it = extract_strings(ctx, num_completions);
         probe.stop(2);
 
         return it;
     }
 
     template <typename Probe>
-    iterator_type conjunctive_topk(std::string const& query, const uint32_t k,
-                                   Probe& probe) {
+    iterator_type conjunctive_topk(query_context& ctx,
+                                   std::string const& query, const uint32_t k,
+                                   Probe& probe) const {
         assert(k <= constants::MAX_K);
 
         probe.start(0);
-        init();
-        completion_type prefix;
+        init(ctx);
+        completion_type& prefix = ctx.prefix;
         byte_range suffix;
         constexpr bool must_find_prefix = false;
-        parse(m_dictionary, query, prefix, suffix, must_find_prefix);
+        parse(m_dictionary, m_normaliser(query, ctx.normalised), prefix,
+              suffix, must_find_prefix);
         probe.stop(0);
 
         probe.start(1);
         range suffix_lex_range = m_dictionary.locate_prefix(suffix);
-        if (suffix_lex_range.is_invalid()) return m_pool.begin();
+        if (suffix_lex_range.is_invalid()) return ctx.pool.begin();
         uint32_t num_completions = 0;
+        auto deleted = m_tombstones.load();
         if (prefix.size() == 0) {
             suffix_lex_range.end += 1;
             num_completions = m_unsorted_minimal_docs_list.topk(
-                m_inverted_index, suffix_lex_range, k, m_pool.scores());
+                m_inverted_index, suffix_lex_range, k, ctx.pool.scores(),
+                ctx.minimal_docs_queue, *deleted);
         } else {
             suffix_lex_range.begin += 1;
             suffix_lex_range.end += 1;
-            num_completions = conjunctive_topk(prefix, suffix_lex_range, k);
+            num_completions =
+                conjunctive_topk(ctx, prefix, suffix_lex_range, k, *deleted);
         }
         probe.stop(1);
 
         probe.start(2);
-        auto it = extract_strings(num_completions);
+        auto it = extract_strings(ctx, num_completions);
+        probe.stop(2);
+
+        return it;
+    }
+
+    /* as conjunctive_topk, but tolerating up to max_edits typos in the
+       last query term: see fuzzy_search.hpp */
+    template <typename Probe>
+    iterator_type fuzzy_conjunctive_topk(query_context& ctx,
+                                         std::string const& query,
+                                         const uint32_t k,
+                                         const uint32_t max_edits,
+                                         Probe& probe) const {
+        assert(k <= constants::MAX_K);
+
+        probe.start(0);
+        init(ctx);
+        completion_type& prefix = ctx.prefix;
+        byte_range suffix;
+        constexpr bool must_find_prefix = false;
+        parse(m_dictionary, m_normaliser(query, ctx.normalised), prefix,
+              suffix, must_find_prefix);
+        probe.stop(0);
+
+        probe.start(1);
+        range_list& suffix_lex_ranges = ctx.suffix_lex_ranges;
+        fuzzy_locate_prefix(m_dictionary, suffix, max_edits,
+                            suffix_lex_ranges);
+        uint32_t num_completions = 0;
+        auto deleted = m_tombstones.load();
+        if (prefix.size() == 0) {
+            for (auto& r : suffix_lex_ranges) r.end += 1;
+            num_completions = m_unsorted_minimal_docs_list.topk(
+                m_inverted_index, suffix_lex_ranges, k, ctx.pool.scores(),
+                ctx.minimal_docs_queue, *deleted);
+        } else if (!suffix_lex_ranges.empty()) {
+            for (auto& r : suffix_lex_ranges) {
+                r.begin += 1;
+                r.end += 1;
+            }
+            num_completions =
+                conjunctive_topk(ctx, prefix, suffix_lex_ranges, k, *deleted);
+        }
+        probe.stop(1);
+
+        probe.start(2);
+        auto it = extract_strings(ctx, num_completions);
         probe.stop(2);
 
         return it;
@@ -137,12 +266,47 @@ struct autocomplete {
     //     return extract_strings(num_completions);
     // }
 
+    /* doc_ids that must not be reported: the set can be replaced
+       at any time, even while queries are running */
+    void set_tombstones(std::shared_ptr<const tombstone_set> deleted) {
+        m_tombstones.store(std::move(deleted));
+    }
+
+    /* must be configured as the normalise tool that
+       pre-processed the collection */
+    void set_normaliser(normaliser const& n) {
+        m_normaliser = n;
+    }
+
+    /* limit on the postings visited by the conjunctive queries: when the
+       budget is over, the best completions found so far are reported */
+    void set_search_budget(search_budget const& budget) {
+        m_budget = budget;
+    }
+
+    /* true if the last query without a context ran out of budget:
+       otherwise, see the budget of the context */
+    bool partial() const {
+        return m_context.budget.partial();
+    }
+
     size_t bytes() const {
         return m_completions.bytes() + m_unsorted_docs_list.bytes() +
                m_unsorted_minimal_docs_list.bytes() + m_dictionary.bytes() +
                m_inverted_index.bytes() + m_forward_index.bytes();
     }
 
+    /* f(name, bytes) for the components summed by bytes() */
+    template <typename F>
+    void for_each_component(F f) const {
+        f("completions", m_completions.bytes());
+        f("unsorted_docs_list", m_unsorted_docs_list.bytes());
+        f("unsorted_minimal_docs_list", m_unsorted_minimal_docs_list.bytes());
+        f("dictionary", m_dictionary.bytes());
+        f("inverted_index", m_inverted_index.bytes());
+        f("forward_index", m_forward_index.bytes());
+    }
+
     void print_stats() const;
 
     template <typename Visitor>
@@ -155,41 +319,62 @@ struct autocomplete {
         visitor.visit(m_forward_index);
     }
 
+protected:
+    Strategy m_strategy;
+    query_context m_context;
+
 private:
     Completions m_completions;
-    unsorted_list_type m_unsorted_docs_list;
-    typedef minimal_docids<cartesian_tree, InvertedIndex> minimal_docids_type;
+    unsorted_list<RMQ> m_unsorted_docs_list;
     minimal_docids_type m_unsorted_minimal_docs_list;
     Dictionary m_dictionary;
     InvertedIndex m_inverted_index;
     ForwardIndex m_forward_index;
 
-    scored_string_pool m_pool;
-
-    void init() {
-        m_pool.clear();
-        m_pool.init();
-        assert(m_pool.size() == 0);
+    tombstones m_tombstones;
+    normaliser m_normaliser;
+    search_budget m_budget;
+
+    void init(query_context& ctx) const {
+        ctx.prefix.clear();
+        ctx.pool.clear();
+        ctx.pool.init();
+        assert(ctx.pool.size() == 0);
+        ctx.budget = m_budget;
+        ctx.budget.start();
     }
 
-    uint32_t conjunctive_topk(completion_type& prefix, const range suffix,
-                              uint32_t const k) {
+    // Range is either a range or a range_list
+    template <typename Range>
+    uint32_t conjunctive_topk(query_context& ctx, completion_type& prefix,
+                              Range const& suffix, uint32_t const k,
+                              tombstone_set const& deleted) const {
         deduplicate(prefix);
+        bool heap = m_strategy.use_heap(m_inverted_index, prefix, suffix, k);
+        ctx.heap_queries += heap;
+        ctx.conjunctive_queries += 1;
         if (prefix.size() == 1) {  // we've got nothing to intersect
             auto it = m_inverted_index.iterator(prefix.front() - 1);
-            return conjunctive_topk(it, suffix, k);
+            return heap ? heap_conjunctive_topk(ctx, it, suffix, k, deleted)
+                        : conjunctive_topk(ctx, it, suffix, k, deleted);
         }
-        auto it = m_inverted_index.intersection_iterator(prefix);
-        return conjunctive_topk(it, suffix, k);
+        auto& it = ctx.intersection;
+        m_inverted_index.intersection_iterator(prefix, it, 0, &ctx.budget);
+        return heap ? heap_conjunctive_topk(ctx, it, suffix, k, deleted)
+                    : conjunctive_topk(ctx, it, suffix, k, deleted);
     }
 
-    template <typename Iterator>
-    uint32_t conjunctive_topk(Iterator& it, const range r, uint32_t const k) {
-        auto& topk_scores = m_pool.scores();
+    template <typename Iterator, typename Range>
+    uint32_t conjunctive_topk(query_context& ctx, Iterator& it, Range const& r,
+                              uint32_t const k,
+                              tombstone_set const& deleted) const {
+        auto& topk_scores = ctx.pool.scores();
         uint32_t results = 0;
         for (; it.has_next(); ++it) {
+            if (!ctx.budget.spend()) break;
             auto doc_id = *it;
-            if (m_forward_index.intersects(doc_id, r)) {
+            if (!deleted.contains(doc_id) and
+                m_forward_index.intersects(doc_id, r)) {
                 topk_scores[results++] = doc_id;
                 if (results == k) break;
             }
@@ -197,13 +382,29 @@ private:
         return results;
     }
 
-    iterator_type extract_strings(const uint32_t num_completions) {
-        auto const& topk_scores = m_pool.scores();
+    template <typename Iterator, typename Range>
+    uint32_t heap_conjunctive_topk(query_context& ctx, Iterator& it,
+                                   Range const& r, uint32_t const k,
+                                   tombstone_set const& deleted) const {
+        auto& q = ctx.q;
+        q.clear();
+        q.reserve(num_terms(r));
+        push_iterators(m_inverted_index, q, r);
+        q.make_heap();
+        return ::autocomplete::heap_conjunctive_topk(
+            it, q, k, deleted, ctx.pool.scores().data(),
+            [&](id_type) { return ctx.budget.spend(); });
+    }
+
+    iterator_type extract_strings(query_context& ctx,
+                                  const uint32_t num_completions) const {
+        auto& pool = ctx.pool;
+        auto const& topk_scores = pool.scores();
         for (uint32_t i = 0; i != num_completions; ++i) {
             auto doc_id = topk_scores[i];
             auto it = m_forward_index.iterator(doc_id);
-            uint64_t offset = m_pool.bytes();
-            uint8_t* decoded = m_pool.data() + offset;
+            uint64_t offset = pool.bytes();
+            uint8_t* decoded = pool.data() + offset;
             for (uint32_t j = 0; j != it.size(); ++j, ++it) {
                 auto term_id = *it;
                 uint8_t len = m_dictionary.extract(term_id, decoded);
@@ -214,10 +415,10 @@ private:
                     offset++;
                 }
             }
-            m_pool.push_back_offset(offset);
+            pool.push_back_offset(offset);
         }
-        assert(m_pool.size() == num_completions);
-        return m_pool.begin();
+        assert(pool.size() == num_completions);
+        return pool.begin();
     }
 };
 }  // namespace autocomplete
\ No newline at end of file
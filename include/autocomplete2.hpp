@@ -9,12 +9,16 @@
 
 namespace autocomplete {
 
-template <typename Completions, typename Dictionary, typename InvertedIndex>
+template <typename Completions, typename Dictionary, typename InvertedIndex,
+          typename RMQ = cartesian_tree>
 struct autocomplete2 {
     typedef scored_string_pool::iterator iterator_type;
 
     autocomplete2() {
         m_pool.resize(constants::POOL_SIZE, constants::MAX_K);
+        // NOTE: locate_prefix appends up to two terms to the prefix
+        m_prefix.reserve(constants::MAX_NUM_TERMS_PER_QUERY + 2);
+        m_suffix_lex_ranges.reserve(constants::MAX_FUZZY_RANGES);
         m_topk_completion_set.resize(constants::MAX_K,
                                      2 * constants::MAX_NUM_TERMS_PER_QUERY);
     }
@@ -42,10 +46,11 @@ struct autocomplete2 {
 
         probe.start(0);
         init();
-        completion_type prefix;
+        completion_type& prefix = m_prefix;
         byte_range suffix;
         constexpr bool must_find_prefix = true;
-        if (!parse(m_dictionary, query, prefix, suffix, must_find_prefix)) {
+        if (!parse(m_dictionary, m_normaliser(query), prefix, suffix,
+                   must_find_prefix)) {
             return m_pool.begin();
         }
         probe.stop(0);
@@ -57,8 +62,10 @@ struct autocomplete2 {
         suffix_lex_range.end += 1;
         range r = m_completions.locate_prefix(prefix, suffix_lex_range);
         if (r.is_invalid()) return m_pool.begin();
+        constexpr bool unique = false;
+        auto deleted = m_tombstones.load();
         uint32_t num_completions =
-            m_unsorted_docs_list.topk(r, k, m_pool.scores());
+            m_unsorted_docs_list.topk(r, k, m_pool.scores(), unique, *deleted);
         probe.stop(1);
 
         probe.start(2);
@@ -76,25 +83,76 @@ struct autocomplete2 {
 
         probe.start(0);
         init();
-        completion_type prefix;
+        completion_type& prefix = m_prefix;
         byte_range suffix;
         constexpr bool must_find_prefix = false;
-        parse(m_dictionary, query, prefix, suffix, must_find_prefix);
+        parse(m_dictionary, m_normaliser(query), prefix, suffix,
+              must_find_prefix);
         probe.stop(0);
 
         probe.start(1);
         range suffix_lex_range = m_dictionary.locate_prefix(suffix);
         if (suffix_lex_range.is_invalid()) return m_pool.begin();
         uint32_t num_completions = 0;
+        auto deleted = m_tombstones.load();
         if (prefix.size() == 0) {
             suffix_lex_range.end += 1;
             num_completions = m_unsorted_minimal_docs_list.topk(
-                m_inverted_index, suffix_lex_range, k, m_pool.scores());
+                m_inverted_index, suffix_lex_range, k, m_pool.scores(),
+                *deleted);
             extract_completions(num_completions);
         } else {
             suffix_lex_range.begin += 1;
             suffix_lex_range.end += 1;
-            num_completions = conjunctive_topk(prefix, suffix_lex_range, k);
+            num_completions =
+                conjunctive_topk(prefix, suffix_lex_range, k, *deleted);
+        }
+        probe.stop(1);
+
+        probe.start(2);
+        auto it = extract_strings(num_completions);
+        probe.stop(2);
+
+        return it;
+    }
+
+    /* as conjunctive_topk, but tolerating up to max_edits typos in the
+       last query term: see fuzzy_search.hpp */
+    template <typename Probe>
+    iterator_type fuzzy_conjunctive_topk(std::string const& query,
+                                         const uint32_t k,
+                                         const uint32_t max_edits,
+                                         Probe& probe) {
+        assert(k <= constants::MAX_K);
+
+        probe.start(0);
+        init();
+        completion_type& prefix = m_prefix;
+        byte_range suffix;
+        constexpr bool must_find_prefix = false;
+        parse(m_dictionary, m_normaliser(query), prefix, suffix,
+              must_find_prefix);
+        probe.stop(0);
+
+        probe.start(1);
+        range_list& suffix_lex_ranges = m_suffix_lex_ranges;
+        fuzzy_locate_prefix(m_dictionary, suffix, max_edits,
+                            suffix_lex_ranges);
+        uint32_t num_completions = 0;
+        auto deleted = m_tombstones.load();
+        if (prefix.size() == 0) {
+            for (auto& r : suffix_lex_ranges) r.end += 1;
+            num_completions = m_unsorted_minimal_docs_list.topk(
+                m_inverted_index, suffix_lex_ranges, k, m_pool.scores(),
+                *deleted);
+            extract_completions(num_completions);
+        } else if (!suffix_lex_ranges.empty()) {
+            for (auto& r : suffix_lex_ranges) {
+                r.begin += 1;
+                r.end += 1;
+            }
+            num_completions =
+                conjunctive_topk(prefix, suffix_lex_ranges, k, *deleted);
         }
         probe.stop(1);
 
@@ -145,6 +203,29 @@ struct autocomplete2 {
     //     return extract_strings(num_completions);
     // }
 
+    /* doc_ids that must not be reported: the set can be replaced
+       at any time, even while queries are running */
+    void set_tombstones(std::shared_ptr<const tombstone_set> deleted) {
+        m_tombstones.store(std::move(deleted));
+    }
+
+    /* must be configured as the normalise tool that
+       pre-processed the collection */
+    void set_normaliser(normaliser const& n) {
+        m_normaliser = n;
+    }
+
+    /* limit on the postings visited by the conjunctive queries: when the
+       budget is over, the best completions found so far are reported */
+    void set_search_budget(search_budget const& budget) {
+        m_budget = budget;
+    }
+
+    /* true if the last query ran out of budget */
+    bool partial() const {
+        return m_budget.partial();
+    }
+
     size_t bytes() const {
         return m_completions.bytes() + m_unsorted_docs_list.bytes() +
                m_unsorted_minimal_docs_list.bytes() + m_dictionary.bytes() +
@@ -165,8 +246,8 @@ struct autocomplete2 {
 
 private:
     Completions m_completions;
-    unsorted_list_type m_unsorted_docs_list;
-    typedef minimal_docids<cartesian_tree, InvertedIndex> minimal_docids_type;
+    unsorted_list<RMQ> m_unsorted_docs_list;
+    typedef minimal_docids<RMQ, InvertedIndex> minimal_docids_type;
     minimal_docids_type m_unsorted_minimal_docs_list;
     Dictionary m_dictionary;
     InvertedIndex m_inverted_index;
@@ -174,11 +255,21 @@ private:
 
     scored_string_pool m_pool;
     completion_set m_topk_completion_set;
+    tombstones m_tombstones;
+    normaliser m_normaliser;
+    search_budget m_budget;
+
+    /* scratch memory of the queries, kept to avoid allocating */
+    completion_type m_prefix;
+    range_list m_suffix_lex_ranges;
+    typename InvertedIndex::intersection_iterator_type m_intersection;
 
     void init() {
+        m_prefix.clear();
         m_pool.clear();
         m_pool.init();
         assert(m_pool.size() == 0);
+        m_budget.start();
     }
 
     void extract_completions(const uint32_t num_completions) {
@@ -193,26 +284,32 @@ private:
         }
     }
 
-    uint32_t conjunctive_topk(completion_type& prefix, const range suffix,
-                              uint32_t const k) {
+    // Range is either a range or a range_list
+    template <typename Range>
+    uint32_t conjunctive_topk(completion_type& prefix, Range const& suffix,
+                              uint32_t const k, tombstone_set const& deleted) {
         deduplicate(prefix);
         if (prefix.size() == 1) {  // we've got nothing to intersect
             auto it = m_inverted_index.iterator(prefix.front() - 1);
-            return conjunctive_topk(it, suffix, k);
+            return conjunctive_topk(it, suffix, k, deleted);
         }
-        auto it = m_inverted_index.intersection_iterator(prefix);
-        return conjunctive_topk(it, suffix, k);
+        m_inverted_index.intersection_iterator(prefix, m_intersection, 0,
+                                               &m_budget);
+        return conjunctive_topk(m_intersection, suffix, k, deleted);
     }
 
-    template <typename Iterator>
-    uint32_t conjunctive_topk(Iterator& it, const range r, const uint32_t k) {
+    template <typename Iterator, typename Range>
+    uint32_t conjunctive_topk(Iterator& it, Range const& r, const uint32_t k,
+                              tombstone_set const& deleted) {
         auto& topk_scores = m_pool.scores();
         auto& completions = m_topk_completion_set.completions();
         auto& sizes = m_topk_completion_set.sizes();
         uint32_t i = 0;
 
         for (; it.has_next(); ++it) {
+            if (!m_budget.spend()) break;
             auto doc_id = *it;
+            if (deleted.contains(doc_id)) continue;
             auto lex_id = m_docid_to_lexid[doc_id];
             uint32_t size = m_completions.extract(lex_id, completions[i]);
             for (uint32_t j = 0; j != size; ++j) {
@@ -4,6 +4,7 @@
 #include "building_util.hpp"
 #include "compact_vector.hpp"
 #include "autocomplete_common.hpp"
+#include "segmented_search.hpp"
 #include "scored_string_pool.hpp"
 #include "constants.hpp"
 
@@ -15,7 +16,8 @@ one iterator for each termID in the lexicographic range of the
 last token of the query.
 */
 
-template <typename Completions, typename Dictionary, typename InvertedIndex>
+template <typename Completions, typename Dictionary, typename InvertedIndex,
+          typename RMQ = cartesian_tree>
 struct autocomplete3 {
     typedef scored_string_pool::iterator iterator_type;
     typedef min_heap<typename InvertedIndex::iterator_type,
@@ -24,6 +26,9 @@ struct autocomplete3 {
 
     autocomplete3() {
         m_pool.resize(constants::POOL_SIZE, constants::MAX_K);
+        // NOTE: locate_prefix appends up to two terms to the prefix
+        m_prefix.reserve(constants::MAX_NUM_TERMS_PER_QUERY + 2);
+        m_suffix_lex_ranges.reserve(constants::MAX_FUZZY_RANGES);
         m_topk_completion_set.resize(constants::MAX_K,
                                      2 * constants::MAX_NUM_TERMS_PER_QUERY);
     }
@@ -50,10 +55,11 @@ struct autocomplete3 {
 
         probe.start(0);
         init();
-        completion_type prefix;
+        completion_type& prefix = m_prefix;
         byte_range suffix;
         constexpr bool must_find_prefix = true;
-        if (!parse(m_dictionary, query, prefix, suffix, must_find_prefix)) {
+        if (!parse(m_dictionary, m_normaliser(query), prefix, suffix,
+                   must_find_prefix)) {
             return m_pool.begin();
         }
         probe.stop(0);
@@ -65,8 +71,10 @@ struct autocomplete3 {
         suffix_lex_range.end += 1;
         range r = m_completions.locate_prefix(prefix, suffix_lex_range);
         if (r.is_invalid()) return m_pool.begin();
+        constexpr bool unique = false;
+        auto deleted = m_tombstones.load();
         uint32_t num_completions =
-            m_unsorted_docs_list.topk(r, k, m_pool.scores());
+            m_unsorted_docs_list.topk(r, k, m_pool.scores(), unique, *deleted);
         probe.stop(1);
 
         probe.start(2);
@@ -84,10 +92,11 @@ struct autocomplete3 {
 
         probe.start(0);
         init();
-        completion_type prefix;
+        completion_type& prefix = m_prefix;
         byte_range suffix;
         constexpr bool must_find_prefix = false;
-        parse(m_dictionary, query, prefix, suffix, must_find_prefix);
+        parse(m_dictionary, m_normaliser(query), prefix, suffix,
+              must_find_prefix);
         probe.stop(0);
 
         probe.start(1);
@@ -96,7 +105,50 @@ struct autocomplete3 {
         if (suffix_lex_range.is_invalid()) return m_pool.begin();
         suffix_lex_range.begin += 1;
         suffix_lex_range.end += 1;
-        num_completions = conjunctive_topk(prefix, suffix_lex_range, k);
+        auto deleted = m_tombstones.load();
+        num_completions =
+            conjunctive_topk(prefix, suffix_lex_range, k, *deleted);
+        probe.stop(1);
+
+        probe.start(2);
+        extract_completions(num_completions);
+        auto it = extract_strings(num_completions);
+        probe.stop(2);
+
+        return it;
+    }
+
+    /* as conjunctive_topk, but tolerating up to max_edits typos in the
+       last query term: see fuzzy_search.hpp */
+    template <typename Probe>
+    iterator_type fuzzy_conjunctive_topk(std::string const& query,
+                                         const uint32_t k,
+                                         const uint32_t max_edits,
+                                         Probe& probe) {
+        assert(k <= constants::MAX_K);
+
+        probe.start(0);
+        init();
+        completion_type& prefix = m_prefix;
+        byte_range suffix;
+        constexpr bool must_find_prefix = false;
+        parse(m_dictionary, m_normaliser(query), prefix, suffix,
+              must_find_prefix);
+        probe.stop(0);
+
+        probe.start(1);
+        uint32_t num_completions = 0;
+        range_list& suffix_lex_ranges = m_suffix_lex_ranges;
+        fuzzy_locate_prefix(m_dictionary, suffix, max_edits,
+                            suffix_lex_ranges);
+        if (suffix_lex_ranges.empty()) return m_pool.begin();
+        for (auto& r : suffix_lex_ranges) {
+            r.begin += 1;
+            r.end += 1;
+        }
+        auto deleted = m_tombstones.load();
+        num_completions =
+            conjunctive_topk(prefix, suffix_lex_ranges, k, *deleted);
         probe.stop(1);
 
         probe.start(2);
@@ -137,6 +189,42 @@ struct autocomplete3 {
     //     return extract_strings(num_completions);
     // }
 
+    /* doc_ids that must not be reported: the set can be replaced
+       at any time, even while queries are running */
+    void set_tombstones(std::shared_ptr<const tombstone_set> deleted) {
+        m_tombstones.store(std::move(deleted));
+    }
+
+    /* must be configured as the normalise tool that
+       pre-processed the collection */
+    void set_normaliser(normaliser const& n) {
+        m_normaliser = n;
+    }
+
+    /* limit on the postings visited by the conjunctive queries: when the
+       budget is over, the best completions found so far are reported */
+    void set_search_budget(search_budget const& budget) {
+        m_budget = budget;
+    }
+
+    /* true if the last query ran out of budget */
+    bool partial() const {
+        return m_budget.partial();
+    }
+
+    /* the heavy conjunctive queries without a budget are split into
+       segments of doc_ids searched in parallel: see segmented_search.hpp */
+    void set_parallelism(intra_query_parallelism const& parallelism) {
+        m_parallelism = parallelism;
+        m_segmented.resize(parallelism.num_segments);
+        m_segments.resize(parallelism.num_segments);
+    }
+
+    /* number of conjunctive steps run in parallel */
+    uint64_t parallel_queries() const {
+        return m_parallel_queries;
+    }
+
     size_t bytes() const {
         return m_completions.bytes() + m_unsorted_docs_list.bytes() +
                m_dictionary.bytes() + m_docid_to_lexid.bytes() +
@@ -156,18 +244,39 @@ struct autocomplete3 {
 
 private:
     Completions m_completions;
-    unsorted_list_type m_unsorted_docs_list;
+    unsorted_list<RMQ> m_unsorted_docs_list;
     Dictionary m_dictionary;
     InvertedIndex m_inverted_index;
     compact_vector m_docid_to_lexid;
 
     scored_string_pool m_pool;
     completion_set m_topk_completion_set;
+    tombstones m_tombstones;
+    normaliser m_normaliser;
+    search_budget m_budget;
+    intra_query_parallelism m_parallelism;
+    uint64_t m_parallel_queries = 0;
+
+    /* scratch memory of the queries, kept to avoid allocating */
+    completion_type m_prefix;
+    range_list m_suffix_lex_ranges;
+    min_priority_queue_type m_q;
+    typename InvertedIndex::intersection_iterator_type m_intersection;
+
+    /* scratch memory of a segment of the parallel queries */
+    struct segment_scratch {
+        min_priority_queue_type q;
+        typename InvertedIndex::intersection_iterator_type intersection;
+    };
+    segmented_buffers m_segmented;
+    std::vector<segment_scratch> m_segments;
 
     void init() {
+        m_prefix.clear();
         m_pool.clear();
         m_pool.init();
         assert(m_pool.size() == 0);
+        m_budget.start();
     }
 
     void extract_completions(const uint32_t num_completions) {
@@ -182,59 +291,91 @@ private:
         }
     }
 
+    // Range is either a range or a range_list
+    template <typename Range>
     uint32_t conjunctive_topk(completion_type& prefix,
-                              const range suffix_lex_range, const uint32_t k) {
+                              Range const& suffix_lex_range, const uint32_t k,
+                              tombstone_set const& deleted) {
         if (prefix.size() == 0) {  // we've got nothing to intersect
-            return heap_topk(m_inverted_index, suffix_lex_range, k,
-                             m_pool.scores());
+            return heap_topk(suffix_lex_range, k, deleted);
         }
         deduplicate(prefix);
+        if (is_heavy(prefix, suffix_lex_range, k)) {
+            ++m_parallel_queries;
+            return parallel_conjunctive_topk(prefix, suffix_lex_range, k,
+                                             deleted);
+        }
         if (prefix.size() == 1) {  // we've got nothing to intersect
             auto it = m_inverted_index.iterator(prefix.front() - 1);
-            return conjunctive_topk(it, suffix_lex_range, k);
+            return conjunctive_topk(it, suffix_lex_range, k, deleted);
         }
-        auto it = m_inverted_index.intersection_iterator(prefix);
-        return conjunctive_topk(it, suffix_lex_range, k);
+        m_inverted_index.intersection_iterator(prefix, m_intersection, 0,
+                                               &m_budget);
+        return conjunctive_topk(m_intersection, suffix_lex_range, k, deleted);
     }
 
-    template <typename Iterator>
-    uint32_t conjunctive_topk(Iterator& it, const range r, const uint32_t k) {
-        assert(r.is_valid());
-
-        auto& topk_scores = m_pool.scores();
-        min_priority_queue_type q;
-        q.reserve(r.end - r.begin + 1);  // inclusive range
-        assert(r.begin > 0);
-        for (uint64_t term_id = r.begin; term_id <= r.end; ++term_id) {
-            q.push_back(m_inverted_index.iterator(term_id - 1));
+    template <typename Range>
+    bool is_heavy(completion_type const& prefix, Range const& r,
+                  const uint32_t k) const {
+        if (!m_parallelism.enabled() or !m_budget.unlimited()) return false;
+        uint64_t min_list_size = m_inverted_index.num_docs();
+        for (auto term_id : prefix) {
+            uint64_t size = m_inverted_index.iterator(term_id - 1).size();
+            min_list_size = std::min(min_list_size, size);
         }
-        q.make_heap();
+        return ::autocomplete::is_heavy(m_inverted_index, min_list_size,
+                                        num_terms(r), num_terms(r), k,
+                                        m_parallelism);
+    }
 
-        uint32_t results = 0;
-        for (; it.has_next() and !q.empty(); ++it) {
-            auto doc_id = *it;
-            while (!q.empty()) {
-                auto& z = q.top();
-                auto val = *z;
-                if (val > doc_id) break;
-                if (val < doc_id) {
-                    val = z.next_geq(doc_id);
-                    if (!z.has_next()) {
-                        q.pop();
-                    } else {
-                        q.heapify();
-                    }
-                }
-                if (val == doc_id) {  // NOTE: putting else here seems to slow
-                                      // down the code!
-                    topk_scores[results++] = doc_id;
-                    if (results == k) return results;
-                    break;
-                }
+    template <typename Range>
+    uint32_t parallel_conjunctive_topk(completion_type const& prefix,
+                                       Range const& r, const uint32_t k,
+                                       tombstone_set const& deleted) {
+        auto search = [&](uint32_t s, id_type begin, id_type end,
+                          id_type* topk_scores, auto stop) {
+            auto& q = m_segments[s].q;
+            q.clear();
+            q.reserve(num_terms(r));
+            push_iterators(m_inverted_index, q, r);
+            q.make_heap();
+            auto proceed = [&](id_type doc_id) {
+                return doc_id < end and !stop();
+            };
+            if (prefix.size() == 1) {
+                auto it = m_inverted_index.iterator(prefix.front() - 1);
+                if (begin != 0) it.next_geq(begin);
+                return heap_conjunctive_topk(it, q, k, deleted, topk_scores,
+                                             proceed);
             }
-        }
+            auto& it = m_segments[s].intersection;
+            m_inverted_index.intersection_iterator(prefix, it, begin);
+            return heap_conjunctive_topk(it, q, k, deleted, topk_scores,
+                                         proceed);
+        };
+        return segmented_topk(*m_parallelism.pool, m_inverted_index.num_docs(),
+                              k, m_segmented, m_pool.scores(), search);
+    }
 
-        return results;
+    template <typename Range>
+    uint32_t heap_topk(Range const& r, const uint32_t k,
+                       tombstone_set const& deleted) {
+        return ::autocomplete::heap_topk(
+            m_inverted_index, r, k, m_pool.scores(), m_q, deleted,
+            [&](id_type) { return m_budget.spend(); });
+    }
+
+    template <typename Iterator, typename Range>
+    uint32_t conjunctive_topk(Iterator& it, Range const& r, const uint32_t k,
+                              tombstone_set const& deleted) {
+        auto& q = m_q;
+        q.clear();
+        q.reserve(num_terms(r));
+        push_iterators(m_inverted_index, q, r);
+        q.make_heap();
+        return heap_conjunctive_topk(
+            it, q, k, deleted, m_pool.scores().data(),
+            [&](id_type) { return m_budget.spend(); });
     }
 
     iterator_type extract_strings(const uint32_t num_completions) {
@@ -4,6 +4,7 @@
 #include "building_util.hpp"
 #include "compact_vector.hpp"
 #include "autocomplete_common.hpp"
+#include "segmented_search.hpp"
 #include "scored_string_pool.hpp"
 #include "constants.hpp"
 
@@ -12,12 +13,15 @@ namespace autocomplete {
 /* Bast and Weber approach. */
 
 template <typename Completions, typename Dictionary,
-          typename BlockedInvertedIndex>
+          typename BlockedInvertedIndex, typename RMQ = cartesian_tree>
 struct autocomplete4 {
     typedef scored_string_pool::iterator iterator_type;
 
     autocomplete4() {
         m_pool.resize(constants::POOL_SIZE, constants::MAX_K);
+        // NOTE: locate_prefix appends up to two terms to the prefix
+        m_prefix.reserve(constants::MAX_NUM_TERMS_PER_QUERY + 2);
+        m_suffix_lex_ranges.reserve(constants::MAX_FUZZY_RANGES);
         m_topk_completion_set.resize(constants::MAX_K,
                                      2 * constants::MAX_NUM_TERMS_PER_QUERY);
     }
@@ -44,10 +48,11 @@ struct autocomplete4 {
 
         probe.start(0);
         init();
-        completion_type prefix;
+        completion_type& prefix = m_prefix;
         byte_range suffix;
         constexpr bool must_find_prefix = true;
-        if (!parse(m_dictionary, query, prefix, suffix, must_find_prefix)) {
+        if (!parse(m_dictionary, m_normaliser(query), prefix, suffix,
+                   must_find_prefix)) {
             return m_pool.begin();
         }
         probe.stop(0);
@@ -59,8 +64,10 @@ struct autocomplete4 {
         suffix_lex_range.end += 1;
         range r = m_completions.locate_prefix(prefix, suffix_lex_range);
         if (r.is_invalid()) return m_pool.begin();
+        constexpr bool unique = false;
+        auto deleted = m_tombstones.load();
         uint32_t num_completions =
-            m_unsorted_docs_list.topk(r, k, m_pool.scores());
+            m_unsorted_docs_list.topk(r, k, m_pool.scores(), unique, *deleted);
         probe.stop(1);
 
         probe.start(2);
@@ -78,10 +85,11 @@ struct autocomplete4 {
 
         probe.start(0);
         init();
-        completion_type prefix;
+        completion_type& prefix = m_prefix;
         byte_range suffix;
         constexpr bool must_find_prefix = false;
-        parse(m_dictionary, query, prefix, suffix, must_find_prefix);
+        parse(m_dictionary, m_normaliser(query), prefix, suffix,
+              must_find_prefix);
         probe.stop(0);
 
         probe.start(1);
@@ -89,8 +97,49 @@ struct autocomplete4 {
         if (suffix_lex_range.is_invalid()) return m_pool.begin();
         suffix_lex_range.begin += 1;
         suffix_lex_range.end += 1;
+        auto deleted = m_tombstones.load();
         uint32_t num_completions =
-            conjunctive_topk(prefix, suffix_lex_range, k);
+            conjunctive_topk(prefix, suffix_lex_range, k, *deleted);
+        probe.stop(1);
+
+        probe.start(2);
+        extract_completions(num_completions);
+        auto it = extract_strings(num_completions);
+        probe.stop(2);
+
+        return it;
+    }
+
+    /* as conjunctive_topk, but tolerating up to max_edits typos in the
+       last query term: see fuzzy_search.hpp */
+    template <typename Probe>
+    iterator_type fuzzy_conjunctive_topk(std::string const& query,
+                                         const uint32_t k,
+                                         const uint32_t max_edits,
+                                         Probe& probe) {
+        assert(k <= constants::MAX_K);
+
+        probe.start(0);
+        init();
+        completion_type& prefix = m_prefix;
+        byte_range suffix;
+        constexpr bool must_find_prefix = false;
+        parse(m_dictionary, m_normaliser(query), prefix, suffix,
+              must_find_prefix);
+        probe.stop(0);
+
+        probe.start(1);
+        range_list& suffix_lex_ranges = m_suffix_lex_ranges;
+        fuzzy_locate_prefix(m_dictionary, suffix, max_edits,
+                            suffix_lex_ranges);
+        if (suffix_lex_ranges.empty()) return m_pool.begin();
+        for (auto& r : suffix_lex_ranges) {
+            r.begin += 1;
+            r.end += 1;
+        }
+        auto deleted = m_tombstones.load();
+        uint32_t num_completions =
+            conjunctive_topk(prefix, suffix_lex_ranges, k, *deleted);
         probe.stop(1);
 
         probe.start(2);
@@ -129,6 +178,42 @@ struct autocomplete4 {
     //     return extract_strings(num_completions);
     // }
 
+    /* doc_ids that must not be reported: the set can be replaced
+       at any time, even while queries are running */
+    void set_tombstones(std::shared_ptr<const tombstone_set> deleted) {
+        m_tombstones.store(std::move(deleted));
+    }
+
+    /* must be configured as the normalise tool that
+       pre-processed the collection */
+    void set_normaliser(normaliser const& n) {
+        m_normaliser = n;
+    }
+
+    /* limit on the postings visited by the conjunctive queries: when the
+       budget is over, the best completions found so far are reported */
+    void set_search_budget(search_budget const& budget) {
+        m_budget = budget;
+    }
+
+    /* true if the last query ran out of budget */
+    bool partial() const {
+        return m_budget.partial();
+    }
+
+    /* the heavy conjunctive queries without a budget are split into
+       segments of doc_ids searched in parallel: see segmented_search.hpp */
+    void set_parallelism(intra_query_parallelism const& parallelism) {
+        m_parallelism = parallelism;
+        m_segmented.resize(parallelism.num_segments);
+        m_segments.resize(parallelism.num_segments);
+    }
+
+    /* number of conjunctive steps run in parallel */
+    uint64_t parallel_queries() const {
+        return m_parallel_queries;
+    }
+
     size_t bytes() const {
         return m_completions.bytes() + m_unsorted_docs_list.bytes() +
                m_dictionary.bytes() + m_docid_to_lexid.bytes() +
@@ -148,18 +233,30 @@ struct autocomplete4 {
 
 private:
     Completions m_completions;
-    unsorted_list_type m_unsorted_docs_list;
+    unsorted_list<RMQ> m_unsorted_docs_list;
     Dictionary m_dictionary;
     BlockedInvertedIndex m_inverted_index;
     compact_vector m_docid_to_lexid;
 
     scored_string_pool m_pool;
     completion_set m_topk_completion_set;
+    tombstones m_tombstones;
+    normaliser m_normaliser;
+    search_budget m_budget;
+    intra_query_parallelism m_parallelism;
+    uint64_t m_parallel_queries = 0;
+
+    /* scratch memory of the queries, kept to avoid allocating */
+    completion_type m_prefix;
+    range_list m_suffix_lex_ranges;
+    typename BlockedInvertedIndex::intersection_iterator_type m_intersection;
 
     void init() {
+        m_prefix.clear();
         m_pool.clear();
         m_pool.init();
         assert(m_pool.size() == 0);
+        m_budget.start();
     }
 
     void extract_completions(const uint32_t num_completions) {
@@ -182,51 +279,71 @@ private:
         }
     };
 
-    uint32_t conjunctive_topk(completion_type& prefix, const range suffix,
-                              const uint32_t k) {
-        auto& topk_scores = m_pool.scores();
+    typedef min_heap<block_t, block_type_comparator> min_priority_queue_type;
+    min_priority_queue_type m_q;  // scratch memory, as the members above
 
-        typedef min_heap<block_t, block_type_comparator>
-            min_priority_queue_type;
+    /* scratch memory of a segment of the parallel queries */
+    struct segment_scratch {
         min_priority_queue_type q;
-        uint32_t current_block_id = m_inverted_index.block_id(suffix.begin);
-        uint32_t current_block_boundary =
-            m_inverted_index.block_boundary(current_block_id);
-        for (uint32_t i = suffix.begin; i != suffix.end; ++i) {
-            assert(i > 0);
-            if (i > current_block_boundary) {
-                q.push_back(m_inverted_index.block(current_block_id));
-                current_block_id += 1;
-                current_block_boundary =
-                    m_inverted_index.block_boundary(current_block_id);
-            }
+        typename BlockedInvertedIndex::intersection_iterator_type intersection;
+    };
+    segmented_buffers m_segmented;
+    std::vector<segment_scratch> m_segments;
+
+    /* push the blocks spanned by the range, but the first one
+       if it was already pushed for the previous range */
+    void push_blocks(min_priority_queue_type& q, const range r,
+                     uint32_t& next_block_id) {
+        assert(r.begin > 0);
+        uint32_t first = m_inverted_index.block_id(r.begin);
+        uint32_t last = m_inverted_index.block_id(r.end);
+        for (uint32_t b = std::max(first, next_block_id); b <= last; ++b) {
+            q.push_back(m_inverted_index.block(b));
         }
-        q.push_back(m_inverted_index.block(current_block_id));
+        next_block_id = last + 1;
+    }
+
+    void push_blocks(min_priority_queue_type& q, range_list const& ranges,
+                     uint32_t& next_block_id) {
+        for (auto r : ranges) push_blocks(q, r, next_block_id);
+    }
+
+    /* the number of blocks spanned by the range: an upper bound on the
+       number of blocks pushed, as two ranges may share a block */
+    uint64_t num_blocks(const range r) const {
+        assert(r.begin > 0);
+        return m_inverted_index.block_id(r.end) -
+               m_inverted_index.block_id(r.begin) + 1;
+    }
+
+    uint64_t num_blocks(range_list const& ranges) const {
+        uint64_t n = 0;
+        for (auto r : ranges) n += num_blocks(r);
+        return n;
+    }
+
+    // Range is either a range or a range_list
+    template <typename Range>
+    uint32_t conjunctive_topk(completion_type& prefix, Range const& suffix,
+                              const uint32_t k, tombstone_set const& deleted) {
+        auto& topk_scores = m_pool.scores();
+
+        auto& q = m_q;
+        q.clear();
+        q.reserve(num_blocks(suffix));
+        uint32_t next_block_id = 0;
+        push_blocks(q, suffix, next_block_id);
         q.make_heap();
+        const range suffix_hull = hull(suffix);
 
         uint32_t results = 0;
 
-        auto check = [&](block_t& block, id_type doc_id) {
-            uint64_t pos = block.docs_iterator.position();
-            assert(block.docs_iterator.access(pos) == doc_id);
-            uint64_t begin = block.offsets_iterator.access(pos);
-            uint64_t end = block.offsets_iterator.access(pos + 1);
-            assert(end > begin);
-            for (uint64_t i = begin; i != end; ++i) {
-                auto t = block.terms_iterator.access(i) + block.lower_bound;
-                if (t > suffix.end) break;
-                if (suffix.contains(t)) {
-                    topk_scores[results++] = doc_id;
-                    break;
-                }
-            }
-        };
-
         if (prefix.size() == 0) {
-            while (!q.empty()) {
+            while (!q.empty() and m_budget.spend()) {
                 auto& z = q.top();
                 auto doc_id = z.docs_iterator.operator*();
-                check(z, doc_id);
+                check(z, doc_id, suffix, suffix_hull, deleted,
+                      topk_scores.data(), results);
                 if (results == k) return results;
                 z.docs_iterator.next();
                 if (!z.docs_iterator.has_next()) q.pop();
@@ -234,34 +351,141 @@ private:
             }
         } else {
             deduplicate(prefix);
-            auto it = m_inverted_index.intersection_iterator(prefix, suffix);
-            for (; it.has_next() and !q.empty(); ++it) {
-                auto doc_id = *it;
-                while (!q.empty()) {
-                    auto& z = q.top();
-                    auto val = z.docs_iterator.operator*();
-                    if (val > doc_id) break;
-                    if (val < doc_id) {
-                        val = z.docs_iterator.next_geq(doc_id);
-                        if (!z.docs_iterator.has_next()) {
-                            q.pop();
-                        } else {
-                            q.heapify();
-                        }
+            if (is_heavy(prefix, suffix, q.size(), k)) {
+                ++m_parallel_queries;
+                return parallel_conjunctive_topk(prefix, suffix, suffix_hull,
+                                                 k, deleted);
+            }
+            auto& it = m_intersection;
+            m_inverted_index.intersection_iterator(prefix, suffix_hull, it, 0,
+                                                   &m_budget);
+            results = conjunctive_topk(
+                it, q, suffix, suffix_hull, k, deleted, topk_scores.data(),
+                [&](id_type) { return m_budget.spend(); });
+        }
+
+        return results;
+    }
+
+    /* the first k doc_ids of the intersection that are in a block
+       of the heap, visited as long as proceed(doc_id) */
+    template <typename Range, typename Proceed>
+    uint32_t conjunctive_topk(
+        typename BlockedInvertedIndex::intersection_iterator_type& it,
+        min_priority_queue_type& q, Range const& suffix,
+        const range suffix_hull, const uint32_t k,
+        tombstone_set const& deleted, id_type* topk_scores, Proceed proceed) {
+        uint32_t results = 0;
+        for (; it.has_next() and !q.empty(); ++it) {
+            auto doc_id = *it;
+            if (!proceed(doc_id)) break;
+            while (!q.empty()) {
+                auto& z = q.top();
+                auto val = z.docs_iterator.operator*();
+                if (val > doc_id) break;
+                if (val < doc_id) {
+                    val = z.docs_iterator.next_geq(doc_id);
+                    if (!z.docs_iterator.has_next()) {
+                        q.pop();
                     } else {
-                        if (val == doc_id) {
-                            check(z, doc_id);
-                            if (results == k) return results;
-                        }
-                        break;
+                        q.heapify();
                     }
+                } else {
+                    check(q, 0, doc_id, suffix, suffix_hull, deleted,
+                          topk_scores, results);
+                    if (results == k) return results;
+                    break;
                 }
             }
         }
-
         return results;
     }
 
+    /* report doc_id, the current doc_id of the block, if one of its
+       terms is in the suffix */
+    template <typename Range>
+    void check(block_t& block, id_type doc_id, Range const& suffix,
+               const range suffix_hull, tombstone_set const& deleted,
+               id_type* topk_scores, uint32_t& results) const {
+        if (deleted.contains(doc_id)) return;
+        // a doc_id may belong to more than one block
+        if (results > 0 and topk_scores[results - 1] == doc_id) return;
+        uint64_t pos = block.docs_iterator.position();
+        assert(block.docs_iterator.access(pos) == doc_id);
+        uint64_t begin = block.offsets_iterator.access(pos);
+        uint64_t end = block.offsets_iterator.access(pos + 1);
+        assert(end > begin);
+        for (uint64_t i = begin; i != end; ++i) {
+            auto t = block.terms_iterator.access(i) + block.lower_bound;
+            if (t > suffix_hull.end) break;
+            if (suffix.contains(t)) {
+                topk_scores[results++] = doc_id;
+                break;
+            }
+        }
+    }
+
+    /* check the blocks of the heap whose current doc_id is doc_id, up to
+       the first that reports it: as children are never less than their
+       parent, these blocks form a subtree rooted at the i-th block */
+    template <typename Range>
+    bool check(min_priority_queue_type& q, uint64_t i, id_type doc_id,
+               Range const& suffix, const range suffix_hull,
+               tombstone_set const& deleted, id_type* topk_scores,
+               uint32_t& results) const {
+        if (i >= q.size() or q[i].docs_iterator.operator*() != doc_id) {
+            return false;
+        }
+        uint32_t before = results;
+        check(q[i], doc_id, suffix, suffix_hull, deleted, topk_scores,
+              results);
+        if (results != before) return true;
+        return check(q, 2 * i + 1, doc_id, suffix, suffix_hull, deleted,
+                     topk_scores, results) or
+               check(q, 2 * i + 2, doc_id, suffix, suffix_hull, deleted,
+                     topk_scores, results);
+    }
+
+    /* the size of the block of a term bounds the size of its list */
+    template <typename Range>
+    bool is_heavy(completion_type const& prefix, Range const& suffix,
+                  uint64_t num_blocks, const uint32_t k) const {
+        if (!m_parallelism.enabled() or !m_budget.unlimited()) return false;
+        uint64_t min_list_size = m_inverted_index.num_docs();
+        for (auto term_id : prefix) {
+            auto b = m_inverted_index.block(m_inverted_index.block_id(term_id));
+            min_list_size = std::min(min_list_size, b.docs_iterator.size());
+        }
+        return ::autocomplete::is_heavy(m_inverted_index, min_list_size,
+                                        num_terms(suffix), num_blocks, k,
+                                        m_parallelism);
+    }
+
+    template <typename Range>
+    uint32_t parallel_conjunctive_topk(completion_type const& prefix,
+                                       Range const& suffix,
+                                       const range suffix_hull,
+                                       const uint32_t k,
+                                       tombstone_set const& deleted) {
+        auto search = [&](uint32_t s, id_type begin, id_type end,
+                          id_type* topk_scores, auto stop) {
+            auto& q = m_segments[s].q;
+            q.clear();
+            q.reserve(num_blocks(suffix));
+            uint32_t next_block_id = 0;
+            push_blocks(q, suffix, next_block_id);
+            q.make_heap();
+            auto& it = m_segments[s].intersection;
+            m_inverted_index.intersection_iterator(prefix, suffix_hull, it,
+                                                   begin);
+            return conjunctive_topk(
+                it, q, suffix, suffix_hull, k, deleted, topk_scores,
+                [&](id_type doc_id) { return doc_id < end and !stop(); });
+        };
+        return segmented_topk(*m_parallelism.pool, m_inverted_index.num_docs(),
+                              k, m_segmented, m_pool.scores(), search);
+    }
+
     iterator_type extract_strings(const uint32_t num_completions) {
         auto const& completions = m_topk_completion_set.completions();
         auto const& sizes = m_topk_completion_set.sizes();
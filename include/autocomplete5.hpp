@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cmath>
+
+#include "autocomplete.hpp"
+
+namespace autocomplete {
+
+enum class conjunctive_strategy { adaptive, forward, heap };
+
+/*
+The Strategy of autocomplete choosing, for each query, how the candidates
+of the intersection of the prefix terms are checked: either against the
+forward index or against a min-heap of the posting lists of the suffix
+range. A cost model picks the cheaper one.
+
+Assuming that the terms of a completion are independent, the fraction of
+the completions containing a term of the suffix range is about
+p = (suffix range width) * (avg. list size) / (num. completions),
+so that min(shortest prefix list, k / p) candidates are checked. A check
+costs the avg. number of terms per completion with the forward index,
+or a step per level of the heap, that in turn has to open the lists of
+the suffix range: the heap wins for narrow ranges.
+*/
+struct cost_model_strategy {
+    /* costs relative to the check of a term with the forward index:
+       hand-picked defaults, not the result of a tuning */
+    static constexpr double LIST_OPENING_COST = 8.0;
+    static constexpr double HEAP_LEVEL_COST = 2.0;  // a next_geq per level
+
+    conjunctive_strategy forced = conjunctive_strategy::adaptive;
+
+    template <typename InvertedIndex, typename Range>
+    bool use_heap(InvertedIndex const& index, completion_type const& prefix,
+                  Range const& suffix, uint32_t const k) const {
+        if (forced != conjunctive_strategy::adaptive) {
+            return forced == conjunctive_strategy::heap;
+        }
+        double num_docs = index.num_docs();
+        double num_postings = index.num_integers();
+        uint64_t min_list_size = index.num_docs();
+        for (auto term_id : prefix) {
+            uint64_t size = index.iterator(term_id - 1).size();
+            min_list_size = std::min(min_list_size, size);
+        }
+        double width = num_terms(suffix);
+        double p =
+            std::min(1.0, width * num_postings / index.num_terms() / num_docs);
+        double candidates = std::min<double>(min_list_size, k / p);
+        double forward_cost = candidates * num_postings / num_docs;
+        double heap_cost = width * LIST_OPENING_COST +
+                           candidates * HEAP_LEVEL_COST * std::log2(width + 1);
+        return heap_cost < forward_cost;
+    }
+};
+
+/* the data structures of autocomplete (type 1), with the conjunctive
+   strategy chosen per query by the cost model */
+template <typename Completions, typename Dictionary, typename InvertedIndex,
+          typename ForwardIndex, typename RMQ = cartesian_tree>
+struct autocomplete5
+    : autocomplete<Completions, Dictionary, InvertedIndex, ForwardIndex, RMQ,
+                   cost_model_strategy> {
+    typedef autocomplete<Completions, Dictionary, InvertedIndex, ForwardIndex,
+                         RMQ, cost_model_strategy>
+        base_type;
+    typedef conjunctive_strategy strategy;
+
+    autocomplete5() {}
+
+    autocomplete5(parameters const& params)
+        : base_type(params) {}
+
+    /* a strategy other than adaptive is used for all the queries */
+    void set_strategy(strategy s) {
+        this->m_strategy.forced = s;
+    }
+
+    /* number of conjunctive steps run with the heap, and in total,
+       by the queries without a context */
+    uint64_t heap_queries() const {
+        return this->m_context.heap_queries;
+    }
+
+    uint64_t conjunctive_queries() const {
+        return this->m_context.conjunctive_queries;
+    }
+};
+}  // namespace autocomplete
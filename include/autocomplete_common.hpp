@@ -1,19 +1,24 @@
 #pragma once
 
 #include "util_types.hpp"
+#include "fuzzy_search.hpp"
+#include "normaliser.hpp"
 #include "min_heap.hpp"
 #include "unsorted_list.hpp"
 #include "minimal_docids.hpp"
+#include "tombstones.hpp"
+#include "search_budget.hpp"
 #include "succinct_rmq/cartesian_tree.hpp"
+#include "sparse_table_rmq.hpp"
 
 namespace autocomplete {
 
 typedef unsorted_list<cartesian_tree> unsorted_list_type;
 
 template <typename Dictionary>
-bool parse(Dictionary const& dict, std::string const& query,
-           completion_type& prefix, byte_range& suffix, bool must_find_prefix) {
-    byte_range_iterator it(string_to_byte_range(query));
+bool parse(Dictionary const& dict, byte_range query, completion_type& prefix,
+           byte_range& suffix, bool must_find_prefix) {
+    byte_range_iterator it(query);
     while (true) {
         suffix = it.next();
         if (!it.has_next()) break;
@@ -27,27 +32,106 @@ bool parse(Dictionary const& dict, std::string const& query,
     return true;
 }
 
+template <typename Dictionary>
+bool parse(Dictionary const& dict, std::string const& query,
+           completion_type& prefix, byte_range& suffix, bool must_find_prefix) {
+    return parse(dict, string_to_byte_range(query), prefix, suffix,
+                 must_find_prefix);
+}
+
 void deduplicate(completion_type& c) {
     std::sort(c.begin(), c.end());
     auto end = std::unique(c.begin(), c.end());
     c.resize(std::distance(c.begin(), end));
 }
 
-template <typename InvertedIndex>
-uint32_t heap_topk(InvertedIndex const& index, const range r, const uint32_t k,
-                   std::vector<id_type>& topk_scores) {
+template <typename InvertedIndex, typename MinHeap>
+void push_iterators(InvertedIndex const& index, MinHeap& q, const range r) {
     assert(r.is_valid());
-
-    typedef min_heap<typename InvertedIndex::iterator_type,
-                     iterator_comparator<typename InvertedIndex::iterator_type>>
-        min_priority_queue_type;
-
-    min_priority_queue_type q;
-    q.reserve(r.end - r.begin + 1);  // inclusive range
     assert(r.begin > 0);
     for (uint64_t term_id = r.begin; term_id <= r.end; ++term_id) {
         q.push_back(index.iterator(term_id - 1));
     }
+}
+
+template <typename InvertedIndex, typename MinHeap>
+void push_iterators(InvertedIndex const& index, MinHeap& q,
+                    range_list const& ranges) {
+    for (auto r : ranges) push_iterators(index, q, r);
+}
+
+/* the first k doc_ids of the intersection it that are in a list of the
+   heap q, visited as long as proceed(doc_id) */
+template <typename Iterator, typename MinHeap, typename Proceed>
+uint32_t heap_conjunctive_topk(Iterator& it, MinHeap& q, const uint32_t k,
+                               tombstone_set const& deleted,
+                               id_type* topk_scores, Proceed proceed) {
+    uint32_t results = 0;
+    for (; it.has_next() and !q.empty(); ++it) {
+        auto doc_id = *it;
+        if (!proceed(doc_id)) break;
+        while (!q.empty()) {
+            auto& z = q.top();
+            auto val = *z;
+            if (val > doc_id) break;
+            if (val < doc_id) {
+                val = z.next_geq(doc_id);
+                if (!z.has_next()) {
+                    q.pop();
+                } else {
+                    q.heapify();
+                }
+            }
+            if (val == doc_id) {  // NOTE: putting else here seems to slow
+                                  // down the code!
+                if (!deleted.contains(doc_id)) {
+                    topk_scores[results++] = doc_id;
+                    if (results == k) return results;
+                }
+                break;
+            }
+        }
+    }
+
+    return results;
+}
+
+uint64_t num_terms(const range r) {
+    return r.end - r.begin + 1;  // inclusive range
+}
+
+uint64_t num_terms(range_list const& ranges) {
+    uint64_t n = 0;
+    for (auto r : ranges) n += num_terms(r);
+    return n;
+}
+
+/* the smallest range including all the given ones */
+range hull(const range r) {
+    return r;
+}
+
+range hull(range_list const& ranges) {
+    assert(!ranges.empty());
+    return {ranges.front().begin, ranges.back().end};
+}
+
+/* Range is either a range or a range_list: the posting lists of all
+   the terms are merged at once, so that the doc_ids are reported in
+   sorted order and a duplicate always follows the last reported doc_id.
+   The heap q is scratch memory, kept across queries to avoid allocating:
+   it only grows when a range is wider than all the previous ones.
+   The postings are visited as long as proceed(doc_id) */
+template <typename InvertedIndex, typename Range, typename Proceed>
+uint32_t heap_topk(InvertedIndex const& index, Range const& r,
+                   const uint32_t k, std::vector<id_type>& topk_scores,
+                   min_heap<typename InvertedIndex::iterator_type,
+                            iterator_comparator<
+                                typename InvertedIndex::iterator_type>>& q,
+                   tombstone_set const& deleted, Proceed proceed) {
+    q.clear();
+    q.reserve(num_terms(r));
+    push_iterators(index, q, r);
     q.make_heap();
 
     uint32_t results = 0;
@@ -55,9 +139,10 @@ uint32_t heap_topk(InvertedIndex const& index, const range r, const uint32_t k,
     while (!q.empty()) {
         auto& z = q.top();
         auto doc_id = *z;
-        bool alread_present = std::binary_search(
-            topk_scores.begin(), topk_scores.begin() + results, doc_id);
-        if (!alread_present) {
+        if (!proceed(doc_id)) break;
+        bool alread_present =
+            results > 0 and topk_scores[results - 1] == doc_id;
+        if (!alread_present and !deleted.contains(doc_id)) {
             topk_scores[results++] = doc_id;
             if (results == k) return results;
         }
@@ -69,4 +154,25 @@ uint32_t heap_topk(InvertedIndex const& index, const range r, const uint32_t k,
     return results;
 }
 
+template <typename InvertedIndex, typename Range>
+uint32_t heap_topk(InvertedIndex const& index, Range const& r,
+                   const uint32_t k, std::vector<id_type>& topk_scores,
+                   min_heap<typename InvertedIndex::iterator_type,
+                            iterator_comparator<
+                                typename InvertedIndex::iterator_type>>& q,
+                   tombstone_set const& deleted = tombstone_set::empty_set()) {
+    return heap_topk(index, r, k, topk_scores, q, deleted,
+                     [](id_type) { return true; });
+}
+
+template <typename InvertedIndex, typename Range>
+uint32_t heap_topk(InvertedIndex const& index, Range const& r,
+                   const uint32_t k, std::vector<id_type>& topk_scores,
+                   tombstone_set const& deleted = tombstone_set::empty_set()) {
+    min_heap<typename InvertedIndex::iterator_type,
+             iterator_comparator<typename InvertedIndex::iterator_type>>
+        q;
+    return heap_topk(index, r, k, topk_scores, q, deleted);
+}
+
 }  // namespace autocomplete
\ No newline at end of file
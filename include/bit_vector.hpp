@@ -72,7 +72,8 @@ private:
 
 struct bit_vector_builder {
     bit_vector_builder(uint64_t size = 0, bool init = 0)
-        : m_size(size) {
+        : m_size(size)
+        , m_cur_word(nullptr) {
         m_bits.resize(essentials::words_for(size), uint64_t(-init));
         if (size) {
             m_cur_word = &m_bits.back();
@@ -279,6 +280,12 @@ struct bit_vector {
         }
     }
 
+    template <uint64_t Len>
+    inline uint64_t get_bits(uint64_t pos) const {
+        assert(pos + Len <= size());
+        return util::get_bits<Len>(m_bits.data(), pos);
+    }
+
     // fast and unsafe version: it retrieves at least 56 bits
     inline uint64_t get_word56(uint64_t pos) const {
         const char* base_ptr = reinterpret_cast<const char*>(m_bits.data());
@@ -420,6 +427,18 @@ struct bits_getter {
                          (m_data[block + 1] << (64 - shift) & m_mask);
     }
 
+    /* access(i) with constant shifts and masks: to be called within
+       util::with_width(width(), ...) */
+    template <uint64_t Width>
+    inline uint64_t access(uint64_t i) const {
+        assert(Width == m_width);
+        return util::get_bits<Width>(m_data, m_base + i * Width);
+    }
+
+    uint64_t width() const {
+        return m_width;
+    }
+
 private:
     uint64_t const* m_data;
     uint64_t m_base;
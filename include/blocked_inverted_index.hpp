@@ -7,6 +7,7 @@
 #include "ef/ef_sequence.hpp"
 #include "ef/compact_ef.hpp"
 #include "parameters.hpp"
+#include "search_budget.hpp"
 
 namespace autocomplete {
 
@@ -261,22 +262,40 @@ struct blocked_inverted_index {
         docs_iterator_type docs_iterator;
         offsets_iterator_type offsets_iterator;
         terms_iterator_type terms_iterator;
-        std::vector<id_type> term_ids;
+        // NOTE: points into the term_ids of the intersection
+        uint32_range term_ids;
         id_type lower_bound;
     };
 
     struct intersection_iterator_type {
+        intersection_iterator_type()
+            : m_budget(nullptr) {
+            m_blocks.reserve(constants::MAX_NUM_TERMS_PER_QUERY);
+        }
+
         intersection_iterator_type(blocked_inverted_index const* ii,
-                                   std::vector<id_type>& term_ids,
-                                   const range r)
-            : m_i(0)
-            , m_num_docs(ii->num_docs())
-            , m_suffix(r) {
+                                   std::vector<id_type> const& term_ids,
+                                   const range r) {
+            init(ii, term_ids, r);
+        }
+
+        /* (re-)start the intersection from the doc_id first, reusing
+           the memory of the previous one: term_ids must outlive the
+           iterator. Every posting visited is charged to the budget, if
+           any, and the intersection ends when the budget is over */
+        void init(blocked_inverted_index const* ii,
+                  std::vector<id_type> const& term_ids, const range r,
+                  id_type first = 0, search_budget* budget = nullptr) {
             assert(r.is_valid());
             assert(!term_ids.empty());
             assert(std::is_sorted(term_ids.begin(), term_ids.end()));
-            assert(std::unique(term_ids.begin(), term_ids.end()) ==
+            assert(std::adjacent_find(term_ids.begin(), term_ids.end()) ==
                    term_ids.end());
+            m_i = 0;
+            m_num_docs = ii->num_docs();
+            m_suffix = r;
+            m_budget = budget;
+            m_blocks.clear();
 
             m_blocks.reserve(term_ids.size());  // at most
             uint32_t current_block_id = ii->block_id(term_ids.front());
@@ -288,21 +307,17 @@ struct blocked_inverted_index {
                 uint32_t b = ii->block_id(term_id);
                 if (b > current_block_id) {
                     auto block = ii->block(current_block_id);
-                    block.term_ids.reserve(term_ids.size());  // at most
-                    for (; prev_i != i; ++prev_i) {
-                        block.term_ids.push_back(term_ids[prev_i]);
-                    }
-                    m_blocks.push_back(std::move(block));
+                    block.term_ids = {term_ids.data() + prev_i,
+                                      term_ids.data() + i};
+                    m_blocks.push_back(block);
+                    prev_i = i;
                 }
                 current_block_id = b;
             }
 
             auto block = ii->block(current_block_id);
-            block.term_ids.reserve(term_ids.size());  // at most
-            for (; prev_i != i; ++prev_i) {
-                block.term_ids.push_back(term_ids[prev_i]);
-            }
-            m_blocks.push_back(std::move(block));
+            block.term_ids = {term_ids.data() + prev_i, term_ids.data() + i};
+            m_blocks.push_back(block);
 
             std::sort(m_blocks.begin(), m_blocks.end(),
                       [](auto const& l, auto const& r) {
@@ -310,7 +325,13 @@ struct blocked_inverted_index {
                                  r.docs_iterator.size();
                       });
 
-            m_candidate = m_blocks[0].docs_iterator.access(0);
+            if (first == 0) {
+                m_candidate = m_blocks[0].docs_iterator.access(0);
+            } else {
+                // NOTE: the blocks are advanced by scan from now on
+                for (auto& b : m_blocks) b.docs_iterator.next_geq(first);
+                m_candidate = *m_blocks[0].docs_iterator;
+            }
 
             next();
         }
@@ -325,9 +346,7 @@ struct blocked_inverted_index {
 
         void operator++() {
             assert(m_i == m_blocks.size());
-            if (m_blocks.size() > 1) {
-                m_candidate = m_blocks[0].docs_iterator.next();
-            }
+            m_candidate = m_blocks[0].docs_iterator.next();
             m_i = 0;
             next();
         }
@@ -337,8 +356,16 @@ struct blocked_inverted_index {
         size_t m_i;
         uint64_t m_num_docs;
         std::vector<block_type> m_blocks;
-        std::vector<block_type> m_range;
         range m_suffix;
+        search_budget* m_budget;
+
+        bool spend() {
+            if (m_budget and !m_budget->spend()) {
+                m_candidate = m_num_docs;
+                return false;
+            }
+            return true;
+        }
 
         bool in() {  // is candidate doc in intersection?
 
@@ -348,10 +375,13 @@ struct blocked_inverted_index {
             uint64_t begin = b.offsets_iterator.access(pos);
             uint64_t end = b.offsets_iterator.access(pos + 1);
             assert(end > begin);
-            if (end - begin < b.term_ids.size()) return false;
+            if (end - begin < uint64_t(b.term_ids.end - b.term_ids.begin)) {
+                return false;
+            }
 
             uint64_t i = begin;
-            for (auto x : b.term_ids) {
+            for (auto p = b.term_ids.begin; p != b.term_ids.end; ++p) {
+                auto x = *p;
                 bool found = false;
                 for (; i != end; ++i) {
                     auto t = b.terms_iterator.access(i) + b.lower_bound;
@@ -370,11 +400,16 @@ struct blocked_inverted_index {
             if (m_blocks.size() == 1) {
                 while (m_candidate < m_num_docs and m_i != m_blocks.size()) {
                     assert(m_i == 0);
-                    m_candidate = m_blocks[m_i].docs_iterator.next();
-                    if (in()) ++m_i;
+                    if (!spend()) return;
+                    if (in()) {
+                        ++m_i;
+                    } else {
+                        m_candidate = m_blocks[m_i].docs_iterator.next();
+                    }
                 }
             } else {
                 while (m_candidate < m_num_docs and m_i != m_blocks.size()) {
+                    if (!spend()) return;
                     // NOTE: since we work with unions of posting lists,
                     // next_geq by scan runs faster
                     auto val = m_blocks[m_i].docs_iterator.next_geq_by_scan(
@@ -392,32 +427,39 @@ struct blocked_inverted_index {
     };
 
     intersection_iterator_type intersection_iterator(
-        std::vector<id_type>& term_ids, const range r) {
+        std::vector<id_type> const& term_ids, const range r) {
         return intersection_iterator_type(this, term_ids, r);
     }
 
+    void intersection_iterator(std::vector<id_type> const& term_ids,
+                               const range r, intersection_iterator_type& it,
+                               id_type first = 0,
+                               search_budget* budget = nullptr) const {
+        it.init(this, term_ids, r, first, budget);
+    }
+
     block_type block(uint32_t block_id) const {
         assert(block_id < num_blocks());
         block_type b;
-        b.term_ids.resize(0);
+        b.term_ids = {nullptr, nullptr};
         b.lower_bound = block_id > 0 ? m_blocks[block_id - 1] : 1;
 
         {
             uint64_t offset = m_pointers_to_lists.access(block_id);
-            uint32_t n = m_lists.get_bits(offset, 32);
+            uint32_t n = m_lists.get_bits<32>(offset);
             docs_iterator_type it(m_lists, offset + 32, m_num_docs, n);
             b.docs_iterator = it;
         }
         {
             uint64_t offset = m_pointers_to_offsets.access(block_id);
-            uint32_t n = m_offsets.get_bits(offset, 32);
-            uint32_t universe = m_offsets.get_bits(offset + 32, 32);
+            uint32_t n = m_offsets.get_bits<32>(offset);
+            uint32_t universe = m_offsets.get_bits<32>(offset + 32);
             offsets_iterator_type it(m_offsets, offset + 32 + 32, universe, n);
             b.offsets_iterator = it;
         }
         {
             uint64_t offset = m_pointers_to_terms.access(block_id);
-            uint32_t width = m_terms.get_bits(offset, 6);
+            uint32_t width = m_terms.get_bits<6>(offset);
             terms_iterator_type it(m_terms, offset + 6, width);
             b.terms_iterator = it;
         }
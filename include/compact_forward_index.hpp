@@ -1,14 +1,24 @@
 #pragma once
 
+#include <numeric>
+
 #include "parameters.hpp"
 #include "compact_vector.hpp"
 #include "ef/ef_sequence.hpp"
 
 namespace autocomplete {
 
+/*
+The terms of each completion are stored sorted, so that intersects()
+is a binary search, along with the rank of each term in the sorted list,
+so that the iterator still returns the terms in the completion order.
+The ranks take ceil(log2(max. number of terms per completion)) bits each.
+*/
 struct compact_forward_index {
     struct builder {
-        builder() {}
+        builder()
+            : m_num_integers(0)
+            , m_num_terms(0) {}
 
         builder(parameters const& params)
             : m_num_integers(0)
@@ -19,9 +29,11 @@ struct compact_forward_index {
                 (params.collection_basename + ".forward").c_str(),
                 std::ios_base::in);
             std::vector<id_type> terms;
-            terms.reserve(universe *
-                          constants::MAX_NUM_TERMS_PER_QUERY);  // at most
+            std::vector<id_type> ranks;
+            std::vector<id_type> list;
+            std::vector<id_type> order;
             uint64_t size = 0;
+            uint32_t max_list_size = 1;
             m_pointers.push_back(0);
             for (uint64_t i = 0; i != universe; ++i) {
                 uint32_t n = 0;
@@ -29,17 +41,32 @@ struct compact_forward_index {
                 assert(n < constants::MAX_NUM_TERMS_PER_QUERY);
                 m_num_integers += n;
                 size += n;
+                if (n > max_list_size) max_list_size = n;
+                list.resize(n);
+                for (uint64_t k = 0; k != n; ++k) {
+                    input >> list[k];
+                    assert(list[k] > 0);
+                }
+                order.resize(n);
+                std::iota(order.begin(), order.end(), 0);
+                std::stable_sort(order.begin(), order.end(),
+                                 [&](id_type l, id_type r) {
+                                     return list[l] < list[r];
+                                 });
+                uint64_t base = ranks.size();
+                ranks.resize(base + n);
                 for (uint64_t k = 0; k != n; ++k) {
-                    id_type x;
-                    input >> x;
-                    assert(x > 0);
-                    terms.push_back(x);
+                    terms.push_back(list[order[k]]);
+                    ranks[base + order[k]] = k;
                 }
                 m_pointers.push_back(size);
             }
             input.close();
             m_data.resize(terms.size(), util::ceil_log2(m_num_terms + 1));
             m_data.fill(terms.begin(), terms.size());
+            uint64_t rank_width = util::ceil_log2(max_list_size);
+            m_ranks.resize(ranks.size(), std::max<uint64_t>(rank_width, 1));
+            m_ranks.fill(ranks.begin(), ranks.size());
             essentials::logger("DONE");
         }
 
@@ -48,6 +75,7 @@ struct compact_forward_index {
             std::swap(other.m_num_terms, m_num_terms);
             other.m_pointers.swap(m_pointers);
             other.m_data.swap(m_data);
+            other.m_ranks.swap(m_ranks);
         }
 
         void build(compact_forward_index& fi) {
@@ -55,6 +83,7 @@ struct compact_forward_index {
             fi.m_num_terms = m_num_terms;
             fi.m_pointers.build(m_pointers);
             m_data.build(fi.m_data);
+            m_ranks.build(fi.m_ranks);
             builder().swap(*this);
         }
 
@@ -63,14 +92,17 @@ struct compact_forward_index {
         uint64_t m_num_terms;
         std::vector<uint64_t> m_pointers;
         compact_vector::builder m_data;
+        compact_vector::builder m_ranks;
     };
 
     compact_forward_index() {}
 
     struct forward_list_iterator_type {
-        forward_list_iterator_type(compact_vector const& cv, uint64_t pos,
+        forward_list_iterator_type(compact_vector const& cv,
+                                   compact_vector const& ranks, uint64_t pos,
                                    uint64_t n)
             : m_cv(cv)
+            , m_ranks(ranks)
             , m_base(pos)
             , m_n(n)
             , m_i(0) {}
@@ -83,34 +115,65 @@ struct compact_forward_index {
             m_i += 1;
         }
 
+        // the terms are returned in the completion order
         id_type operator*() const {
-            return m_cv[m_base + m_i];
+            return m_cv[m_base + m_ranks[m_base + m_i]];
         }
 
         bool intersects(const range r) const {
-            for (uint64_t i = 0; i != size(); ++i) {
-                auto val = m_cv[m_base + i];
-                assert(val > 0);
-                if (r.contains(val)) return true;
-            }
-            return false;
+            return util::with_width(m_cv.width(), [&](auto w) {
+                uint64_t i = lower_bound<w>(0, r.begin);
+                return i != size() and m_cv.access<w>(m_base + i) <= r.end;
+            });
+        }
+
+        /* the ranges are sorted: each search starts where the previous
+           one stopped */
+        bool intersects(range_list const& ranges) const {
+            return util::with_width(m_cv.width(), [&](auto w) {
+                uint64_t i = 0;
+                for (auto r : ranges) {
+                    i = lower_bound<w>(i, r.begin);
+                    if (i == size()) return false;
+                    if (m_cv.access<w>(m_base + i) <= r.end) return true;
+                }
+                return false;
+            });
         }
 
     private:
         compact_vector const& m_cv;
+        compact_vector const& m_ranks;
         uint64_t m_base;
         uint64_t m_n;
         uint64_t m_i;
+
+        /* position of the first sorted term >= val, from position i */
+        template <uint64_t Width>
+        uint64_t lower_bound(uint64_t i, const uint64_t val) const {
+            uint64_t n = size() - i;
+            while (n > 0) {
+                uint64_t half = n / 2;
+                if (m_cv.access<Width>(m_base + i + half) < val) {
+                    i += half + 1;
+                    n -= half + 1;
+                } else {
+                    n = half;
+                }
+            }
+            return i;
+        }
     };
 
-    forward_list_iterator_type iterator(id_type doc_id) {
+    forward_list_iterator_type iterator(id_type doc_id) const {
         assert(doc_id < num_docs());
         uint64_t pos = m_pointers.access(doc_id);
         uint64_t n = m_pointers.access(doc_id + 1) - pos;
-        return {m_data, pos, n};
+        return {m_data, m_ranks, pos, n};
     }
 
-    bool intersects(const id_type doc_id, const range r) {
+    template <typename Range>
+    bool intersects(const id_type doc_id, Range const& r) const {
         return iterator(doc_id).intersects(r);
     }
 
@@ -134,10 +197,14 @@ struct compact_forward_index {
         return m_pointers.bytes();
     }
 
+    size_t ranks_bytes() const {
+        return m_ranks.bytes();
+    }
+
     size_t bytes() const {
         return essentials::pod_bytes(m_num_integers) +
                essentials::pod_bytes(m_num_terms) + m_pointers.bytes() +
-               m_data.bytes();
+               m_data.bytes() + m_ranks.bytes();
     }
 
     template <typename Visitor>
@@ -146,6 +213,7 @@ struct compact_forward_index {
         visitor.visit(m_num_terms);
         visitor.visit(m_pointers);
         visitor.visit(m_data);
+        visitor.visit(m_ranks);
     }
 
 private:
@@ -153,6 +221,7 @@ private:
     uint64_t m_num_terms;
     ef::ef_sequence m_pointers;
     compact_vector m_data;
+    compact_vector m_ranks;
 };
 
 }  // namespace autocomplete
\ No newline at end of file
@@ -1,9 +1,127 @@
 #pragma once
 
+#include <array>
+#include <utility>
+
 #include "util.hpp"
 
 namespace autocomplete {
 
+namespace detail {
+
+/* the value of Width bits starting at bit pos: as access(), a value of
+   at most 57 bits is read with a single (unaligned) load of the 8 bytes
+   starting at its first byte */
+template <uint64_t Width>
+inline uint64_t compact_vector_get(uint64_t const* bits, uint64_t pos) {
+    if constexpr (Width <= 57) {
+        const char* ptr = reinterpret_cast<const char*>(bits);
+        return (*(reinterpret_cast<uint64_t const*>(ptr + (pos >> 3))) >>
+                (pos & 7)) &
+               util::width_mask<Width>();
+    } else {
+        return util::get_bits<Width>(bits, pos);
+    }
+}
+
+/*
+Kernels decoding runs of values of a compact_vector, one per width, so
+that shifts and masks are constants. The values of a long run that fill
+whole blocks of 64 values, i.e., of width words, are decoded with the
+offsets of the loads resolved at compile time. With AVX2, values of at
+most 25 bits are decoded into 32-bit integers 8 at a time, with a gather.
+*/
+template <typename T>
+struct compact_vector_decoders {
+    typedef void (*decoder_type)(uint64_t const* bits, uint64_t begin,
+                                 uint64_t n, T* out);
+
+#ifdef __AVX2__
+    static constexpr uint64_t gather_width = sizeof(T) == 4 ? 25 : 0;
+#else
+    static constexpr uint64_t gather_width = 0;
+#endif
+
+    template <uint64_t Width>
+    static void decode(uint64_t const* bits, uint64_t begin, uint64_t n,
+                       T* out) {
+        uint64_t end = begin + n;
+        uint64_t i = begin;
+#ifdef __AVX2__
+        if constexpr (Width <= gather_width) {
+            /* 8 values per gather of the 4 bytes starting at their first
+               byte; the last values with a masked gather and store */
+            char const* ptr = reinterpret_cast<char const*>(bits);
+            __m256i const lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            __m256i const offsets =
+                _mm256_mullo_epi32(lanes, _mm256_set1_epi32(Width));
+            __m256i const m = _mm256_set1_epi32(util::width_mask<Width>());
+            __m256i const seven = _mm256_set1_epi32(7);
+            for (; i < end; i += 8, out += 8) {
+                uint64_t pos = i * Width;
+                int const* base =
+                    reinterpret_cast<int const*>(ptr + (pos >> 3));
+                __m256i p =
+                    _mm256_add_epi32(_mm256_set1_epi32(pos & 7), offsets);
+                __m256i index = _mm256_srli_epi32(p, 3);
+                __m256i v;
+                if (i + 8 <= end) {
+                    v = _mm256_i32gather_epi32(base, index, 1);
+                } else {
+                    __m256i live =
+                        _mm256_cmpgt_epi32(_mm256_set1_epi32(end - i), lanes);
+                    v = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(),
+                                                    base, index, live, 1);
+                    v = _mm256_and_si256(
+                        _mm256_srlv_epi32(v, _mm256_and_si256(p, seven)), m);
+                    _mm256_maskstore_epi32(reinterpret_cast<int*>(out), live,
+                                           v);
+                    break;
+                }
+                v = _mm256_and_si256(
+                    _mm256_srlv_epi32(v, _mm256_and_si256(p, seven)), m);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), v);
+            }
+            return;
+        }
+#endif
+        if (n >= 128) {
+            uint64_t head = (begin + 63) & ~uint64_t(63);
+            for (; i != head; ++i) *out++ = get<Width>(bits, i * Width);
+            for (; i + 64 <= end; i += 64, out += 64) {
+                block<Width>(bits + (i >> 6) * Width, out,
+                             std::make_index_sequence<64>());
+            }
+        }
+        for (; i != end; ++i) *out++ = get<Width>(bits, i * Width);
+    }
+
+private:
+    template <uint64_t Width>
+    static inline T get(uint64_t const* bits, uint64_t pos) {
+        return compact_vector_get<Width>(bits, pos);
+    }
+
+    template <uint64_t Width, uint64_t... J>
+    static inline void block(uint64_t const* words, T* out,
+                             std::index_sequence<J...>) {
+        ((out[J] = get<Width>(words, J * Width)), ...);
+    }
+
+    template <uint64_t... Width>
+    static constexpr std::array<decoder_type, 65> make_table(
+        std::index_sequence<Width...>) {
+        // width 0 is not valid
+        return {{&decode<Width ? Width : 1>...}};
+    }
+
+public:
+    static constexpr std::array<decoder_type, 65> table =
+        make_table(std::make_index_sequence<65>());
+};
+
+}  // namespace detail
+
 struct compact_vector {
     template <typename Data>
     struct enumerator {
@@ -74,7 +192,10 @@ struct compact_vector {
 
     struct builder {
         builder()
-            : m_back(0)
+            : m_size(0)
+            , m_width(0)
+            , m_mask(0)
+            , m_back(0)
             , m_cur_block(0)
             , m_cur_shift(0) {}
 
@@ -262,6 +383,28 @@ struct compact_vector {
         util::prefetch(m_bits.data() + i);
     }
 
+    /* access(i) for a vector of the given width, with constant shifts
+       and masks: to be called within util::with_width(width(), ...) */
+    template <uint64_t Width>
+    inline uint64_t access(uint64_t i) const {
+        assert(i < size());
+        assert(Width == m_width);
+        return detail::compact_vector_get<Width>(m_bits.data(), i * Width);
+    }
+
+    /* decode the values in [begin, begin + n) into out */
+    template <typename T>
+    void decode(uint64_t begin, uint64_t n, T* out) const {
+        assert(begin + n <= size());
+        typedef detail::compact_vector_decoders<T> decoders;
+        if (n < 8 and m_width > decoders::gather_width and m_width <= 57) {
+            // not worth a call to a kernel
+            for (uint64_t i = 0; i != n; ++i) out[i] = access(begin + i);
+            return;
+        }
+        decoders::table[m_width](m_bits.data(), begin, n, out);
+    }
+
     uint64_t back() const {
         return operator[](size() - 1);
     }
@@ -2,12 +2,16 @@
 
 #include "parameters.hpp"
 #include "util_types.hpp"
+#include "interleaved_nodes.hpp"
 
 namespace autocomplete {
 
 template <typename Nodes, typename Pointers, typename LeftExtremes,
           typename Sizes>
 struct completion_trie {
+    static constexpr bool interleaved =
+        std::is_same<Pointers, interleaved_pointers>::value;
+
     struct builder {
         builder() {}
 
@@ -145,6 +149,11 @@ struct completion_trie {
                 } else {
                     ct.m_nodes[i].build(m_nodes[i]);
                 }
+                if constexpr (interleaved) {
+                    if (i != levels - 1) {
+                        ct.m_nodes[i].build_children(m_pointers[i]);
+                    }
+                }
             }
 
             builder().swap(*this);
@@ -170,28 +179,45 @@ struct completion_trie {
     // Return [a,b)
     range locate_prefix(completion_type const& prefix,
                         range suffix_lex_range) const {
-        range r = global::invalid_range;
-        range pointer{0, m_nodes.front().size()};
-        uint32_t i = 0;
-
-        for (; i < prefix.size(); ++i) {
-            uint64_t pos = m_nodes[i].find(pointer, prefix[i]);
-            if (pos == global::not_found) return global::invalid_range;
-            pointer = m_pointers[i][pos];
+        range pointer = root();
+        for (uint32_t i = 0; i < prefix.size(); ++i) {
+            if (!descend(i, prefix[i], pointer)) return global::invalid_range;
         }
+        return locate_suffix(prefix.size(), pointer, suffix_lex_range);
+    }
+
+    /* The steps of locate_prefix, for the callers interleaving many
+       searches (see interleaved_locate.hpp): starting from the root,
+       descend to the children of the node id among the nodes of the
+       level in pointer, then locate the suffix among the nodes reached. */
+    range root() const {
+        return {0, m_nodes.front().size()};
+    }
+
+    /* false if there is no such node; the children are prefetched */
+    bool descend(uint32_t level, id_type id, range& pointer) const {
+        uint64_t pos = m_nodes[level].find(pointer, id);
+        if (pos == global::not_found) return false;
+        pointer = children(level, pos);
+        if (level + 1 < m_nodes.size()) prefetch(level + 1, pointer);
+        return true;
+    }
 
-        if (i < m_nodes.size()) {
-            range q = m_nodes[i].find(pointer, suffix_lex_range);
+    range locate_suffix(uint32_t level, range pointer,
+                        range suffix_lex_range) const {
+        range r = global::invalid_range;
+        if (level < m_nodes.size()) {
+            range q = m_nodes[level].find(pointer, suffix_lex_range);
             assert(q.begin <= q.end);
             if (q.begin == q.end) return global::invalid_range;
             assert(q.end > q.begin);
             uint64_t begin = q.begin;
             uint64_t end = q.end - 1;
-            r.begin = m_left_extremes[i].access(begin) + begin;
-            r.end =
-                end != begin ? m_left_extremes[i].access(end) + end : r.begin;
-            uint64_t size = m_sizes[i].access(end) -
-                            (end ? m_sizes[i].access(end - 1) : 0) + 1;
+            r.begin = m_left_extremes[level].access(begin) + begin;
+            r.end = end != begin ? m_left_extremes[level].access(end) + end
+                                 : r.begin;
+            uint64_t size = m_sizes[level].access(end) -
+                            (end ? m_sizes[level].access(end - 1) : 0) + 1;
             r.end += size;
         }
 
@@ -207,7 +233,7 @@ struct completion_trie {
         for (uint32_t i = 0; i <= levels; ++i) {
             uint64_t pos = m_nodes[i].find(pointer, c[i]);
             if (pos == global::not_found) return false;
-            if (i != levels) pointer = m_pointers[i][pos];
+            if (i != levels) pointer = children(i, pos);
         }
         return true;
     }
@@ -274,5 +300,29 @@ private:
     std::vector<Pointers> m_pointers;
     std::vector<LeftExtremes> m_left_extremes;
     std::vector<Sizes> m_sizes;
+
+    range children(uint32_t level, uint64_t pos) const {
+        if constexpr (interleaved) {
+            return m_nodes[level].children(pos);
+        } else {
+            return m_pointers[level][pos];
+        }
+    }
+
+    // The nodes of the next level are searched within [pointer.begin,
+    // pointer.end): start loading the first positions of the search,
+    // that otherwise would be cache misses one after the other.
+    void prefetch(uint32_t level, range pointer) const {
+        if (pointer.begin == pointer.end) return;
+        auto const& nodes = m_nodes[level];
+        if (!interleaved and pointer.begin) nodes.prefetch(pointer.begin - 1);
+        nodes.prefetch(pointer.begin);
+        nodes.prefetch(pointer.begin + (pointer.end - pointer.begin) / 2);
+        if constexpr (!interleaved) {
+            if (level < m_pointers.size()) {
+                m_pointers[level].prefetch(pointer.begin);
+            }
+        }
+    }
 };
 }  // namespace autocomplete
@@ -6,6 +6,14 @@ static const uint32_t MAX_K = 15;
 static const uint32_t MAX_NUM_TERMS_PER_QUERY = 64;
 static const uint32_t MAX_NUM_CHARS_PER_QUERY = 128;
 static const size_t POOL_SIZE = MAX_K * MAX_NUM_CHARS_PER_QUERY;
+
+/* typo-tolerant search of the last query term */
+static const uint32_t MAX_FUZZY_EDITS = 2;
+static const uint32_t MIN_CHARS_FOR_ONE_EDIT = 3;
+static const uint32_t MIN_CHARS_FOR_TWO_EDITS = 6;
+static const uint32_t FUZZY_EXACT_PREFIX_LENGTH = 1;  // typos are rare here
+static const uint32_t MAX_FUZZY_EXPANSIONS = 8192;  // strings accessed
+static const uint32_t MAX_FUZZY_RANGES = 64;
 static_assert(MAX_NUM_TERMS_PER_QUERY < 256,
               "MAX_NUM_TERMS_PER_QUERY must be < 256");
 }  // namespace constants
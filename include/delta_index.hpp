@@ -0,0 +1,535 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include "util_types.hpp"
+#include "min_heap.hpp"
+#include "autocomplete_common.hpp"
+#include "scored_string_pool.hpp"
+#include "constants.hpp"
+#include "tombstones.hpp"
+
+namespace autocomplete {
+
+/*
+Dynamic, in-memory, index for the completions inserted after the static
+index has been built. Completions are tokenised as the queries are and
+kept as strings, so that they can also contain terms that are not in the
+dictionary of the static index. Periodically, fold() the delta into the
+collection the static index is re-built from.
+Completions can be inserted by any number of threads while another thread
+queries the delta: an insertion takes the lock of the delta exclusively,
+while the queries, string() and overrides() take it shared. As for the
+static indexes, the queries use scratch memory of the delta, so they must
+not be run concurrently with each other, nor with clear().
+*/
+struct delta_index {
+    typedef std::pair<id_type, id_type> posting_type;  // (doc_id, entry_id)
+    typedef std::set<posting_type> posting_list_type;
+    typedef std::map<std::string, id_type, std::less<>> string_map_type;
+
+    delta_index() {
+        m_topk.reserve(constants::MAX_K);
+        m_prefix.reserve(constants::MAX_NUM_TERMS_PER_QUERY);
+    }
+
+    /* Insert a new completion with the given score (doc_id) or update the
+       score of a completion inserted before. Return false if the
+       completion is too long to be indexed. */
+    bool insert(const id_type doc_id, std::string const& completion) {
+        std::string s;
+        uint32_t num_terms = 0;
+        normaliser::buffer buffer;  // the one of the normaliser is the queries'
+        byte_range_iterator it(m_normaliser(completion, buffer));
+        while (it.has_next()) {
+            byte_range t = it.next();
+            if (t.begin == t.end) break;  // trailing spaces
+            if (num_terms != 0) s.push_back(' ');
+            s.append(t.begin, t.end);
+            ++num_terms;
+        }
+        if (num_terms == 0 or
+            num_terms > constants::MAX_NUM_TERMS_PER_QUERY or
+            s.size() > constants::MAX_NUM_CHARS_PER_QUERY) {
+            return false;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        auto found = m_completions.find(s);
+        if (found != m_completions.end()) {
+            id_type entry_id = found->second;
+            auto& e = m_entries[entry_id];
+            for (auto term_id : e.terms) {
+                m_postings[term_id].erase({e.doc_id, entry_id});
+                m_postings[term_id].insert({doc_id, entry_id});
+            }
+            e.doc_id = doc_id;
+            return true;
+        }
+
+        id_type entry_id = m_entries.size();
+        entry e;
+        e.doc_id = doc_id;
+        auto inserted = m_completions.emplace(std::move(s), entry_id).first;
+        e.string = inserted->first;
+        it = byte_range_iterator(string_to_byte_range(inserted->first));
+        while (it.has_next()) {
+            id_type term_id = add_term(it.next());
+            e.terms.push_back(term_id);
+            m_postings[term_id].insert({doc_id, entry_id});
+        }
+        m_entries.push_back(std::move(e));
+        return true;
+    }
+
+    /* Same semantics of the static indexes: the query terms, but the last,
+       must be the first terms of the completion and the next term must be
+       prefixed by the last query token. */
+    uint32_t prefix_topk(std::string const& query, const uint32_t k) {
+        assert(k <= constants::MAX_K);
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        m_topk.clear();
+        // NOTE: consider() and the merge assume room for a result
+        if (k == 0 or m_entries.empty()) return 0;
+
+        m_key.clear();
+        byte_range_iterator it(m_normaliser(query));
+        while (true) {
+            byte_range t = it.next();
+            m_key.append(t.begin, t.end);
+            if (!it.has_next()) break;
+            m_key.push_back(' ');
+        }
+
+        auto deleted = m_tombstones.load();
+        for (auto i = m_completions.lower_bound(m_key);
+             i != m_completions.end() and starts_with(i->first, m_key); ++i) {
+            id_type doc_id = m_entries[i->second].doc_id;
+            if (!deleted->contains(doc_id)) consider({doc_id, i->second}, k);
+        }
+        std::sort_heap(m_topk.begin(), m_topk.end());
+        return m_topk.size();
+    }
+
+    /* Same semantics of the static indexes: all the query terms, but the
+       last, must appear in the completion and one of its terms must be
+       prefixed by the last query token. As in parse(), prefix terms that
+       are not indexed are ignored. */
+    uint32_t conjunctive_topk(std::string const& query, const uint32_t k) {
+        assert(k <= constants::MAX_K);
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        m_topk.clear();
+        // NOTE: consider() and the merge assume room for a result
+        if (k == 0 or m_entries.empty()) return 0;
+
+        completion_type& prefix = m_prefix;
+        prefix.clear();
+        byte_range suffix;
+        constexpr bool must_find_prefix = false;
+        parse(terms_dictionary{m_terms}, m_normaliser(query), prefix, suffix,
+              must_find_prefix);
+        std::string_view s(reinterpret_cast<char const*>(suffix.begin),
+                           suffix.end - suffix.begin);
+        auto deleted = m_tombstones.load();
+
+        if (prefix.size() == 0) {
+            auto& q = m_q;
+            q.clear();
+            for (auto i = m_terms.lower_bound(s);
+                 i != m_terms.end() and starts_with(i->first, s); ++i) {
+                auto const& list = m_postings[i->second];
+                if (!list.empty()) q.push_back({list.begin(), list.end()});
+            }
+            q.make_heap();
+            while (!q.empty()) {
+                auto& z = q.top();
+                auto posting = *z.begin;
+                if (!deleted->contains(posting.first) and
+                    (m_topk.empty() or m_topk.back() != posting)) {
+                    m_topk.push_back(posting);
+                    if (m_topk.size() == k) break;
+                }
+                ++z.begin;
+                if (z.begin == z.end) q.pop();
+                q.heapify();
+            }
+            return m_topk.size();
+        }
+
+        deduplicate(prefix);
+        id_type shortest = prefix.front();
+        for (auto term_id : prefix) {
+            if (m_postings[term_id].size() < m_postings[shortest].size()) {
+                shortest = term_id;
+            }
+        }
+        for (auto posting : m_postings[shortest]) {
+            if (!deleted->contains(posting.first) and
+                contains(m_entries[posting.second], prefix, s)) {
+                m_topk.push_back(posting);
+                if (m_topk.size() == k) break;
+            }
+        }
+        return m_topk.size();
+    }
+
+    /* (doc_id, entry_id) pairs found by the last query, by increasing
+       doc_id */
+    std::vector<posting_type> const& topk() const {
+        return m_topk;
+    }
+
+    /* the string is never moved by later insertions, but by clear() */
+    std::string_view string(const id_type entry_id) const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        assert(entry_id < m_entries.size());
+        return m_entries[entry_id].string;
+    }
+
+    /* whether the completion, as reported by the static index, was
+       inserted into the delta, whose score then replaces the static one */
+    bool overrides(byte_range completion) const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_completions.find(to_string_view(completion)) !=
+               m_completions.end();
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    size_t num_terms() const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_terms.size();
+    }
+
+    /* must be configured as the normaliser of the static index */
+    void set_normaliser(normaliser const& n) {
+        m_normaliser = n;
+    }
+
+    void set_tombstones(std::shared_ptr<const tombstone_set> deleted) {
+        m_tombstones.store(std::move(deleted));
+    }
+
+    void clear() {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_entries.clear();
+        m_completions.clear();
+        m_terms.clear();
+        m_term_strings.clear();
+        m_postings.clear();
+        m_topk.clear();
+    }
+
+    /* Read (and write) completions in the same format of the collection:
+       one "doc_id term_1 term_2 ... term_n" per line. */
+    void load(std::istream& input) {
+        std::string line;
+        while (std::getline(input, line)) {
+            size_t pos = line.find(' ');
+            if (pos == std::string::npos) continue;
+            insert(std::stoul(line.substr(0, pos)), line.substr(pos + 1));
+        }
+    }
+
+    void save(std::ostream& output) const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        for (auto const& c : m_completions) {
+            output << m_entries[c.second].doc_id << ' ' << c.first << '\n';
+        }
+    }
+
+    /* Merge the delta into the (lexicographically sorted) collection,
+       writing a collection that the static index can be re-built from.
+       A completion that is both in the collection and in the delta takes
+       the score of the delta. Since the pipeline assumes distinct doc_ids,
+       doc_ids are re-assigned to 0,1,2,... by increasing score, with ties
+       broken in lexicographic order. */
+    void fold(std::istream& collection, std::ostream& output) const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        std::vector<std::pair<id_type, std::string>> merged;
+        merged.reserve(m_completions.size());
+        auto i = m_completions.begin();
+        std::string line;
+        while (std::getline(collection, line)) {
+            size_t pos = line.find(' ');
+            if (pos == std::string::npos) continue;
+            std::string s = line.substr(pos + 1);
+            for (; i != m_completions.end() and i->first < s; ++i) {
+                merged.emplace_back(m_entries[i->second].doc_id, i->first);
+            }
+            if (i != m_completions.end() and i->first == s) {
+                merged.emplace_back(m_entries[i->second].doc_id, i->first);
+                ++i;
+                continue;
+            }
+            merged.emplace_back(std::stoul(line.substr(0, pos)), std::move(s));
+        }
+        for (; i != m_completions.end(); ++i) {
+            merged.emplace_back(m_entries[i->second].doc_id, i->first);
+        }
+
+        std::vector<id_type> by_score(merged.size());
+        std::iota(by_score.begin(), by_score.end(), 0);
+        std::stable_sort(by_score.begin(), by_score.end(),
+                         [&](id_type l, id_type r) {
+                             return merged[l].first < merged[r].first;
+                         });
+        for (id_type doc_id = 0; doc_id != by_score.size(); ++doc_id) {
+            merged[by_score[doc_id]].first = doc_id;
+        }
+        for (auto const& c : merged) {
+            output << c.first << ' ' << c.second << '\n';
+        }
+    }
+
+private:
+    struct entry {
+        id_type doc_id;
+        std::string_view string;
+        completion_type terms;
+    };
+
+    typedef posting_list_type::const_iterator posting_iterator_type;
+
+    struct cursor {
+        posting_iterator_type begin;
+        posting_iterator_type end;
+    };
+
+    struct cursor_comparator {
+        bool operator()(cursor const& l, cursor const& r) {
+            return *l.begin > *r.begin;
+        }
+    };
+
+    typedef min_heap<cursor, cursor_comparator> min_priority_queue_type;
+
+    /* the terms of the delta, as a dictionary for parse() */
+    struct terms_dictionary {
+        string_map_type const& terms;
+
+        id_type locate(byte_range t) const {
+            auto it = terms.find(to_string_view(t));
+            if (it == terms.end()) return global::invalid_term_id;
+            return it->second;
+        }
+    };
+
+    mutable std::shared_mutex m_mutex;
+    std::vector<entry> m_entries;
+    string_map_type m_completions;  // completion -> entry_id
+    string_map_type m_terms;        // term -> term_id
+    std::vector<std::string_view> m_term_strings;
+    std::vector<posting_list_type> m_postings;
+
+    std::string m_key;
+    std::vector<posting_type> m_topk;
+    normaliser m_normaliser;
+    completion_type m_prefix;
+    min_priority_queue_type m_q;
+    tombstones m_tombstones;
+
+    static std::string_view to_string_view(byte_range t) {
+        return std::string_view(reinterpret_cast<char const*>(t.begin),
+                                t.end - t.begin);
+    }
+
+    static bool starts_with(std::string_view s, std::string_view p) {
+        return s.size() >= p.size() and s.compare(0, p.size(), p) == 0;
+    }
+
+    id_type add_term(byte_range t) {
+        auto it = m_terms.find(to_string_view(t));
+        if (it != m_terms.end()) return it->second;
+        id_type term_id = m_term_strings.size();
+        it = m_terms.emplace(std::string(t.begin, t.end), term_id).first;
+        m_term_strings.push_back(it->first);
+        m_postings.emplace_back();
+        return term_id;
+    }
+
+    /* keep the k smallest postings in a max-heap */
+    void consider(posting_type posting, const uint32_t k) {
+        if (m_topk.size() < k) {
+            m_topk.push_back(posting);
+            std::push_heap(m_topk.begin(), m_topk.end());
+        } else if (posting < m_topk.front()) {
+            std::pop_heap(m_topk.begin(), m_topk.end());
+            m_topk.back() = posting;
+            std::push_heap(m_topk.begin(), m_topk.end());
+        }
+    }
+
+    bool contains(entry const& e, completion_type const& prefix,
+                  std::string_view suffix) const {
+        for (auto term_id : prefix) {
+            if (std::find(e.terms.begin(), e.terms.end(), term_id) ==
+                e.terms.end()) {
+                return false;
+            }
+        }
+        for (auto term_id : e.terms) {
+            if (starts_with(m_term_strings[term_id], suffix)) return true;
+        }
+        return false;
+    }
+};
+
+/*
+A static index plus a delta_index: the results of the two are merged
+by score at query time. A completion inserted into the delta overrides
+its copy in the static index, if any.
+*/
+template <typename Index>
+struct delta_autocomplete {
+    typedef scored_string_pool::iterator iterator_type;
+
+    delta_autocomplete() {
+        m_pool.resize(constants::POOL_SIZE, constants::MAX_K);
+    }
+
+    bool insert(const id_type doc_id, std::string const& completion) {
+        return m_delta.insert(doc_id, completion);
+    }
+
+    template <typename Probe>
+    iterator_type prefix_topk(std::string const& query, const uint32_t k,
+                              Probe& probe) {
+        probe.start(1);
+        m_delta.prefix_topk(query, k);
+        probe.stop(1);
+        return merge(
+            [&](uint32_t static_k) {
+                return m_index.prefix_topk(query, static_k, probe);
+            },
+            k, probe);
+    }
+
+    template <typename Probe>
+    iterator_type conjunctive_topk(std::string const& query, const uint32_t k,
+                                   Probe& probe) {
+        probe.start(1);
+        m_delta.conjunctive_topk(query, k);
+        probe.stop(1);
+        return merge(
+            [&](uint32_t static_k) {
+                return m_index.conjunctive_topk(query, static_k, probe);
+            },
+            k, probe);
+    }
+
+    void set_normaliser(normaliser const& n) {
+        m_index.set_normaliser(n);
+        m_delta.set_normaliser(n);
+    }
+
+    /* the completions inserted into the delta are blocked as well */
+    void set_tombstones(std::shared_ptr<const tombstone_set> deleted) {
+        m_index.set_tombstones(deleted);
+        m_delta.set_tombstones(std::move(deleted));
+    }
+
+    /* the delta is small: only the static index has a budget */
+    void set_search_budget(search_budget const& budget) {
+        m_index.set_search_budget(budget);
+    }
+
+    bool partial() const {
+        return m_index.partial();
+    }
+
+    Index& static_index() {
+        return m_index;
+    }
+
+    delta_index& delta() {
+        return m_delta;
+    }
+
+    size_t bytes() const {
+        return m_index.bytes();
+    }
+
+    void print_stats() const {
+        m_index.print_stats();
+        std::cout << "delta completions: " << m_delta.size() << std::endl;
+        std::cout << "delta terms: " << m_delta.num_terms() << std::endl;
+    }
+
+    /* only the static index is serialized */
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_index);
+    }
+
+private:
+    Index m_index;
+    delta_index m_delta;
+    scored_string_pool m_pool;
+
+    /* The static results overridden by the delta are dropped, so the
+       static index is queried again, for more results, if less than k
+       are left while it may have more. */
+    template <typename StaticTopk, typename Probe>
+    iterator_type merge(StaticTopk static_topk, const uint32_t k,
+                        Probe& probe) {
+        uint32_t static_k = k;
+        while (true) {
+            auto it = static_topk(static_k);
+            probe.start(2);
+            uint32_t dropped = merge(it, k);
+            probe.stop(2);
+            if (m_pool.size() == k or it.size() < static_k or
+                static_k == constants::MAX_K) {
+                break;
+            }
+            static_k = std::min<uint32_t>(static_k + dropped, constants::MAX_K);
+        }
+        return m_pool.begin();
+    }
+
+    /* return the number of static results dropped */
+    uint32_t merge(iterator_type it, const uint32_t k) {
+        m_pool.clear();
+        m_pool.init();
+
+        auto const& pool = *it.pool();
+        auto const& delta = m_delta.topk();
+        auto& topk_scores = m_pool.scores();
+        uint32_t i = 0, j = 0, results = 0, dropped = 0;
+        while (results != k and (i != pool.size() or j != delta.size())) {
+            scored_byte_range sbr;
+            if (j == delta.size() or
+                (i != pool.size() and pool[i].score <= delta[j].first)) {
+                sbr = pool[i++];
+                if (m_delta.overrides(sbr.string)) {
+                    ++dropped;
+                    continue;
+                }
+            } else {
+                auto s = m_delta.string(delta[j].second);
+                auto begin = reinterpret_cast<uint8_t const*>(s.data());
+                sbr.string = {begin, begin + s.size()};
+                sbr.score = delta[j++].first;
+            }
+            uint64_t offset = m_pool.bytes();
+            uint64_t len = sbr.string.end - sbr.string.begin;
+            memcpy(m_pool.data() + offset, sbr.string.begin, len);
+            m_pool.push_back_offset(offset + len);
+            topk_scores[results++] = sbr.score;
+        }
+
+        return dropped;
+    }
+};
+
+}  // namespace autocomplete
@@ -91,6 +91,13 @@ struct darray {
         }
     }
 
+    /* the inventory entries read by select(idx) */
+    inline void prefetch(uint64_t idx) const {
+        assert(idx < num_positions());
+        util::prefetch(m_block_inventory.data() + idx / block_size);
+        util::prefetch(m_subblock_inventory.data() + idx / subblock_size);
+    }
+
     inline uint64_t num_positions() const {
         return m_positions;
     }
@@ -137,6 +137,13 @@ struct ef_sequence {
                m_low_bits.get_bits(i * m_l, m_l);
     }
 
+    /* issue the loads of access(i) that do not depend on each other */
+    inline void prefetch(uint64_t i) const {
+        if (i >= size()) return;
+        m_high_bits_d1.prefetch(i);
+        if (m_l) util::prefetch(m_low_bits.data().data() + i * m_l / 64);
+    }
+
     inline uint64_t num_ones() const {
         return m_high_bits_d1.num_positions();
     }
@@ -118,7 +118,15 @@ struct fc_dictionary {
     // 0-based ids
     range locate_prefix(byte_range p) const {
         if (p.end - p.begin == 0) return {0, size() - 1};
-        auto bucket_id = locate_buckets(p);
+        return locate_prefix(p, locate_buckets(p));
+    }
+
+    /* The strings prefixed by p within the buckets [bucket_id.begin,
+       bucket_id.end], whose headers delimit them, as found by a binary
+       search on the headers: for the callers interleaving many searches
+       (see interleaved_locate.hpp), that prefetch each header to compare
+       with prefetch_header, and the buckets to scan with prefetch_bucket. */
+    range locate_prefix(byte_range p, range bucket_id) const {
         byte_range h_begin = header(bucket_id.begin);
         byte_range h_end = header(bucket_id.end);
         uint32_t p_begin = bucket_id.begin * (BucketSize + 1);
@@ -156,6 +164,93 @@ struct fc_dictionary {
         return extract(k, bucket_id, out);
     }
 
+    /* sequential access to the strings, starting from a 0-based id */
+    struct iterator {
+        iterator(fc_dictionary const& dict, uint64_t id)
+            : m_dict(dict)
+            , m_bucket_id(id / (BucketSize + 1))
+            , m_i(0) {
+            assert(id < dict.size());
+            byte_range h = dict.header(m_bucket_id);
+            m_len = h.end - h.begin;
+            memcpy(m_string, h.begin, m_len);
+            m_curr = dict.m_buckets.data() +
+                     dict.m_pointers_to_buckets.access(m_bucket_id);
+            for (uint64_t k = id % (BucketSize + 1); k != 0; --k) next();
+            m_lcp = 0;
+        }
+
+        byte_range operator*() const {
+            return {m_string, m_string + m_len};
+        }
+
+        /* length of the longest common prefix with the previous string */
+        uint32_t lcp() const {
+            return m_lcp;
+        }
+
+        /* number of strings following the current one in its bucket */
+        uint32_t remaining() const {
+            return m_dict.bucket_size(m_bucket_id) - m_i;
+        }
+
+        /* the header of the next bucket, or an empty range if none */
+        byte_range next_header() const {
+            if (m_bucket_id + 1 == m_dict.buckets()) {
+                return {m_string, m_string};
+            }
+            return m_dict.header(m_bucket_id + 1);
+        }
+
+        /* move to the header of the next bucket without decoding */
+        void skip_bucket() {
+            m_i = m_dict.bucket_size(m_bucket_id);
+            operator++();
+        }
+
+        // NOTE: must not be called on the last string of the dictionary
+        void operator++() {
+            if (m_i != m_dict.bucket_size(m_bucket_id)) {
+                next();
+                return;
+            }
+            m_bucket_id += 1;
+            m_i = 0;
+            byte_range h = m_dict.header(m_bucket_id);
+            uint32_t len = h.end - h.begin;
+            m_lcp = 0;
+            while (m_lcp != len and m_lcp != m_len and
+                   m_string[m_lcp] == h.begin[m_lcp]) {
+                ++m_lcp;
+            }
+            m_len = len;
+            memcpy(m_string, h.begin, m_len);
+            m_curr = m_dict.m_buckets.data() +
+                     m_dict.m_pointers_to_buckets.access(m_bucket_id);
+        }
+
+    private:
+        fc_dictionary const& m_dict;
+        uint32_t m_bucket_id;
+        uint32_t m_i;  // strings decoded in the current bucket
+        uint32_t m_len;
+        uint32_t m_lcp;
+        uint8_t const* m_curr;
+        uint8_t m_string[2 * constants::MAX_NUM_CHARS_PER_QUERY];
+
+        void next() {
+            uint8_t lcp_len;
+            m_len = m_dict.decode(m_curr, m_string, &lcp_len);
+            m_curr += m_len - lcp_len + 2;
+            m_lcp = lcp_len;
+            m_i += 1;
+        }
+    };
+
+    iterator at(uint64_t id) const {
+        return iterator(*this, id);
+    }
+
     size_t size() const {
         return m_size;
     }
@@ -178,6 +273,16 @@ struct fc_dictionary {
                 m_headers.data() + pointer.end};
     }
 
+    inline void prefetch_header(uint32_t i) const {
+        assert(i < buckets());
+        util::prefetch(m_headers.data() + m_pointers_to_headers.access(i));
+    }
+
+    inline void prefetch_bucket(uint32_t i) const {
+        assert(i < buckets());
+        util::prefetch(m_buckets.data() + m_pointers_to_buckets.access(i));
+    }
+
     size_t data_bytes() const {
         return essentials::vec_bytes(m_headers) +
                essentials::vec_bytes(m_buckets);
@@ -300,7 +405,7 @@ private:
     }
 
 #define FC_DICT_LOCATE_INIT                                         \
-    static uint8_t decoded[2 * constants::MAX_NUM_CHARS_PER_QUERY]; \
+    uint8_t decoded[2 * constants::MAX_NUM_CHARS_PER_QUERY];        \
     memcpy(decoded, h.begin, h.end - h.begin);                      \
     uint8_t lcp_len;                                                \
     uint32_t n = bucket_size(bucket_id);                            \
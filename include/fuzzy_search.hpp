@@ -0,0 +1,240 @@
+#pragma once
+
+#include "util_types.hpp"
+#include "constants.hpp"
+
+namespace autocomplete {
+
+/*
+Number of typos tolerated in a query term of the given length:
+short terms must be typed exactly, otherwise every term would match.
+*/
+uint32_t fuzzy_edits(const uint32_t length, const uint32_t max_edits) {
+    uint32_t edits = 0;
+    if (length >= constants::MIN_CHARS_FOR_ONE_EDIT) edits = 1;
+    if (length >= constants::MIN_CHARS_FOR_TWO_EDITS) edits = 2;
+    return std::min(edits, max_edits);
+}
+
+/*
+Typo-tolerant prefix search over a sorted dictionary of terms.
+Locate all the terms having a prefix whose edit distance from p is at most
+max_edits, where an edit is the insertion, deletion or substitution of a
+byte, or the transposition of two adjacent bytes.
+The result is a sorted list of disjoint lexicographic ranges, with the same
+convention as Dictionary::locate_prefix, i.e., 0-based inclusive ranges.
+
+The dictionary is traversed as if it were a trie: the children of the node
+for the string w are found by extracting the first term of the range of w
+and locating the prefix w + c, where c is the byte following w in that term.
+We keep a row of the edit distance matrix for each level of the trie,
+and descend into a node only if its row can still lead to a match.
+As typos in the very first bytes of a term are rare, the first
+constants::FUZZY_EXACT_PREFIX_LENGTH bytes must match exactly: this
+shrinks the search space by orders of magnitude.
+A node whose row reports a match is output as a whole, without descending
+into it. Small ranges are scanned sequentially instead.
+
+To bound the latency, the number of dictionary accesses is capped by
+constants::MAX_FUZZY_EXPANSIONS and the number of ranges by
+constants::MAX_FUZZY_RANGES: when a budget runs out, the search stops and
+only the lexicographically smallest matches are reported.
+*/
+template <typename Dictionary>
+struct fuzzy_prefix_search {
+    /* scanning is much faster than locating a prefix, per string:
+       locate the children of a node only if its range is larger */
+    static const uint32_t SCAN_THRESHOLD = 4096;
+
+    fuzzy_prefix_search(Dictionary const& dict,
+                        const uint32_t scan_threshold = SCAN_THRESHOLD)
+        : m_dict(dict)
+        , m_scan_threshold(scan_threshold) {}
+
+    // return false if a budget ran out before the search was completed
+    bool search(byte_range p, const uint32_t max_edits, range_list& ranges) {
+        assert(max_edits <= constants::MAX_FUZZY_EDITS);
+        ranges.clear();
+        m_ranges = &ranges;
+        m_query_len = p.end - p.begin;
+        m_max_edits = fuzzy_edits(m_query_len, max_edits);
+
+        if (m_max_edits == 0 or
+            m_query_len > constants::MAX_NUM_CHARS_PER_QUERY) {
+            range r = m_dict.locate_prefix(p);
+            if (r.is_valid()) ranges.push_back(r);
+            return true;
+        }
+
+        memcpy(m_query, p.begin, m_query_len);
+        for (uint32_t j = 0; j <= m_query_len; ++j) m_rows[0][j] = j;
+        m_budget = constants::MAX_FUZZY_EXPANSIONS;
+
+        /* the first bytes must match exactly */
+        constexpr uint32_t depth = constants::FUZZY_EXACT_PREFIX_LENGTH;
+        static_assert(depth < constants::MIN_CHARS_FOR_ONE_EDIT,
+                      "the exact prefix must be shorter than a fuzzy term");
+        for (uint32_t i = 1; i <= depth; ++i) {
+            m_term[i - 1] = m_query[i - 1];
+            compute_row(i);
+        }
+        assert(!matches(depth));
+        range r = m_dict.locate_prefix({p.begin, p.begin + depth});
+        if (r.is_invalid()) return true;
+        return visit(depth, r);
+    }
+
+private:
+    Dictionary const& m_dict;
+    uint32_t m_scan_threshold;
+    range_list* m_ranges;
+    uint32_t m_query_len;
+    uint32_t m_max_edits;
+    uint32_t m_budget;
+    uint8_t m_query[constants::MAX_NUM_CHARS_PER_QUERY];
+    // NOTE: the dictionary copies a fixed amount of bytes when extracting
+    uint8_t m_term[2 * constants::MAX_NUM_CHARS_PER_QUERY];
+    // NOTE: a row at depth > m_query_len + m_max_edits never matches
+    uint8_t m_rows[constants::MAX_NUM_CHARS_PER_QUERY +
+                   constants::MAX_FUZZY_EDITS + 2]
+                  [constants::MAX_NUM_CHARS_PER_QUERY + 1];
+
+    bool matches(const uint32_t depth) const {
+        return depth + m_max_edits >= m_query_len and
+               m_query_len + m_max_edits >= depth and
+               m_rows[depth][m_query_len] <= m_max_edits;
+    }
+
+    bool spend() {
+        if (m_budget == 0) return false;
+        --m_budget;
+        return true;
+    }
+
+    bool output(const range r) {
+        auto& ranges = *m_ranges;
+        if (!ranges.empty() and ranges.back().end + 1 == r.begin) {
+            ranges.back().end = r.end;
+            return true;
+        }
+        if (ranges.size() == constants::MAX_FUZZY_RANGES) return false;
+        ranges.push_back(r);
+        return true;
+    }
+
+    /* compute the row for m_term[0..depth) and return its minimum:
+       only the cells at distance at most m_max_edits from the diagonal
+       can hold a value <= m_max_edits, so the others are not computed */
+    uint32_t compute_row(const uint32_t depth) {
+        assert(depth > 0);
+        uint8_t const* prev = m_rows[depth - 1];
+        uint8_t* curr = m_rows[depth];
+        uint8_t c = m_term[depth - 1];
+        const uint32_t out = m_max_edits + 1;
+        uint32_t lo = depth > m_max_edits ? depth - m_max_edits : 1;
+        uint32_t hi = std::min(depth + m_max_edits, m_query_len);
+        curr[lo - 1] = lo == 1 ? depth : out;
+        if (hi < m_query_len) curr[hi + 1] = out;
+        uint32_t min = curr[lo - 1];
+        for (uint32_t j = lo; j <= hi; ++j) {
+            uint32_t d = prev[j - 1] + (c != m_query[j - 1]);
+            d = std::min<uint32_t>(d, prev[j] + 1);
+            d = std::min<uint32_t>(d, curr[j - 1] + 1);
+            if (depth > 1 and j > 1 and c == m_query[j - 2] and
+                m_term[depth - 2] == m_query[j - 1]) {  // transposition
+                d = std::min<uint32_t>(d, m_rows[depth - 2][j - 2] + 1);
+            }
+            curr[j] = d;
+            if (d < min) min = d;
+        }
+        return min;
+    }
+
+    // NOTE: the row for the node at the given depth is already computed,
+    // it does not match and can still lead to a match
+    bool visit(const uint32_t depth, const range r) {
+        if (r.end - r.begin + 1 <= m_scan_threshold) return scan(depth, r);
+
+        for (uint64_t id = r.begin; id <= r.end;) {
+            if (!spend()) return false;
+            uint32_t len = m_dict.extract(id + 1, m_term);
+            if (len == depth) {  // the node itself, not a match
+                ++id;
+                continue;
+            }
+            uint32_t min = compute_row(depth + 1);
+            if (!spend()) return false;
+            range child = m_dict.locate_prefix({m_term, m_term + depth + 1});
+            assert(child.begin == id and child.end <= r.end);
+            if (matches(depth + 1)) {
+                if (!output(child)) return false;
+            } else if (min <= m_max_edits) {
+                if (!visit(depth + 1, child)) return false;
+            }
+            id = child.end + 1;
+        }
+
+        return true;
+    }
+
+    bool shares_prefix(byte_range s, const uint32_t len) const {
+        return uint32_t(s.end - s.begin) >= len and
+               memcmp(s.begin, m_term, len) == 0;
+    }
+
+    /* scan the strings sequentially: the rows are shared by consecutive
+       strings up to their longest common prefix, and the strings sharing
+       a prefix that matches, or cannot match, are not examined at all */
+    bool scan(const uint32_t depth, const range r) {
+        auto it = m_dict.at(r.begin);
+        uint32_t computed = depth;  // deepest valid row
+        uint32_t decided = 0;       // depth at which the outcome was decided
+        bool matched = false;
+        for (uint64_t id = r.begin;; ++it) {
+            if (!spend()) return false;
+            byte_range s = *it;
+            uint32_t lcp = id == r.begin ? depth : it.lcp();
+            if (decided and lcp >= decided) {
+                /* skip the buckets whose strings all share the prefix */
+                uint64_t last = id + it.remaining();
+                while (last < r.end and
+                       shares_prefix(it.next_header(), decided)) {
+                    if (!spend()) return false;
+                    if (matched and !output({id, last})) return false;
+                    it.skip_bucket();
+                    id = last + 1;
+                    last = id + it.remaining();
+                }
+                if (matched and !output({id, id})) return false;
+            } else {
+                uint32_t len = s.end - s.begin;
+                memcpy(m_term, s.begin, len);
+                decided = 0;
+                matched = false;
+                uint32_t i = std::min(lcp, computed) + 1;
+                for (; i <= len; ++i) {
+                    uint32_t min = compute_row(i);
+                    if (matches(i) or min > m_max_edits) {
+                        matched = matches(i);
+                        decided = i;
+                        break;
+                    }
+                }
+                computed = std::min(i, len);
+                if (matched and !output({id, id})) return false;
+            }
+            if (id == r.end) break;
+            ++id;
+        }
+        return true;
+    }
+};
+
+template <typename Dictionary>
+bool fuzzy_locate_prefix(Dictionary const& dict, byte_range p,
+                         const uint32_t max_edits, range_list& ranges) {
+    fuzzy_prefix_search<Dictionary> search(dict);
+    return search.search(p, max_edits, ranges);
+}
+
+}  // namespace autocomplete
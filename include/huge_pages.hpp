@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <type_traits>
+#include <sys/mman.h>
+
+namespace autocomplete {
+
+/*
+Back the large arrays of a loaded index with 2 MiB transparent huge pages,
+so that the random accesses of the queries miss the dTLB less often.
+Each array of at least HUGE_PAGE_SIZE bytes is advised with MADV_HUGEPAGE
+and, where the kernel supports it (Linux 6.1), collapsed into huge pages
+at once with MADV_COLLAPSE; otherwise khugepaged collapses it over time.
+The arrays are not moved: only their 2 MiB-aligned part is covered, that
+is all but at most 4 MiB of each array.
+Transparent huge pages must be enabled, in "always" or "madvise" mode,
+in /sys/kernel/mm/transparent_hugepage/enabled.
+*/
+struct huge_pages_advisor {
+    static const uint64_t HUGE_PAGE_SIZE = uint64_t(1) << 21;
+
+    huge_pages_advisor()
+        : m_advised_bytes(0)
+        , m_collapsed_bytes(0) {}
+
+    template <typename T>
+    void visit(T& val) {
+        if constexpr (!std::is_pod<T>::value) val.visit(*this);
+    }
+
+    template <typename T, typename Allocator>
+    void visit(std::vector<T, Allocator>& vec) {
+        if constexpr (std::is_pod<T>::value) {
+            advise(reinterpret_cast<uint8_t*>(vec.data()),
+                   vec.size() * sizeof(T));
+        } else {
+            for (auto& v : vec) visit(v);
+        }
+    }
+
+    /* bytes on which MADV_HUGEPAGE succeeded */
+    uint64_t advised_bytes() const {
+        return m_advised_bytes;
+    }
+
+    /* bytes already backed by huge pages */
+    uint64_t collapsed_bytes() const {
+        return m_collapsed_bytes;
+    }
+
+private:
+    uint64_t m_advised_bytes;
+    uint64_t m_collapsed_bytes;
+
+    void advise(uint8_t* data, uint64_t bytes) {
+        uint64_t begin = reinterpret_cast<uint64_t>(data);
+        uint64_t end = begin + bytes;
+        begin = (begin + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        end &= ~(HUGE_PAGE_SIZE - 1);
+        if (begin >= end) return;
+        void* addr = reinterpret_cast<void*>(begin);
+        if (madvise(addr, end - begin, MADV_HUGEPAGE) != 0) return;
+        m_advised_bytes += end - begin;
+#ifdef MADV_COLLAPSE
+        if (madvise(addr, end - begin, MADV_COLLAPSE) == 0) {
+            m_collapsed_bytes += end - begin;
+        }
+#endif
+    }
+};
+
+template <typename Index>
+huge_pages_advisor use_huge_pages(Index& index) {
+    huge_pages_advisor advisor;
+    index.visit(advisor);
+    return advisor;
+}
+
+}  // namespace autocomplete
@@ -302,24 +302,35 @@ private:
         }
     }
 
-#define INT_FC_DICT_LOCATE_INIT                                      \
-    static uint32_t decoded[2 * constants::MAX_NUM_TERMS_PER_QUERY]; \
-    memcpy(decoded, h.begin, (h.end - h.begin) * sizeof(uint32_t));  \
-    uint8_t lcp_len;                                                 \
-    uint32_t n = bucket_size(bucket_id);                             \
-    uint8_t const* curr =                                            \
-        m_buckets.data() + m_pointers_to_buckets.access(bucket_id);
-
     // return the length of the decoded string
     uint8_t decode(uint8_t const* in, uint32_t* out, uint8_t* lcp_len) const {
         *lcp_len = *in++;  // |lcp|
         uint8_t l = *lcp_len;
         uint8_t suffix_len = *in++;
-        memcpy(out + l, reinterpret_cast<uint32_t const*>(in),
-               constants::MAX_NUM_TERMS_PER_QUERY * sizeof(uint32_t));
+        copy_terms(in, suffix_len, out + l);
         return l + suffix_len;
     }
 
+    // Copy the n terms with fixed-size moves: the buckets are padded with
+    // MAX_NUM_TERMS_PER_QUERY terms, as many as the output can take after
+    // the lcp. With AVX2, copy blocks of 8 terms, the first one always.
+    static inline void copy_terms(uint8_t const* in, uint32_t n,
+                                  uint32_t* out) {
+#ifdef __AVX2__
+        uint32_t i = 0;
+        do {
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i*>(out + i),
+                _mm256_loadu_si256(reinterpret_cast<__m256i const*>(
+                    in + i * sizeof(uint32_t))));
+            i += 8;
+        } while (i < n);
+#else
+        (void)n;
+        memcpy(out, in, constants::MAX_NUM_TERMS_PER_QUERY * sizeof(uint32_t));
+#endif
+    }
+
     uint8_t extract(id_type id, id_type bucket_id, completion_type& c) const {
         auto h = header(bucket_id);
         memcpy(c.data(), h.begin, (h.end - h.begin) * sizeof(uint32_t));
@@ -335,14 +346,114 @@ private:
         return string_len;
     }
 
+    /*
+    Scans the strings of a bucket, comparing each with a query q without
+    decoding it. If the previous string has m terms in common with q and
+    the current one shares lcp terms with the previous:
+    - lcp < m: the current string is the first greater than q at lcp;
+    - lcp > m: it differs from q where the previous one did;
+    - lcp = m: only its suffix is compared with q[m..], directly in the
+    bucket, 8 terms at a time with AVX2 (the buckets are padded).
+    */
+    struct bucket_scanner {
+        bucket_scanner(uint8_t const* bucket, uint32_range h, uint32_range q)
+            : m_curr(bucket)
+            , m_q_size(q.end - q.begin) {
+            assert(m_q_size <= constants::MAX_NUM_TERMS_PER_QUERY + 2);
+            memcpy(m_q, q.begin, m_q_size * sizeof(uint32_t));
+            memset(m_q + m_q_size, 0, 8 * sizeof(uint32_t));
+            m_size = h.end - h.begin;
+            uint32_t n = std::min(m_size, m_q_size);
+            for (m_m = 0; m_m != n and h.begin[m_m] == m_q[m_m]; ++m_m)
+                ;
+            m_sign = m_m == n ? 0 : (h.begin[m_m] < m_q[m_m] ? -1 : 1);
+        }
+
+        void next() {
+            uint32_t lcp = m_curr[0];
+            uint32_t suffix_len = m_curr[1];
+            uint8_t const* suffix = m_curr + 2;
+            m_size = lcp + suffix_len;
+            m_curr = suffix + suffix_len * sizeof(uint32_t);
+            if (lcp < m_m) {
+                m_m = lcp;
+                m_sign = 1;
+            } else if (lcp == m_m) {
+                uint32_t n = std::min(m_size, m_q_size) - lcp;
+                uint32_t i = mismatch(suffix, m_q + lcp, n);
+                m_m = lcp + i;
+                if (i == n) {
+                    m_sign = 0;
+                } else {
+                    uint32_t x;
+                    memcpy(&x, suffix + i * sizeof(uint32_t), sizeof(x));
+                    m_sign = x < m_q[m_m] ? -1 : 1;
+                }
+            }
+        }
+
+        // as uint32_range_compare(q, s)
+        int compare_query() const {
+            if (m_sign) return -m_sign;
+            return int(m_q_size) - int(m_size);
+        }
+
+        // as uint32_range_compare(s, q, |q|)
+        int compare_prefix() const {
+            if (m_sign) return m_sign;
+            return m_m == m_q_size ? 0 : -1;
+        }
+
+    private:
+        uint8_t const* m_curr;
+        uint32_t m_q[constants::MAX_NUM_TERMS_PER_QUERY + 2 + 8];
+        uint32_t m_q_size;
+        uint32_t m_size;
+        uint32_t m_m;  // |lcp(s,q)|
+        int m_sign;    // sign of s[m] - q[m], or 0 if s or q ends at m
+
+        static inline uint32_t mismatch(uint8_t const* l, uint32_t const* r,
+                                        uint32_t n) {
+            uint32_t i = 0;
+#ifdef __AVX2__
+            for (; i < n; i += 8) {
+                __m256i x = _mm256_loadu_si256(
+                    reinterpret_cast<__m256i const*>(l + i * sizeof(uint32_t)));
+                __m256i y =
+                    _mm256_loadu_si256(reinterpret_cast<__m256i const*>(r + i));
+                uint32_t eq = _mm256_movemask_ps(
+                    _mm256_castsi256_ps(_mm256_cmpeq_epi32(x, y)));
+                if (eq != 0xFF) {
+                    i += __builtin_ctz(~eq);
+                    break;
+                }
+            }
+            return i < n ? i : n;
+#else
+            for (; i != n; ++i) {
+                uint32_t x;
+                memcpy(&x, l + i * sizeof(uint32_t), sizeof(x));
+                if (x != r[i]) break;
+            }
+            return i;
+#endif
+        }
+    };
+
+    bucket_scanner scanner(uint32_range q, uint32_range h,
+                           id_type bucket_id) const {
+        return {m_buckets.data() + m_pointers_to_buckets.access(bucket_id), h,
+                q};
+    }
+
     id_type locate(uint32_range t, uint32_range h, id_type bucket_id) const {
-        INT_FC_DICT_LOCATE_INIT
+        auto s = scanner(t, h, bucket_id);
+        uint32_t n = bucket_size(bucket_id);
         for (id_type i = 1; i <= n; ++i) {
-            uint8_t l = decode(curr, decoded, &lcp_len);
-            int cmp = uint32_range_compare(t, {decoded, decoded + l});
+            s.next();
+            int cmp = s.compare_query();
             if (cmp == 0) return i;
             if (cmp < 0) return global::invalid_term_id;
-            curr += (l - lcp_len) * sizeof(uint32_t) + 2;
         }
         assert(false);
         __builtin_unreachable();
@@ -350,26 +461,22 @@ private:
 
     id_type right_locate(uint32_range p, uint32_range h,
                          id_type bucket_id) const {
-        INT_FC_DICT_LOCATE_INIT
-        uint32_t len = p.end - p.begin;
+        auto s = scanner(p, h, bucket_id);
+        uint32_t n = bucket_size(bucket_id);
         for (id_type i = 1; i <= n; ++i) {
-            uint8_t l = decode(curr, decoded, &lcp_len);
-            int cmp = uint32_range_compare({decoded, decoded + l}, p, len);
-            if (cmp > 0) return i - 1;
-            curr += (l - lcp_len) * sizeof(uint32_t) + 2;
+            s.next();
+            if (s.compare_prefix() > 0) return i - 1;
         }
         return n;
     }
 
     id_type left_locate(uint32_range p, uint32_range h,
                         id_type bucket_id) const {
-        INT_FC_DICT_LOCATE_INIT
-        uint32_t len = p.end - p.begin;
+        auto s = scanner(p, h, bucket_id);
+        uint32_t n = bucket_size(bucket_id);
         for (id_type i = 1; i <= n; ++i) {
-            uint8_t l = decode(curr, decoded, &lcp_len);
-            int cmp = uint32_range_compare({decoded, decoded + l}, p, len);
-            if (cmp >= 0) return i;
-            curr += (l - lcp_len) * sizeof(uint32_t) + 2;
+            s.next();
+            if (s.compare_prefix() >= 0) return i;
         }
         return n + 1;
     }
@@ -0,0 +1,236 @@
+#pragma once
+
+#if __cplusplus < 202002L
+#error "interleaved_locate.hpp needs the coroutines of C++20"
+#endif
+
+#include <coroutine>
+#include <utility>
+#include <vector>
+
+#include "util_types.hpp"
+
+namespace autocomplete {
+
+/*
+Frames of the coroutines of this file, recycled by the thread that
+allocated them: once the first group of searches is in flight, starting
+a new search does not allocate.
+*/
+struct search_frame_pool {
+    static constexpr size_t block_size = 64;
+    static constexpr size_t max_blocks = 16;
+
+    ~search_frame_pool() {
+        for (auto& free : m_free) {
+            for (void* frame : free) ::operator delete(frame);
+        }
+    }
+
+    void* allocate(size_t size) {
+        size_t blocks = (size + block_size - 1) / block_size;
+        if (blocks > max_blocks) return ::operator new(size);
+        auto& free = m_free[blocks - 1];
+        if (free.empty()) return ::operator new(blocks * block_size);
+        void* frame = free.back();
+        free.pop_back();
+        return frame;
+    }
+
+    void deallocate(void* frame, size_t size) {
+        size_t blocks = (size + block_size - 1) / block_size;
+        if (blocks > max_blocks) return ::operator delete(frame);
+        m_free[blocks - 1].push_back(frame);
+    }
+
+    static search_frame_pool& local() {
+        static thread_local search_frame_pool pool;
+        return pool;
+    }
+
+private:
+    std::vector<void*> m_free[max_blocks];
+};
+
+/*
+A search that runs until the first memory access that is likely to miss
+the cache, prefetches it, and suspends: resume() runs it to the next one,
+so that the misses of the searches resumed in turn by interleave()
+overlap.
+*/
+struct interleaved_search {
+    struct promise_type {
+        interleaved_search get_return_object() {
+            return interleaved_search(handle_type::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            throw;
+        }
+
+        static void* operator new(size_t size) {
+            return search_frame_pool::local().allocate(size);
+        }
+        static void operator delete(void* frame, size_t size) {
+            search_frame_pool::local().deallocate(frame, size);
+        }
+    };
+
+    typedef std::coroutine_handle<promise_type> handle_type;
+
+    interleaved_search(interleaved_search const&) = delete;
+    interleaved_search& operator=(interleaved_search const&) = delete;
+
+    interleaved_search(interleaved_search&& other)
+        : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+    interleaved_search& operator=(interleaved_search&& other) {
+        if (this != &other) {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~interleaved_search() {
+        if (m_handle) m_handle.destroy();
+    }
+
+    bool done() const {
+        return m_handle.done();
+    }
+
+    void resume() {
+        m_handle.resume();
+    }
+
+private:
+    explicit interleaved_search(handle_type handle)
+        : m_handle(handle) {}
+
+    handle_type m_handle;
+};
+
+/* co_await yield_search{} after a prefetch */
+struct yield_search : std::suspend_always {};
+
+/*
+Run the searches start(0), ..., start(n-1), keeping group_size of them in
+flight: they are resumed in turn, and each one done is replaced by the
+next one to start.
+*/
+template <typename Start>
+void interleave(uint64_t n, uint32_t group_size, Start start) {
+    std::vector<interleaved_search> group;
+    group.reserve(group_size);
+    uint64_t next = 0;
+    for (; next != n and group.size() != group_size; ++next) {
+        group.push_back(start(next));
+    }
+    while (!group.empty()) {
+        for (size_t i = 0; i != group.size();) {
+            group[i].resume();
+            if (!group[i].done()) {
+                ++i;
+            } else if (next != n) {
+                group[i++] = start(next++);
+            } else {
+                if (i + 1 != group.size()) group[i] = std::move(group.back());
+                group.pop_back();
+            }
+        }
+    }
+}
+
+/*
+The same as dict.locate_prefix(p): the binary searches of locate_buckets
+suspend before comparing a header, and the search of the buckets found
+suspends before scanning them.
+*/
+template <typename Dictionary>
+interleaved_search locate_prefix(Dictionary const& dict, byte_range p,
+                                 range& out) {
+    if (p.end - p.begin == 0) {
+        out = {0, dict.size() - 1};
+        co_return;
+    }
+    uint32_t n = p.end - p.begin;
+    int buckets = dict.buckets();
+    range bucket_id;
+
+    int lo = 0, hi = buckets - 1;
+    while (lo <= hi) {
+        int mi = (lo + hi) / 2;
+        dict.prefetch_header(mi);
+        co_await yield_search{};
+        if (byte_range_compare(dict.header(mi), p, n) >= 0) {
+            hi = mi - 1;
+        } else {
+            lo = mi + 1;
+        }
+    }
+
+    if (lo == buckets) {
+        bucket_id = {uint64_t(lo - 1), uint64_t(lo - 1)};
+    } else {
+        int left = 0;
+        if (lo != 0) {
+            left = byte_range_compare(dict.header(lo), p) == 0 ? lo : lo - 1;
+        }
+        bool one_bucket = left == buckets - 1;
+        if (!one_bucket) {
+            dict.prefetch_header(left + 1);
+            co_await yield_search{};
+            one_bucket = byte_range_compare(dict.header(left + 1), p, n) > 0;
+        }
+        if (one_bucket) {
+            bucket_id = {uint64_t(left), uint64_t(left)};
+        } else {
+            lo = left;
+            hi = buckets - 1;
+            while (lo <= hi) {
+                int mi = (lo + hi) / 2;
+                dict.prefetch_header(mi);
+                co_await yield_search{};
+                if (byte_range_compare(dict.header(mi), p, n) <= 0) {
+                    lo = mi + 1;
+                } else {
+                    hi = mi - 1;
+                }
+            }
+            bucket_id = {uint64_t(left), uint64_t(hi)};
+        }
+    }
+
+    dict.prefetch_bucket(bucket_id.begin);
+    if (bucket_id.end != bucket_id.begin) dict.prefetch_bucket(bucket_id.end);
+    co_await yield_search{};
+    out = dict.locate_prefix(p, bucket_id);
+}
+
+/*
+The same as trie.locate_prefix(prefix, suffix_lex_range), suspending
+after descending each level, whose children are prefetched.
+*/
+template <typename Trie>
+interleaved_search locate_prefix(Trie const& trie,
+                                 completion_type const& prefix,
+                                 range suffix_lex_range, range& out) {
+    range pointer = trie.root();
+    for (uint32_t i = 0; i < prefix.size(); ++i) {
+        if (!trie.descend(i, prefix[i], pointer)) {
+            out = global::invalid_range;
+            co_return;
+        }
+        co_await yield_search{};
+    }
+    out = trie.locate_suffix(prefix.size(), pointer, suffix_lex_range);
+}
+
+}  // namespace autocomplete
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+
+#include "util.hpp"
+
+namespace autocomplete {
+
+/*
+A level of the completion_trie that stores, next to the id of each node,
+the position of its first child in the next level, both as plain 32-bit
+integers. Descending from a node to its children then reads a single
+cache line, instead of an access to the Elias-Fano nodes followed by
+two accesses to the Elias-Fano pointers.
+The ids are not prefix-summed across siblings, as with ef_sequence or
+uint_vec, so that searching among the children of a node does not read
+the last id of the previous node either.
+The children of the nodes of the last level, that has none, are empty.
+To be used with interleaved_pointers as the Pointers of the trie.
+*/
+struct interleaved_nodes {
+    template <typename T>
+    void build(std::vector<T> const& from) {
+        m_data.resize(2 * (from.size() + 1), 0);
+        for (uint64_t i = 0; i != from.size(); ++i) m_data[2 * i] = from[i];
+    }
+
+    template <typename T, typename Pointers>
+    void build(std::vector<T> const& from, Pointers const&) {
+        build(from);
+    }
+
+    /* pointers[i] is the position of the first child of node i, and
+       pointers[size()] the number of nodes in the next level */
+    void build_children(std::vector<uint32_t> const& pointers) {
+        assert(pointers.size() > size());
+        for (uint64_t i = 0; i != size() + 1; ++i) {
+            m_data[2 * i + 1] = pointers[i];
+        }
+    }
+
+    size_t size() const {
+        return m_data.size() / 2 - 1;
+    }
+
+    uint32_t access(uint64_t i) const {
+        assert(i < size());
+        return m_data[2 * i];
+    }
+
+    range children(uint64_t i) const {
+        assert(i < size());
+        return {m_data[2 * i + 1], m_data[2 * i + 3]};
+    }
+
+    inline void prefetch(uint64_t i) const {
+        if (i < size()) util::prefetch(m_data.data() + 2 * i);
+    }
+
+    uint64_t find(const range r, uint32_t id) const {
+        assert(r.is_valid());
+        assert(r.end <= size());
+        uint64_t pos = lower_bound(r, id);
+        if (pos == r.end or access(pos) != id) return global::not_found;
+        return pos;
+    }
+
+    range find(const range r, const range lex) const {
+        assert(r.is_valid());
+        assert(r.end <= size());
+        uint64_t begin = lower_bound(r, lex.begin);
+        uint64_t end = lower_bound({begin, r.end}, lex.end + 1);
+        if (begin == end) return {r.end, r.end};
+        return {begin, end};
+    }
+
+    size_t bytes() const {
+        return essentials::vec_bytes(m_data);
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_data);
+    }
+
+private:
+    std::vector<uint32_t> m_data;
+
+    /* first position in r whose id is >= id, or r.end */
+    uint64_t lower_bound(range r, uint64_t id) const {
+        uint64_t lo = r.begin;
+        uint64_t hi = r.end;
+        while (hi - lo > global::linear_scan_threshold) {
+            uint64_t pos = lo + (hi - lo) / 2;
+            if (access(pos) < id) {
+                lo = pos + 1;
+            } else {
+                hi = pos;
+            }
+        }
+        while (lo != hi and access(lo) < id) ++lo;
+        return lo;
+    }
+};
+
+/*
+The Pointers of a completion_trie whose Nodes are interleaved_nodes:
+the pointers are stored in the nodes, so nothing is stored here.
+*/
+struct interleaved_pointers {
+    template <typename T>
+    void build(std::vector<T> const&) {}
+
+    size_t bytes() const {
+        return 0;
+    }
+
+    template <typename Visitor>
+    void visit(Visitor&) {}
+};
+
+}  // namespace autocomplete
@@ -3,6 +3,7 @@
 #include "parameters.hpp"
 #include "integer_codes.hpp"
 #include "building_util.hpp"
+#include "search_budget.hpp"
 #include "ef/ef_sequence.hpp"
 
 namespace autocomplete {
@@ -131,9 +132,25 @@ struct inverted_index {
     }
 
     struct intersection_iterator_type {
+        intersection_iterator_type()
+            : m_budget(nullptr) {
+            m_iterators.reserve(constants::MAX_NUM_TERMS_PER_QUERY);
+        }
+
         intersection_iterator_type(inverted_index const* ii,
                                    std::vector<id_type> const& term_ids) {
+            init(ii, term_ids);
+        }
+
+        /* (re-)start the intersection from the doc_id first, reusing
+           the memory of the previous one: every posting visited is
+           charged to the budget, if any, and the intersection ends
+           when the budget is over */
+        void init(inverted_index const* ii,
+                  std::vector<id_type> const& term_ids, id_type first = 0,
+                  search_budget* budget = nullptr) {
             assert(term_ids.size() > 1);
+            m_iterators.clear();
             m_iterators.reserve(term_ids.size());
             for (auto id : term_ids) {
                 assert(id > 0);  // id 0 is reserved for null terminator
@@ -145,9 +162,11 @@ struct inverted_index {
                           return l.size() < r.size();
                       });
 
-            m_candidate = m_iterators[0].access(0);
+            m_candidate = first == 0 ? m_iterators[0].access(0)
+                                     : m_iterators[0].next_geq(first);
             m_i = 1;
             m_num_docs = ii->num_docs();
+            m_budget = budget;
             next();
         }
 
@@ -171,10 +190,15 @@ struct inverted_index {
         size_t m_i;
         uint64_t m_num_docs;
         std::vector<iterator_type> m_iterators;
+        search_budget* m_budget;
 
         void next() {
             id_type val = 0;
             while (val < m_num_docs and m_i != m_iterators.size()) {
+                if (m_budget and !m_budget->spend()) {
+                    m_candidate = m_num_docs;
+                    return;
+                }
                 val = m_iterators[m_i].next_geq(m_candidate);
                 if (val != m_candidate) {
                     m_candidate = val;
@@ -191,6 +215,13 @@ struct inverted_index {
         return intersection_iterator_type(this, term_ids);
     }
 
+    void intersection_iterator(std::vector<id_type> const& term_ids,
+                               intersection_iterator_type& it,
+                               id_type first = 0,
+                               search_budget* budget = nullptr) const {
+        it.init(this, term_ids, first, budget);
+    }
+
     template <typename Visitor>
     void visit(Visitor& visitor) {
         visitor.visit(m_num_integers);
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace autocomplete {
+
+/*
+A counter written by a single thread and read by any other: increments
+are a relaxed load and store, with no read-modify-write nor fence, so
+that counting costs the querying thread nothing more than a plain one.
+*/
+struct local_counter {
+    local_counter()
+        : m_value(0) {}
+
+    inline void add(uint64_t x) {
+        m_value.store(m_value.load(std::memory_order_relaxed) + x,
+                      std::memory_order_relaxed);
+    }
+
+    uint64_t get() const {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+/* latencies, in buckets of microseconds: the last bucket is unbounded */
+struct latency_histogram {
+    static const uint32_t num_buckets = 15;
+
+    static double upper_bound(uint32_t i) {
+        static const double musec[num_buckets - 1] = {
+            1,    2,    5,    10,   20,    50,    100,
+            200,  500,  1000, 2000, 5000,  10000, 50000};
+        return musec[i];
+    }
+
+    inline void record(uint64_t nanosec) {
+        uint32_t i = 0;
+        while (i != num_buckets - 1 and nanosec > upper_bound(i) * 1000) ++i;
+        m_buckets[i].add(1);
+        m_nanosec.add(nanosec);
+    }
+
+    uint64_t count(uint32_t i) const {
+        return m_buckets[i].get();
+    }
+
+    uint64_t nanosec() const {
+        return m_nanosec.get();
+    }
+
+private:
+    local_counter m_buckets[num_buckets];
+    local_counter m_nanosec;
+};
+
+/*
+The metrics recorded by a thread: the latency of the stages of a query,
+as delimited by the probes of the indexes (0: parse, 1: search,
+2: reporting), the latency of the whole query, the number of queries by
+type and the number of results.
+*/
+struct thread_metrics {
+    static const uint32_t num_stages = 3;
+
+    void record_query(bool conjunctive, uint64_t nanosec, uint64_t results,
+                      bool partial) {
+        queries[conjunctive].add(1);
+        latency.record(nanosec);
+        num_results.add(results);
+        if (results == 0) empty_results.add(1);
+        if (partial) partial_results.add(1);
+    }
+
+    latency_histogram stages[num_stages];
+    latency_histogram latency;
+    local_counter queries[2];  // prefix, conjunctive
+    local_counter num_results;
+    local_counter empty_results;
+    local_counter partial_results;
+};
+
+/* a probe timing the stages of a query into the metrics of its thread */
+struct metrics_probe {
+    typedef std::chrono::steady_clock clock_type;
+
+    metrics_probe(thread_metrics& metrics)
+        : m_metrics(metrics) {}
+
+    inline void start(uint64_t i) {
+        assert(i < thread_metrics::num_stages);
+        m_start[i] = clock_type::now();
+    }
+
+    /* the stages left by a query that returns early are not recorded */
+    inline void stop(uint64_t i) {
+        assert(i < thread_metrics::num_stages);
+        m_metrics.stages[i].record(nanosec_since(m_start[i]));
+    }
+
+    static uint64_t nanosec_since(clock_type::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   clock_type::now() - start)
+            .count();
+    }
+
+private:
+    thread_metrics& m_metrics;
+    clock_type::time_point m_start[thread_metrics::num_stages];
+};
+
+/*
+The metrics of all the threads of a server: every thread records into
+its own thread_metrics, merged when scraped in the text format of
+Prometheus. The lock is taken only the first time a thread records and
+by the scrapes.
+*/
+struct server_metrics {
+    server_metrics()
+        : m_id(next_id()++) {}
+
+    server_metrics(server_metrics const&) = delete;
+    server_metrics& operator=(server_metrics const&) = delete;
+
+    thread_metrics& local() {
+        /* the ids are never reused, unlike the addresses */
+        static thread_local uint64_t owner = 0;
+        static thread_local thread_metrics* metrics = nullptr;
+        if (owner != m_id) {
+            metrics = &register_thread();
+            owner = m_id;
+        }
+        return *metrics;
+    }
+
+    /* the bytes of the index by component, as given by
+       index.for_each_component, are reported as well */
+    template <typename Index>
+    std::string scrape(Index const& index) {
+        std::string out;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64_t queries[2] = {0, 0};
+        uint64_t num_results = 0, empty_results = 0, partial_results = 0;
+        for (auto const& t : m_threads) {
+            for (int c = 0; c != 2; ++c) {
+                queries[c] += t.metrics->queries[c].get();
+            }
+            num_results += t.metrics->num_results.get();
+            empty_results += t.metrics->empty_results.get();
+            partial_results += t.metrics->partial_results.get();
+        }
+        uint64_t total = queries[0] + queries[1];
+
+        header(out, "autocomplete_queries_total", "counter",
+               "Queries answered, by type.");
+        sample(out, "autocomplete_queries_total{type=\"prefix\"}", queries[0]);
+        sample(out, "autocomplete_queries_total{type=\"conjunctive\"}",
+               queries[1]);
+
+        header(out, "autocomplete_results_total", "counter",
+               "Completions reported.");
+        sample(out, "autocomplete_results_total", num_results);
+        header(out, "autocomplete_empty_results_total", "counter",
+               "Queries with no result.");
+        sample(out, "autocomplete_empty_results_total", empty_results);
+        header(out, "autocomplete_empty_results_ratio", "gauge",
+               "Fraction of the queries with no result.");
+        sample(out, "autocomplete_empty_results_ratio",
+               total ? double(empty_results) / total : 0.0);
+        header(out, "autocomplete_partial_results_total", "counter",
+               "Queries stopped by the search budget.");
+        sample(out, "autocomplete_partial_results_total", partial_results);
+
+        header(out, "autocomplete_query_latency_seconds", "histogram",
+               "Latency of the queries.");
+        histogram(out, "autocomplete_query_latency_seconds", "",
+                  [](thread_metrics const& t) -> latency_histogram const& {
+                      return t.latency;
+                  });
+        header(out, "autocomplete_stage_latency_seconds", "histogram",
+               "Latency of the stages of the queries. A query returning "
+               "early, e.g., with a term not in the dictionary, is not "
+               "counted in the stages it skips: the count of a stage can be "
+               "less than autocomplete_queries_total.");
+        static const char* stages[thread_metrics::num_stages] = {
+            "parse", "search", "reporting"};
+        for (uint32_t s = 0; s != thread_metrics::num_stages; ++s) {
+            histogram(out, "autocomplete_stage_latency_seconds",
+                      std::string("stage=\"") + stages[s] + "\",",
+                      [=](thread_metrics const& t)
+                          -> latency_histogram const& { return t.stages[s]; });
+        }
+
+        header(out, "autocomplete_index_bytes", "gauge",
+               "Bytes of the index, by component.");
+        index.for_each_component([&](char const* component, size_t bytes) {
+            sample(out,
+                   std::string("autocomplete_index_bytes{component=\"") +
+                       component + "\"}",
+                   bytes);
+        });
+        return out;
+    }
+
+private:
+    struct thread_entry {
+        std::thread::id id;
+        std::unique_ptr<thread_metrics> metrics;
+    };
+
+    uint64_t m_id;
+    std::mutex m_mutex;
+    std::vector<thread_entry> m_threads;
+
+    static std::atomic<uint64_t>& next_id() {
+        static std::atomic<uint64_t> id(1);
+        return id;
+    }
+
+    thread_metrics& register_thread() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto id = std::this_thread::get_id();
+        for (auto const& t : m_threads) {
+            if (t.id == id) return *t.metrics;
+        }
+        m_threads.push_back({id, std::make_unique<thread_metrics>()});
+        return *m_threads.back().metrics;
+    }
+
+    static void header(std::string& out, char const* name, char const* type,
+                       char const* help) {
+        out += std::string("# HELP ") + name + " " + help + "\n";
+        out += std::string("# TYPE ") + name + " " + type + "\n";
+    }
+
+    static void sample(std::string& out, std::string const& name,
+                       uint64_t value) {
+        out += name + " " + std::to_string(value) + "\n";
+    }
+
+    static void sample(std::string& out, std::string const& name,
+                       double value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%g", value);
+        out += name + " " + buf + "\n";
+    }
+
+    /* labels is empty or ends with a comma */
+    template <typename Get>
+    void histogram(std::string& out, std::string const& name,
+                   std::string const& labels, Get get) {
+        uint64_t counts[latency_histogram::num_buckets] = {0};
+        uint64_t nanosec = 0;
+        for (auto const& t : m_threads) {
+            latency_histogram const& h = get(*t.metrics);
+            for (uint32_t i = 0; i != latency_histogram::num_buckets; ++i) {
+                counts[i] += h.count(i);
+            }
+            nanosec += h.nanosec();
+        }
+        uint64_t cumulative = 0;
+        for (uint32_t i = 0; i != latency_histogram::num_buckets; ++i) {
+            cumulative += counts[i];
+            std::string le = "+Inf";
+            if (i != latency_histogram::num_buckets - 1) {
+                char buf[32];
+                snprintf(buf, sizeof(buf), "%g",
+                         latency_histogram::upper_bound(i) / 1000000);
+                le = buf;
+            }
+            sample(out, name + "_bucket{" + labels + "le=\"" + le + "\"}",
+                   cumulative);
+        }
+        std::string suffix = labels.empty()
+                                 ? ""
+                                 : "{" + labels.substr(0, labels.size() - 1) +
+                                       "}";
+        sample(out, name + "_sum" + suffix, nanosec / 1e9);
+        sample(out, name + "_count" + suffix, cumulative);
+    }
+};
+
+}  // namespace autocomplete
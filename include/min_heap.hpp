@@ -37,6 +37,13 @@ struct min_heap {
         m_q.pop_back();
     }
 
+    /* as pop() followed by push(t), but sifting down once */
+    void replace_top(T const& t) {
+        assert(!empty());
+        m_q.front() = t;
+        sink(0);
+    }
+
     void push_back(T const& t) {
         m_q.push_back(t);
     }
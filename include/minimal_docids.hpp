@@ -2,12 +2,15 @@
 
 #include "compact_vector.hpp"
 #include "util_types.hpp"
+#include "min_heap.hpp"
+#include "tombstones.hpp"
+#include "constants.hpp"
 
 namespace autocomplete {
 
 template <typename RMQ, typename InvertedIndex>
 struct minimal_docids {
-    static const uint32_t SCAN_THRESHOLD = 64;
+    static const uint32_t SCAN_THRESHOLD = RMQ::SCAN_THRESHOLD;
     typedef scored_range_with_list_iterator<
         typename InvertedIndex::iterator_type>
         range_type;
@@ -15,7 +18,18 @@ struct minimal_docids {
         typename range_type::iterator_type>
         comparator_range_type;
 
-    minimal_docids() {}
+    typedef min_heap<range_type, comparator_range_type> min_priority_queue_type;
+
+    minimal_docids() {
+        reserve(m_q);
+    }
+
+    /* every doc_id visited, reported or deleted, splits a range in two
+       at most */
+    static void reserve(min_priority_queue_type& q, size_t num_deleted = 0) {
+        q.reserve(constants::MAX_FUZZY_RANGES +
+                  2 * (constants::MAX_K + num_deleted));
+    }
 
     void build(std::vector<id_type> const& list) {
         essentials::logger("building minimal_docids...");
@@ -24,23 +38,35 @@ struct minimal_docids {
         essentials::logger("DONE");
     }
 
-    uint32_t topk(InvertedIndex const& index, const range r, const uint32_t k,
-                  std::vector<id_type>& topk_scores) {
-        range_type sr;
-        sr.r = {r.begin, r.end - 1};  // rmq needs inclusive ranges
-        sr.min_pos = m_rmq.rmq(sr.r.begin, sr.r.end);
-        sr.min_val = m_list.access(sr.min_pos);
+    /* Range is either a range or a range_list: all the ranges are
+       traversed at once, so that the doc_ids are reported in sorted
+       order and a duplicate always follows the last reported doc_id */
+    template <typename Range>
+    uint32_t topk(InvertedIndex const& index, Range const& r, const uint32_t k,
+                  std::vector<id_type>& topk_scores,
+                  tombstone_set const& deleted = tombstone_set::empty_set()) {
+        return topk(index, r, k, topk_scores, m_q, deleted);
+    }
 
-        m_q.clear();
-        m_q.push(sr);
+    /* the queue q is scratch memory, so that threads can share the list */
+    template <typename Range>
+    uint32_t topk(InvertedIndex const& index, Range const& r, const uint32_t k,
+                  std::vector<id_type>& topk_scores,
+                  min_priority_queue_type& q,
+                  tombstone_set const& deleted =
+                      tombstone_set::empty_set()) const {
+        // NOTE: allocates only for a larger set of deleted values
+        reserve(q, deleted.size());
+        q.clear();
+        push(q, r);
 
         uint32_t results = 0;
-        while (!m_q.empty()) {
-            auto& min = m_q.top();
+        while (!q.empty()) {
+            auto& min = q.top();
             auto docid = min.minimum();
-            bool alread_present = std::binary_search(
-                topk_scores.begin(), topk_scores.begin() + results, docid);
-            if (!alread_present) {
+            bool alread_present =
+                results > 0 and topk_scores[results - 1] == docid;
+            if (!alread_present and !deleted.contains(docid)) {
                 topk_scores[results++] = docid;
                 if (results == k) break;
             }
@@ -48,9 +74,9 @@ struct minimal_docids {
             if (min.is_open()) {
                 min.iterator.next();
                 if (!min.iterator.has_next()) {
-                    m_q.pop();
+                    q.pop();
                 }
-                m_q.heapify();
+                q.heapify();
             } else {
                 // save
                 auto min_range = min.r;
@@ -59,33 +85,35 @@ struct minimal_docids {
                 min.set_iterator(index);
                 min.iterator.next();
                 if (!min.iterator.has_next()) {
-                    m_q.pop();
+                    q.pop();
                 }
 
-                m_q.heapify();
+                q.heapify();
 
                 if (min_pos > 0 and min_pos - 1 >= min_range.begin) {
                     range_type left;
                     left.r = {min_range.begin, min_pos - 1};
                     if (left.r.end - left.r.begin <= SCAN_THRESHOLD) {
-                        left.min_pos = rmq(left.r.begin, left.r.end);
+                        left.min_pos = util::scan_rmq<SCAN_THRESHOLD>(
+                            m_list, left.r.begin, left.r.end);
                     } else {
                         left.min_pos = m_rmq.rmq(left.r.begin, left.r.end);
                     }
                     left.min_val = m_list.access(left.min_pos);
-                    m_q.push(left);
+                    q.push(left);
                 }
 
                 if (min_pos < size() - 1 and min_range.end >= min_pos + 1) {
                     range_type right;
                     right.r = {min_pos + 1, min_range.end};
                     if (right.r.end - right.r.begin <= SCAN_THRESHOLD) {
-                        right.min_pos = rmq(right.r.begin, right.r.end);
+                        right.min_pos = util::scan_rmq<SCAN_THRESHOLD>(
+                            m_list, right.r.begin, right.r.end);
                     } else {
                         right.min_pos = m_rmq.rmq(right.r.begin, right.r.end);
                     }
                     right.min_val = m_list.access(right.min_pos);
-                    m_q.push(right);
+                    q.push(right);
                 }
             }
         }
@@ -108,23 +136,21 @@ struct minimal_docids {
     }
 
 private:
-    typedef min_heap<range_type, comparator_range_type> min_priority_queue_type;
     min_priority_queue_type m_q;
 
     RMQ m_rmq;
     compact_vector m_list;
 
-    uint64_t rmq(uint64_t lo, uint64_t hi) {  // inclusive endpoints
-        uint64_t pos = lo;
-        id_type min = id_type(-1);
-        for (uint64_t i = lo; i <= hi; ++i) {
-            id_type val = m_list.access(i);
-            if (val < min) {
-                min = val;
-                pos = i;
-            }
-        }
-        return pos;
+    void push(min_priority_queue_type& q, const range r) const {
+        range_type sr;
+        sr.r = {r.begin, r.end - 1};  // rmq needs inclusive ranges
+        sr.min_pos = m_rmq.rmq(sr.r.begin, sr.r.end);
+        sr.min_val = m_list.access(sr.min_pos);
+        q.push(sr);
+    }
+
+    void push(min_priority_queue_type& q, range_list const& ranges) const {
+        for (auto r : ranges) push(q, r);
     }
 };
 
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+
+#include "util_types.hpp"
+#include "constants.hpp"
+
+namespace autocomplete {
+
+/*
+Normalisation of UTF-8 text, applied in the same way to the completions,
+before the index is built (see src/normalise.cpp), and to the queries,
+before they are parsed.
+
+Text is case-folded and stripped of its diacritics, and compatibility
+characters (full-width forms, ligatures, Unicode spaces) are replaced by
+their canonical equivalents, as NFKC_Casefold followed by the removal of
+the combining marks would do; the Latin letters that do not decompose
+are folded to ASCII as well, e.g., 'æ' to "ae" and 'ø' to 'o'.
+The mapping is table-driven and covers the Latin (up to U+017F), Greek
+and Cyrillic scripts: any other character is kept as it is.
+The resulting terms are separated by a single space; the separators are
+the ASCII whitespace characters plus the configured ones.
+
+The output is never longer than the input, and is written to an internal
+buffer, or to the given one when the normaliser is shared by threads:
+no memory is allocated per query.
+*/
+struct normaliser {
+    /* longer inputs are truncated */
+    static const uint32_t BUFFER_SIZE =
+        4 * constants::MAX_NUM_CHARS_PER_QUERY;
+
+    struct buffer {
+        buffer() {
+            data[0] = 0;  // sentinel: not a space
+        }
+
+        uint8_t data[BUFFER_SIZE + 1];
+    };
+
+    normaliser(std::string const& separators = "") {
+        for (uint32_t c = 0; c != 128; ++c) m_ascii[c] = c;
+        for (uint32_t c = 'A'; c <= 'Z'; ++c) m_ascii[c] = c - 'A' + 'a';
+        for (uint8_t c : std::string(" \t\n\v\f\r") + separators) {
+            if (c >= 128) {
+                throw std::runtime_error(
+                    "separators must be ASCII characters");
+            }
+            m_ascii[c] = ' ';
+        }
+
+        /* U+00C0 to U+017F: "-" keeps the character as it is */
+        static const char* latin =
+            "a a a a a a ae c e e e e i i i i d n o o o o o - o u u u u y th "
+            "ss a a a a a a ae c e e e e i i i i d n o o o o o - o u u u u y "
+            "th y a a a a a a c c c c c c c c d d d d e e e e e e e e e e g g "
+            "g g g g g g h h h h i i i i i i i i i i ij ij j j k k k l l l l "
+            "l l l l l l n n n n n n n n n o o o o o o oe oe r r r r r r s s "
+            "s s s s s s t t t t t t u u u u u u u u u u u u w w y y y z z z "
+            "z z z s";
+        uint32_t i = 0;
+        for (char const* p = latin; *p; ++i) {
+            assert(i < LATIN_SIZE);
+            m_latin[i][0] = m_latin[i][1] = 0;
+            for (uint32_t j = 0; *p and *p != ' '; ++j, ++p) {
+                m_latin[i][j] = *p == '-' ? 0 : *p;
+            }
+            if (*p == ' ') ++p;
+        }
+        assert(i == LATIN_SIZE);
+    }
+
+    byte_range operator()(std::string const& s) {
+        return operator()(string_to_byte_range(s));
+    }
+
+    /* the result is valid until the next call */
+    byte_range operator()(byte_range in) {
+        return operator()(in, m_buffer);
+    }
+
+    byte_range operator()(std::string const& s, buffer& b) const {
+        return operator()(string_to_byte_range(s), b);
+    }
+
+    /* the result is valid until the next call with the same buffer */
+    byte_range operator()(byte_range in, buffer& b) const {
+        if (in.end - in.begin > BUFFER_SIZE) {
+            in.end = in.begin + BUFFER_SIZE;
+            while (in.end != in.begin and (*in.end & 0xC0) == 0x80) --in.end;
+        }
+
+        uint8_t* out = b.data + 1;
+        uint8_t const* p = in.begin;
+        while (p != in.end) {
+            /* ASCII fast path: 8 bytes at once, unless two spaces must
+               be collapsed */
+            uint64_t word;
+            if (in.end - p >= 8 and ascii8(p, word)) {
+                word = 0;
+                for (uint32_t i = 0; i != 8; ++i) {
+                    word |= uint64_t(m_ascii[p[i]]) << (8 * i);
+                }
+                uint64_t spaces = zero_bytes(word ^ 0x2020202020202020ULL);
+                uint64_t after_space = spaces << 8 | (out[-1] == ' ') << 7;
+                if ((spaces & after_space) == 0) {
+                    memcpy(out, &word, 8);
+                    out += 8;
+                } else {
+                    for (uint32_t i = 0; i != 8; ++i) put(out, word >> (8 * i));
+                }
+                p += 8;
+                continue;
+            }
+            if (*p < 0x80) {
+                put(out, m_ascii[*p++]);
+                continue;
+            }
+            uint32_t cp = 0;
+            uint32_t len = decode(p, in.end, cp);
+            if (len == 0) {  // invalid encoding: kept as it is
+                *out++ = *p++;
+                continue;
+            }
+            if (!fold(cp, out)) {
+                memcpy(out, p, len);
+                out += len;
+            }
+            p += len;
+        }
+
+        assert(out - b.data - 1 <= in.end - in.begin);
+        return {b.data + 1, out};
+    }
+
+    /* the number of bytes of the character at p, as read by the
+       normaliser: 1 for ASCII and for a byte of an invalid encoding */
+    static uint32_t char_length(uint8_t const* p, uint8_t const* end) {
+        assert(p < end);
+        if (*p < 0x80) return 1;
+        uint32_t cp = 0;
+        uint32_t len = decode(p, end, cp);
+        return len == 0 ? 1 : len;
+    }
+
+private:
+    static const uint32_t LATIN_SIZE = 0x180 - 0xC0;
+
+    uint8_t m_ascii[128];
+    uint8_t m_latin[LATIN_SIZE][2];
+    buffer m_buffer;
+
+    static bool ascii8(uint8_t const* p, uint64_t& word) {
+        memcpy(&word, p, 8);
+        return (word & 0x8080808080808080ULL) == 0;
+    }
+
+    /* the most significant bit of each zero byte of x is set */
+    static uint64_t zero_bytes(const uint64_t x) {
+        const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+        return ~(((x & low7) + low7) | x) & ~low7;
+    }
+
+    /* append a byte, collapsing consecutive spaces */
+    static void put(uint8_t*& out, const uint8_t c) {
+        *out = c;
+        out += c != ' ' or out[-1] != ' ';
+    }
+
+    static void put_utf8(uint8_t*& out, const uint32_t cp) {
+        assert(cp >= 0x80 and cp < 0x800);  // enough for Greek and Cyrillic
+        *out++ = 0xC0 | (cp >> 6);
+        *out++ = 0x80 | (cp & 0x3F);
+    }
+
+    static void put_ascii(uint8_t*& out, char const* s) {
+        for (; *s; ++s) put(out, *s);
+    }
+
+    /* return the number of bytes of the code point at p, or 0 if the
+       encoding is invalid */
+    static uint32_t decode(uint8_t const* p, uint8_t const* end,
+                           uint32_t& cp) {
+        uint32_t len = 0;
+        if (*p >= 0xF8) {
+            return 0;
+        } else if (*p >= 0xF0) {
+            len = 4;
+            cp = *p & 0x07;
+        } else if (*p >= 0xE0) {
+            len = 3;
+            cp = *p & 0x0F;
+        } else if (*p >= 0xC2) {
+            len = 2;
+            cp = *p & 0x1F;
+        } else {
+            return 0;
+        }
+        if (end - p < len) return 0;
+        for (uint32_t i = 1; i != len; ++i) {
+            if ((p[i] & 0xC0) != 0x80) return 0;
+            cp = (cp << 6) | (p[i] & 0x3F);
+        }
+        return len;
+    }
+
+    /* write the normalised form of the code point and return true,
+       or return false if the code point must be kept as it is */
+    bool fold(uint32_t cp, uint8_t*& out) const {
+        if (cp >= 0xC0 and cp < 0x180) {
+            uint8_t const* s = m_latin[cp - 0xC0];
+            if (s[0] == 0) return false;
+            put(out, s[0]);
+            if (s[1]) put(out, s[1]);
+            return true;
+        }
+        if (cp >= 0x300 and cp < 0x370) return true;  // combining marks
+        if (cp >= 0x370 and cp < 0x400) return fold_greek(cp, out);
+        if (cp >= 0x400 and cp < 0x460) return fold_cyrillic(cp, out);
+        if (cp >= 0xFF01 and cp <= 0xFF5E) {  // full-width ASCII
+            put(out, m_ascii[cp - 0xFF01 + 0x21]);
+            return true;
+        }
+        if (cp >= 0xFB00 and cp <= 0xFB06) {  // ligatures
+            static const char* ligatures[] = {"ff",  "fi", "fl", "ffi",
+                                              "ffl", "st", "st"};
+            put_ascii(out, ligatures[cp - 0xFB00]);
+            return true;
+        }
+        if (cp == 0xA0 or cp == 0x1680 or (cp >= 0x2000 and cp <= 0x200A) or
+            cp == 0x202F or cp == 0x205F or cp == 0x3000) {  // spaces
+            put(out, ' ');
+            return true;
+        }
+        switch (cp) {
+            case 0xAA:
+                put(out, 'a');
+                return true;
+            case 0xB2:
+                put(out, '2');
+                return true;
+            case 0xB3:
+                put(out, '3');
+                return true;
+            case 0xB5:  // micro sign
+                put_utf8(out, 0x3BC);
+                return true;
+            case 0xB9:
+                put(out, '1');
+                return true;
+            case 0xBA:
+                put(out, 'o');
+                return true;
+        }
+        return false;
+    }
+
+    static bool fold_greek(uint32_t cp, uint8_t*& out) {
+        if (cp >= 0x391 and cp <= 0x3A9 and cp != 0x3A2) cp += 0x20;
+        switch (cp) {
+            case 0x386:
+            case 0x3AC:
+                cp = 0x3B1;  // alpha
+                break;
+            case 0x388:
+            case 0x3AD:
+                cp = 0x3B5;  // epsilon
+                break;
+            case 0x389:
+            case 0x3AE:
+                cp = 0x3B7;  // eta
+                break;
+            case 0x38A:
+            case 0x390:
+            case 0x3AA:
+            case 0x3AF:
+            case 0x3CA:
+                cp = 0x3B9;  // iota
+                break;
+            case 0x38C:
+            case 0x3CC:
+                cp = 0x3BF;  // omicron
+                break;
+            case 0x38E:
+            case 0x3AB:
+            case 0x3B0:
+            case 0x3CB:
+            case 0x3CD:
+                cp = 0x3C5;  // upsilon
+                break;
+            case 0x38F:
+            case 0x3CE:
+                cp = 0x3C9;  // omega
+                break;
+            case 0x3C2:
+                cp = 0x3C3;  // final sigma
+                break;
+        }
+        put_utf8(out, cp);
+        return true;
+    }
+
+    static bool fold_cyrillic(uint32_t cp, uint8_t*& out) {
+        if (cp < 0x410) {
+            cp += 0x50;
+        } else if (cp < 0x430) {
+            cp += 0x20;
+        }
+        switch (cp) {
+            case 0x450:
+            case 0x451:
+                cp = 0x435;  // ie
+                break;
+            case 0x439:
+            case 0x45D:
+                cp = 0x438;  // i
+                break;
+            case 0x453:
+                cp = 0x433;  // ghe
+                break;
+            case 0x457:
+                cp = 0x456;  // byelorussian-ukrainian i
+                break;
+            case 0x45C:
+                cp = 0x43A;  // ka
+                break;
+            case 0x45E:
+                cp = 0x443;  // u
+                break;
+        }
+        put_utf8(out, cp);
+        return true;
+    }
+};
+
+}  // namespace autocomplete
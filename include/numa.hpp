@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sched.h>
+
+namespace autocomplete {
+
+/*
+The NUMA nodes of the machine and their CPUs, as listed in
+/sys/devices/system/node: the online nodes are numbered from 0 here,
+whatever their ids, that may have gaps. The nodes without CPUs, e.g.,
+of memory only, are left out. Without NUMA support, the machine is
+seen as a single node holding all the CPUs.
+
+An index is best placed on the node of the threads querying it:
+a thread bound to a node with bind_to_node() and then loading an index
+allocates the memory of the index on that node, as Linux places a page
+on the node of the thread that first touches it.
+The threads of a node then share the replica of their node, each with a
+query_context of its own (see autocomplete.hpp), since the queries given
+a context do not modify the index.
+*/
+struct numa_topology {
+    numa_topology(std::string const& root = "/sys/devices/system/node") {
+        std::ifstream online(root + "/online");
+        std::string list;
+        if (std::getline(online, list)) {
+            for (auto id : parse_list(list)) {
+                std::ifstream in(root + "/node" + std::to_string(id) +
+                                 "/cpulist");
+                std::string cpus;
+                if (!std::getline(in, cpus)) continue;
+                auto parsed = parse_list(cpus);
+                if (parsed.empty()) continue;
+                m_ids.push_back(id);
+                m_cpus.push_back(std::move(parsed));
+            }
+        }
+        if (m_cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            sched_getaffinity(0, sizeof(set), &set);
+            m_ids.push_back(0);
+            m_cpus.emplace_back();
+            for (uint32_t cpu = 0; cpu != CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) m_cpus.back().push_back(cpu);
+            }
+        }
+    }
+
+    uint32_t num_nodes() const {
+        return m_cpus.size();
+    }
+
+    /* the id of the node in /sys/devices/system/node */
+    uint32_t id(uint32_t node) const {
+        assert(node < num_nodes());
+        return m_ids[node];
+    }
+
+    std::vector<uint32_t> const& cpus(uint32_t node) const {
+        assert(node < num_nodes());
+        return m_cpus[node];
+    }
+
+    /* restrict the calling thread to the CPUs of the node */
+    bool bind_to_node(uint32_t node) const {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto cpu : cpus(node)) CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+
+    /* f(node) for every node, in parallel, each by a thread bound to the
+       node, e.g., to load a replica of an index per node */
+    template <typename F>
+    void for_each_node(F f) const {
+        std::vector<std::thread> threads;
+        for (uint32_t node = 0; node != num_nodes(); ++node) {
+            threads.emplace_back([&, node] {
+                bind_to_node(node);
+                f(node);
+            });
+        }
+        for (auto& t : threads) t.join();
+    }
+
+    /* e.g., "0-3,8-11" */
+    static std::vector<uint32_t> parse_list(std::string const& list) {
+        std::vector<uint32_t> values;
+        size_t pos = 0;
+        while (pos < list.size()) {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos) end = list.size();
+            std::string item = list.substr(pos, end - pos);
+            size_t dash = item.find('-');
+            if (item.find_first_not_of(" \t\n") != std::string::npos) {
+                uint32_t first = std::stoul(item.substr(0, dash));
+                uint32_t last = dash == std::string::npos
+                                    ? first
+                                    : std::stoul(item.substr(dash + 1));
+                for (uint32_t v = first; v <= last; ++v) values.push_back(v);
+            }
+            pos = end + 1;
+        }
+        return values;
+    }
+
+private:
+    std::vector<uint32_t> m_ids;
+    std::vector<std::vector<uint32_t>> m_cpus;
+};
+
+}  // namespace autocomplete
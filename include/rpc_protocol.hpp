@@ -0,0 +1,307 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "constants.hpp"
+#include "util_types.hpp"
+#include "probe.hpp"
+
+namespace autocomplete {
+namespace rpc {
+
+/*
+A compact binary protocol for the calls between services, served by the
+web_server on a TCP port of its own besides the HTTP one.
+A request and its response are frames of bytes, prefixed by their length:
+a client may send many requests without waiting (pipelining), answered in
+order, and each request may carry a batch of queries.
+All integers are little-endian, whatever the byte order of the host.
+
+request frame:
+  u32 length of the rest of the frame
+  u32 request id, echoed by the response
+  u16 number of queries, then for each query:
+      u8 mode (see query_mode), u8 k, u16 length, the bytes of the query
+
+response frame:
+  u32 length of the rest of the frame
+  u32 request id
+  u16 number of queries, then for each query:
+      u8 flags (see partial_flag and error_flag), u8 number of results n,
+      n x u32 doc_ids, by increasing doc_id, i.e., by decreasing score,
+      n x u32 end offsets of the strings in the bytes that follow,
+      the bytes of the n strings, one after the other
+*/
+
+enum query_mode : uint8_t { prefix = 0, conjunctive = 1 };
+
+/* the query stopped before finding all its results (see search_budget) */
+static const uint8_t partial_flag = 1;
+
+/* the query was rejected, e.g., longer than MAX_NUM_CHARS_PER_QUERY bytes,
+   and has no results */
+static const uint8_t error_flag = 2;
+
+static const uint32_t header_bytes = 4;
+static const uint32_t max_frame_bytes = 1 << 20;
+
+/* the unsigned integer x, least significant byte first: compilers
+   turn these loops into a plain store/load on little-endian hosts */
+template <typename T>
+void store_le(void* dst, T x) {
+    uint8_t* bytes = static_cast<uint8_t*>(dst);
+    for (size_t i = 0; i != sizeof(T); ++i) bytes[i] = uint8_t(x >> (8 * i));
+}
+
+template <typename T>
+T load_le(void const* src) {
+    uint8_t const* bytes = static_cast<uint8_t const*>(src);
+    T x = 0;
+    for (size_t i = 0; i != sizeof(T); ++i) x |= T(bytes[i]) << (8 * i);
+    return x;
+}
+
+template <typename T>
+void write(std::string& out, T x) {
+    char bytes[sizeof(T)];
+    store_le(bytes, x);
+    out.append(bytes, sizeof(T));
+}
+
+template <typename T>
+T read(byte_range& in) {
+    if (size_t(in.end - in.begin) < sizeof(T)) {
+        throw std::runtime_error("truncated frame");
+    }
+    T x = load_le<T>(in.begin);
+    in.begin += sizeof(T);
+    return x;
+}
+
+inline byte_range read_bytes(byte_range& in, size_t n) {
+    if (size_t(in.end - in.begin) < n) {
+        throw std::runtime_error("truncated frame");
+    }
+    byte_range bytes = {in.begin, in.begin + n};
+    in.begin += n;
+    return bytes;
+}
+
+/* the size of the frame at the front of the bytes received, header
+   included, if complete, or 0 if more bytes are needed */
+inline size_t frame_size(byte_range received) {
+    if (size_t(received.end - received.begin) < header_bytes) return 0;
+    uint32_t length = read<uint32_t>(received);
+    if (length > max_frame_bytes) {
+        throw std::runtime_error("frame of " + std::to_string(length) +
+                                 " bytes, more than the maximum of " +
+                                 std::to_string(max_frame_bytes));
+    }
+    if (size_t(received.end - received.begin) < length) return 0;
+    return header_bytes + length;
+}
+
+/* a frame is written in place, at the end of out, and its length is set
+   by finish() */
+struct frame_writer {
+    frame_writer(std::string& out, uint32_t id)
+        : m_out(out)
+        , m_begin(out.size())
+        , m_num_queries(0) {
+        write<uint32_t>(m_out, 0);
+        write<uint32_t>(m_out, id);
+        write<uint16_t>(m_out, 0);
+    }
+
+    void add_query(query_mode mode, uint32_t k, std::string const& query) {
+        if (query.size() > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("query too long");
+        }
+        next();
+        write<uint8_t>(m_out, mode);
+        write<uint8_t>(m_out, k);
+        write<uint16_t>(m_out, query.size());
+        m_out.append(query);
+    }
+
+    /* the answer to a query asking for no results (k = 0) */
+    void add_no_results() {
+        next();
+        write<uint8_t>(m_out, 0);
+        write<uint8_t>(m_out, 0);
+    }
+
+    /* the answer to a rejected query */
+    void add_error() {
+        next();
+        write<uint8_t>(m_out, error_flag);
+        write<uint8_t>(m_out, 0);
+    }
+
+    template <typename Iterator>
+    void add_results(Iterator it, bool partial) {
+        next();
+        uint32_t n = it.size();
+        write<uint8_t>(m_out, partial ? partial_flag : 0);
+        write<uint8_t>(m_out, n);
+        size_t doc_ids = m_out.size();
+        m_out.resize(doc_ids + 2 * n * sizeof(uint32_t));
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i != n; ++i, ++it) {
+            auto completion = *it;
+            uint32_t doc_id = completion.score;
+            offset += completion.string.end - completion.string.begin;
+            store_le(&m_out[doc_ids + i * sizeof(uint32_t)], doc_id);
+            store_le(&m_out[doc_ids + (n + i) * sizeof(uint32_t)], offset);
+            m_out.append(reinterpret_cast<char const*>(completion.string.begin),
+                         completion.string.end - completion.string.begin);
+        }
+    }
+
+    void finish() {
+        uint32_t length = m_out.size() - m_begin - header_bytes;
+        store_le(&m_out[m_begin], length);
+        store_le(&m_out[m_begin + header_bytes + sizeof(uint32_t)],
+                 m_num_queries);
+    }
+
+private:
+    std::string& m_out;
+    size_t m_begin;
+    uint16_t m_num_queries;
+
+    void next() {
+        if (m_num_queries == std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("too many queries in a frame");
+        }
+        ++m_num_queries;
+    }
+};
+
+/*
+Answer the queries of a request frame, appending the response frame to
+out: query is the buffer the queries are copied into, reused by every
+request, as the HTTP handler does. search(mode, k, query) returns the
+iterator over the results of the query and whether they are partial.
+A query with k = 0 is answered with no results, without searching: the
+top-k loops of the indexes stop only when k results are found.
+A query longer than MAX_NUM_CHARS_PER_QUERY bytes is answered with
+error_flag, rather than searching for a truncated query.
+*/
+template <typename Search>
+void answer(byte_range frame, std::string& query, std::string& out,
+            Search search) {
+    read<uint32_t>(frame);
+    uint32_t id = read<uint32_t>(frame);
+    uint16_t num_queries = read<uint16_t>(frame);
+    frame_writer response(out, id);
+    for (uint16_t i = 0; i != num_queries; ++i) {
+        uint8_t mode = read<uint8_t>(frame);
+        uint32_t k = std::min<uint32_t>(read<uint8_t>(frame), constants::MAX_K);
+        byte_range bytes = read_bytes(frame, read<uint16_t>(frame));
+        if (mode != query_mode::prefix and mode != query_mode::conjunctive) {
+            throw std::runtime_error("unknown query mode " +
+                                     std::to_string(mode));
+        }
+        size_t length = bytes.end - bytes.begin;
+        if (length > constants::MAX_NUM_CHARS_PER_QUERY) {
+            response.add_error();
+            continue;
+        }
+        query.assign(reinterpret_cast<char const*>(bytes.begin), length);
+        if (k == 0) {
+            response.add_no_results();
+            continue;
+        }
+        auto results = search(query_mode(mode), k, query);
+        response.add_results(results.first, results.second);
+    }
+    response.finish();
+}
+
+template <typename Index>
+void answer(Index& index, byte_range frame, std::string& query,
+            std::string& out) {
+    answer(frame, query, out,
+           [&](query_mode mode, uint32_t k, std::string const& q) {
+               nop_probe probe;
+               if (mode == query_mode::prefix) {
+                   return std::make_pair(index.prefix_topk(q, k, probe), false);
+               }
+               auto it = index.conjunctive_topk(q, k, probe);
+               return std::make_pair(it, index.partial());
+           });
+}
+
+/* the results of the queries of a response frame, for the clients */
+struct response_reader {
+    struct results {
+        bool partial;
+        bool error;
+        uint32_t size;
+
+        uint32_t doc_id(uint32_t i) const {
+            return load_le<uint32_t>(m_doc_ids + i * sizeof(uint32_t));
+        }
+
+        byte_range string(uint32_t i) const {
+            uint32_t begin = 0;
+            if (i) {
+                begin = load_le<uint32_t>(m_ends + (i - 1) * sizeof(uint32_t));
+            }
+            uint32_t end = load_le<uint32_t>(m_ends + i * sizeof(uint32_t));
+            return {m_strings + begin, m_strings + end};
+        }
+
+    private:
+        friend struct response_reader;
+        uint8_t const* m_doc_ids;
+        uint8_t const* m_ends;
+        uint8_t const* m_strings;
+    };
+
+    response_reader(byte_range frame)
+        : m_frame(frame) {
+        read<uint32_t>(m_frame);
+        m_id = read<uint32_t>(m_frame);
+        m_num_queries = read<uint16_t>(m_frame);
+    }
+
+    uint32_t id() const {
+        return m_id;
+    }
+
+    uint32_t num_queries() const {
+        return m_num_queries;
+    }
+
+    /* the results of the next query */
+    results next() {
+        results r;
+        uint8_t flags = read<uint8_t>(m_frame);
+        r.partial = flags & partial_flag;
+        r.error = flags & error_flag;
+        r.size = read<uint8_t>(m_frame);
+        r.m_doc_ids = read_bytes(m_frame, r.size * sizeof(uint32_t)).begin;
+        r.m_ends = read_bytes(m_frame, r.size * sizeof(uint32_t)).begin;
+        uint32_t bytes = 0;
+        if (r.size) {
+            bytes = load_le<uint32_t>(r.m_ends +
+                                      (r.size - 1) * sizeof(uint32_t));
+        }
+        r.m_strings = read_bytes(m_frame, bytes).begin;
+        return r;
+    }
+
+private:
+    byte_range m_frame;
+    uint32_t m_id;
+    uint32_t m_num_queries;
+};
+
+}  // namespace rpc
+}  // namespace autocomplete
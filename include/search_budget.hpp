@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace autocomplete {
+
+/*
+Limit on the work done by a conjunctive query: the number of postings
+visited, including the ones skipped by the intersection iterators, and/or
+the time spent visiting them.
+Since the postings are visited in doc_id order, i.e., by decreasing score,
+a query that runs out of budget reports the best completions found so far:
+they are the first ones of the complete result, just fewer than k.
+The clock is read once every CLOCK_INTERVAL postings, so that an unlimited
+or a postings-only budget costs an increment and a comparison per posting.
+*/
+struct search_budget {
+    static const uint64_t UNLIMITED = std::numeric_limits<uint64_t>::max();
+    static const uint64_t CLOCK_INTERVAL = 256;
+
+    search_budget(uint64_t max_postings = UNLIMITED,
+                  uint64_t max_microseconds = UNLIMITED)
+        : m_max_postings(max_postings)
+        , m_max_microseconds(max_microseconds) {
+        start();
+    }
+
+    /* called at the beginning of every query */
+    void start() {
+        m_postings = 0;
+        m_partial = false;
+        m_next_check = m_max_postings;
+        if (timed()) {
+            m_deadline = clock_type::now() +
+                         std::chrono::microseconds(m_max_microseconds);
+            m_next_check = std::min(m_next_check, CLOCK_INTERVAL);
+        }
+    }
+
+    /* account for a posting about to be visited: return false if the
+       budget is over, in which case the query must stop */
+    inline bool spend() {
+        if (m_postings < m_next_check) {
+            ++m_postings;
+            return true;
+        }
+        return check();
+    }
+
+    /* true if the last query stopped before finding all its results */
+    bool partial() const {
+        return m_partial;
+    }
+
+    uint64_t postings() const {
+        return m_postings;
+    }
+
+    bool unlimited() const {
+        return m_max_postings == UNLIMITED and !timed();
+    }
+
+private:
+    typedef std::chrono::steady_clock clock_type;
+
+    uint64_t m_max_postings;
+    uint64_t m_max_microseconds;
+    uint64_t m_postings;
+    uint64_t m_next_check;
+    clock_type::time_point m_deadline;
+    bool m_partial;
+
+    bool timed() const {
+        return m_max_microseconds != UNLIMITED;
+    }
+
+    bool check() {
+        if (m_postings >= m_max_postings or
+            (timed() and clock_type::now() >= m_deadline)) {
+            m_partial = true;
+            return false;
+        }
+        ++m_postings;
+        m_next_check = std::min(m_postings + CLOCK_INTERVAL, m_max_postings);
+        return true;
+    }
+};
+
+}  // namespace autocomplete
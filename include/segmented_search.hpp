@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "util_types.hpp"
+#include "constants.hpp"
+
+namespace autocomplete {
+
+/*
+Threads running the tasks of the jobs posted by run(). The thread posting
+a job runs its tasks as well, and the pool threads take the tasks of the
+oldest job that has some left: the tasks of a job are taken in order.
+The pool can be shared by many indexes, queried by different threads.
+Once the list of the jobs has grown to the number of threads posting
+jobs at once, running a job does not allocate memory.
+*/
+struct search_pool {
+    search_pool(uint32_t num_threads)
+        : m_stop(false) {
+        m_jobs.reserve(num_threads + 1);
+        for (uint32_t i = 0; i != num_threads; ++i) {
+            m_threads.emplace_back(&search_pool::work, this);
+        }
+    }
+
+    search_pool(search_pool const&) = delete;
+    search_pool& operator=(search_pool const&) = delete;
+
+    ~search_pool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_work.notify_all();
+        for (auto& t : m_threads) t.join();
+    }
+
+    uint32_t num_threads() const {
+        return m_threads.size();
+    }
+
+    /* run task(i) for i = 0..num_tasks-1, returning when all are done */
+    template <typename Task>
+    void run(uint32_t num_tasks, Task& task) {
+        job j(num_tasks, &task, [](void* task, uint32_t i) {
+            (*static_cast<Task*>(task))(i);
+        });
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(&j);
+        }
+        m_work.notify_all();
+        for (uint32_t i = j.next++; i < num_tasks; i = j.next++) {
+            j.run(i);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++j.done;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [&] { return j.done == num_tasks; });
+        auto it = std::find(m_jobs.begin(), m_jobs.end(), &j);
+        if (it != m_jobs.end()) m_jobs.erase(it);
+    }
+
+private:
+    struct job {
+        job(uint32_t num_tasks, void* task, void (*call)(void*, uint32_t))
+            : num_tasks(num_tasks)
+            , task(task)
+            , call(call)
+            , next(0)
+            , done(0) {}
+
+        void run(uint32_t i) {
+            call(task, i);
+        }
+
+        uint32_t num_tasks;
+        void* task;
+        void (*call)(void*, uint32_t);
+        std::atomic<uint32_t> next;
+        uint32_t done;  // guarded by m_mutex
+    };
+
+    bool m_stop;
+    std::vector<job*> m_jobs;  // in order of posting
+    std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::condition_variable m_done;
+    std::vector<std::thread> m_threads;
+
+    void work() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_work.wait(lock, [&] { return m_stop or !m_jobs.empty(); });
+            if (m_stop) return;
+            job* j = m_jobs.front();
+            uint32_t i = j->next++;
+            if (i >= j->num_tasks) {  // all taken: the job is not ours to run
+                m_jobs.erase(m_jobs.begin());
+                continue;
+            }
+            lock.unlock();
+            j->run(i);
+            lock.lock();
+            if (++j->done == j->num_tasks) m_done.notify_all();
+        }
+    }
+};
+
+/*
+Conjunctive queries whose estimated number of candidates, i.e., of
+postings of the intersection of the prefix terms to check against the
+suffix range, is at least min_candidates are split into num_segments
+segments of doc_ids, searched by the threads of the pool.
+*/
+struct intra_query_parallelism {
+    intra_query_parallelism() {}
+
+    intra_query_parallelism(std::shared_ptr<search_pool> pool,
+                            uint32_t num_segments, uint64_t min_candidates)
+        : pool(std::move(pool))
+        , num_segments(num_segments)
+        , min_candidates(min_candidates) {}
+
+    bool enabled() const {
+        return pool != nullptr and num_segments > 1;
+    }
+
+    std::shared_ptr<search_pool> pool;
+    uint32_t num_segments = 0;
+    uint64_t min_candidates = 0;
+};
+
+/*
+Assuming that the terms of a completion are independent, as the cost
+model of autocomplete5 does, a fraction of about
+p = (suffix range width) * (avg. list size) / (num. completions)
+of the candidates contains a term of the suffix range: the intersection
+stops after min(shortest prefix list, k / p) candidates.
+A segment opens the num_lists lists of the suffix range again, so that
+queries with fewer candidates than lists are not worth splitting.
+*/
+template <typename InvertedIndex>
+bool is_heavy(InvertedIndex const& index, uint64_t min_list_size,
+              uint64_t suffix_width, uint64_t num_lists, const uint32_t k,
+              intra_query_parallelism const& parallelism) {
+    double p = std::min(1.0, double(suffix_width) * index.num_integers() /
+                                 index.num_terms() / index.num_docs());
+    double candidates = std::min<double>(min_list_size, k / p);
+    return candidates >= parallelism.min_candidates and
+           candidates >= num_lists;
+}
+
+/*
+The results of the segments of a query, sized once for num_segments
+segments of at most MAX_K results each and reused by the queries.
+*/
+struct segmented_buffers {
+    void resize(uint32_t num_segments) {
+        results.resize(uint64_t(num_segments) * constants::MAX_K);
+        sizes.resize(num_segments);
+        done.resize(num_segments);
+    }
+
+    uint32_t num_segments() const {
+        return sizes.size();
+    }
+
+    std::vector<id_type> results;
+    std::vector<uint32_t> sizes;
+    std::vector<uint8_t> done;
+};
+
+/*
+Top-k of a conjunctive query, whose doc_ids in [0,num_docs) are split
+into the segments of the buffers, searched in parallel:
+search(s, begin, end, out, stop) writes to out the first at most k
+results in [begin,end), the s-th segment, and returns their number, or
+stops early when stop() is true.
+Since the doc_ids are ranked by score, the results are the ones of the
+segments in order: the segments after the first ones with k results in
+total are stopped, or skipped if not started yet.
+*/
+template <typename Search>
+uint32_t segmented_topk(search_pool& pool, uint64_t num_docs, const uint32_t k,
+                        segmented_buffers& buffers,
+                        std::vector<id_type>& topk_scores, Search search) {
+    assert(k <= constants::MAX_K);
+    const uint32_t num_segments = buffers.num_segments();
+    auto& results = buffers.results;
+    auto& sizes = buffers.sizes;
+    auto& done = buffers.done;
+    std::fill(sizes.begin(), sizes.end(), 0);
+    std::fill(done.begin(), done.end(), false);
+    std::atomic<uint32_t> limit(num_segments);
+    std::mutex mutex;
+
+    auto task = [&](uint32_t s) {
+        if (s >= limit.load(std::memory_order_relaxed)) return;
+        id_type begin = num_docs * s / num_segments;
+        id_type end = num_docs * (s + 1) / num_segments;
+        auto stop = [&] { return s >= limit.load(std::memory_order_relaxed); };
+        uint32_t size =
+            search(s, begin, end, results.data() + uint64_t(s) * k, stop);
+        std::lock_guard<std::mutex> lock(mutex);
+        sizes[s] = size;
+        done[s] = true;
+        uint32_t total = 0;
+        for (uint32_t i = 0; i != num_segments and done[i]; ++i) {
+            total += sizes[i];
+            if (total >= k) {
+                if (i + 1 < limit) limit = i + 1;
+                break;
+            }
+        }
+    };
+    pool.run(num_segments, task);
+
+    uint32_t num_results = 0;
+    for (uint32_t s = 0; s != limit and num_results != k; ++s) {
+        uint32_t size = std::min(sizes[s], k - num_results);
+        std::copy(results.begin() + uint64_t(s) * k,
+                  results.begin() + uint64_t(s) * k + size,
+                  topk_scores.begin() + num_results);
+        num_results += size;
+    }
+    return num_results;
+}
+
+}  // namespace autocomplete
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "util_types.hpp"
+#include "scored_string_pool.hpp"
+#include "constants.hpp"
+#include "probe.hpp"
+
+namespace autocomplete {
+
+/*
+The shard of a completion, given its doc_id: with policy "range", the
+doc_ids are split into num_shards ranges of equal size, so that the
+first shard holds the best completions; with policy "hash", the shard is
+given by a hash of the doc_id, so that the shards receive the same share
+of the best completions, hence of the work of the queries.
+*/
+struct shard_partitioner {
+    shard_partitioner(std::string const& policy, uint32_t num_shards,
+                      uint64_t universe)
+        : m_hash(policy == "hash")
+        , m_num_shards(num_shards)
+        , m_universe(universe) {
+        if (policy != "range" and policy != "hash") {
+            throw std::runtime_error("unknown sharding policy '" + policy +
+                                     "': must be 'range' or 'hash'");
+        }
+        if (num_shards == 0) {
+            throw std::runtime_error("num_shards must be at least 1");
+        }
+    }
+
+    uint32_t operator()(id_type doc_id) const {
+        assert(doc_id < m_universe);
+        if (m_hash) return hash(doc_id) % m_num_shards;
+        return uint64_t(doc_id) * m_num_shards / m_universe;
+    }
+
+private:
+    bool m_hash;
+    uint32_t m_num_shards;
+    uint64_t m_universe;
+
+    /* the finalizer of MurmurHash3 */
+    static uint32_t hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x85ebca6b;
+        x ^= x >> 13;
+        x *= 0xc2b2ae35;
+        x ^= x >> 16;
+        return x;
+    }
+};
+
+/* the doc_ids written by the shard tool, one per line */
+inline std::vector<id_type> load_shard_doc_ids(std::string const& filename) {
+    std::ifstream input(filename.c_str(), std::ios_base::in);
+    if (!input.good()) {
+        throw std::runtime_error("cannot open file '" + filename + "'");
+    }
+    std::vector<id_type> doc_ids;
+    id_type doc_id;
+    while (input >> doc_id) doc_ids.push_back(doc_id);
+    return doc_ids;
+}
+
+/*
+An index partitioned into shards, each an independently built index of
+type Index over a part of the completions (see the shard tool), whose
+local doc_ids 0,1,2,... are mapped to the doc_ids of the whole
+collection by increasing doc_ids.
+
+Every query is run on all the shards in parallel, by a thread per shard,
+and the results are merged by doc_id, i.e., by score: the merge stops
+after k results. It does not wait for the shards that cannot contribute,
+i.e., whose smallest doc_id is larger than k of the results found so
+far: with the "range" policy, a query whose first shard has k results is
+answered as soon as the first shard is done.
+As an index, a sharded_autocomplete serves one query at a time.
+*/
+template <typename Index>
+struct sharded_autocomplete {
+    typedef scored_string_pool::iterator iterator_type;
+
+    sharded_autocomplete() {
+        m_pool.resize(constants::POOL_SIZE, constants::MAX_K);
+    }
+
+    sharded_autocomplete(sharded_autocomplete const&) = delete;
+    sharded_autocomplete& operator=(sharded_autocomplete const&) = delete;
+
+    ~sharded_autocomplete() {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            wait_idle(lock);
+            m_stop = true;
+        }
+        m_task.notify_all();
+        for (auto& s : m_shards) s->worker.join();
+    }
+
+    /* add the index saved in index_filename as a shard, whose i-th
+       doc_id is doc_ids[i] in the whole collection */
+    void add_shard(std::string const& index_filename,
+                   std::vector<id_type> doc_ids) {
+        if (!std::is_sorted(doc_ids.begin(), doc_ids.end())) {
+            throw std::runtime_error("the doc_ids of a shard must be sorted");
+        }
+        std::unique_ptr<shard> s(new shard());
+        essentials::load(s->index, index_filename.c_str());
+        s->doc_ids = std::move(doc_ids);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        wait_idle(lock);
+        s->worker = std::thread(&sharded_autocomplete::work, this, s.get());
+        m_shards.push_back(std::move(s));
+    }
+
+    template <typename Probe>
+    iterator_type prefix_topk(std::string const& query, const uint32_t k,
+                              Probe& probe) {
+        return topk(query_type::prefix, query, k, probe);
+    }
+
+    template <typename Probe>
+    iterator_type conjunctive_topk(std::string const& query, const uint32_t k,
+                                   Probe& probe) {
+        return topk(query_type::conjunctive, query, k, probe);
+    }
+
+    void set_normaliser(normaliser const& n) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        wait_idle(lock);
+        for (auto& s : m_shards) s->index.set_normaliser(n);
+    }
+
+    /* every shard has the budget */
+    void set_search_budget(search_budget const& budget) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        wait_idle(lock);
+        for (auto& s : m_shards) s->index.set_search_budget(budget);
+    }
+
+    size_t num_shards() const {
+        return m_shards.size();
+    }
+
+    /* must not be used while a query is running */
+    Index& shard_index(size_t i) {
+        assert(i < num_shards());
+        return m_shards[i]->index;
+    }
+
+    size_t bytes() const {
+        size_t bytes = 0;
+        for (auto const& s : m_shards) {
+            bytes += s->index.bytes() + essentials::vec_bytes(s->doc_ids);
+        }
+        return bytes;
+    }
+
+private:
+    enum class query_type { prefix, conjunctive };
+
+    struct shard {
+        Index index;
+        std::vector<id_type> doc_ids;  // in the whole collection
+        std::thread worker;
+        bool done = true;
+        iterator_type results = iterator_type(nullptr);
+    };
+
+    std::vector<std::unique_ptr<shard>> m_shards;
+    scored_string_pool m_pool;
+
+    /* the query being run by the shards */
+    std::string m_query;
+    uint32_t m_k;
+    query_type m_type;
+    uint64_t m_generation = 0;
+    uint32_t m_running = 0;
+    bool m_stop = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_task;
+    std::condition_variable m_done;
+
+    template <typename Probe>
+    iterator_type topk(query_type type, std::string const& query,
+                       const uint32_t k, Probe& probe) {
+        assert(k <= constants::MAX_K);
+        probe.start(1);
+        std::vector<shard const*> ready;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            wait_idle(lock);
+            m_query = query;
+            m_k = k;
+            m_type = type;
+            for (auto& s : m_shards) s->done = false;
+            m_running = m_shards.size();
+            ++m_generation;
+            m_task.notify_all();
+            m_done.wait(lock, [&] { return can_merge(k); });
+            for (auto const& s : m_shards) {
+                if (s->done) ready.push_back(s.get());
+            }
+        }
+        probe.stop(1);
+        probe.start(2);
+        auto it = merge(ready, k);
+        probe.stop(2);
+        return it;
+    }
+
+    void work(shard* s) {
+        nop_probe probe;
+        uint64_t generation = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_task.wait(lock,
+                        [&] { return m_stop or m_generation != generation; });
+            if (m_stop) return;
+            generation = m_generation;
+            lock.unlock();
+            /* m_query, m_k and m_type do not change until all are done */
+            auto results = m_type == query_type::prefix
+                               ? s->index.prefix_topk(m_query, m_k, probe)
+                               : s->index.conjunctive_topk(m_query, m_k, probe);
+            lock.lock();
+            s->results = results;
+            s->done = true;
+            --m_running;
+            m_done.notify_all();
+        }
+    }
+
+    void wait_idle(std::unique_lock<std::mutex>& lock) {
+        m_done.wait(lock, [&] { return m_running == 0; });
+    }
+
+    /* true if the shards still running cannot change the top-k,
+       because k results of the other shards have smaller doc_ids */
+    bool can_merge(const uint32_t k) const {
+        if (m_running == 0) return true;
+        id_type min_doc_id = id_type(-1);
+        for (auto const& s : m_shards) {
+            if (!s->done and !s->doc_ids.empty()) {
+                min_doc_id = std::min(min_doc_id, s->doc_ids.front());
+            }
+        }
+        uint32_t results = 0;
+        for (auto const& s : m_shards) {
+            if (!s->done) continue;
+            auto const& pool = *s->results.pool();
+            for (size_t i = 0; i != pool.size(); ++i) {
+                if (s->doc_ids[pool[i].score] > min_doc_id) break;
+                if (++results == k) return true;
+            }
+        }
+        return false;
+    }
+
+    iterator_type merge(std::vector<shard const*> const& ready,
+                        const uint32_t k) {
+        m_pool.clear();
+        m_pool.init();
+        auto& topk_scores = m_pool.scores();
+        std::vector<size_t> next(ready.size(), 0);
+        uint32_t results = 0;
+        while (results != k) {
+            size_t min = ready.size();
+            id_type min_doc_id = id_type(-1);
+            for (size_t i = 0; i != ready.size(); ++i) {
+                auto const& pool = *ready[i]->results.pool();
+                if (next[i] == pool.size()) continue;
+                id_type doc_id = ready[i]->doc_ids[pool[next[i]].score];
+                if (doc_id < min_doc_id) {
+                    min_doc_id = doc_id;
+                    min = i;
+                }
+            }
+            if (min == ready.size()) break;
+            auto sbr = (*ready[min]->results.pool())[next[min]++];
+            uint64_t offset = m_pool.bytes();
+            uint64_t len = sbr.string.end - sbr.string.begin;
+            memcpy(m_pool.data() + offset, sbr.string.begin, len);
+            m_pool.push_back_offset(offset + len);
+            topk_scores[results++] = min_doc_id;
+        }
+        return m_pool.begin();
+    }
+};
+
+}  // namespace autocomplete
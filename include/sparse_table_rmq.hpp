@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <type_traits>
+
+#include "util.hpp"
+
+namespace autocomplete {
+
+/*
+RMQ with a sparse table over the minima of blocks of BLOCK_SIZE values.
+A query scans the partial blocks at its two ends and looks up the sparse
+table for the full blocks in between: that is two table accesses plus
+two scans of at most BLOCK_SIZE contiguous values.
+The values are kept unpacked, so that the scans are vectorised by the
+compiler, and the table stores log2(n / BLOCK_SIZE) positions per block:
+about 32 + 32 * log2(n / BLOCK_SIZE) / BLOCK_SIZE bits per value,
+against the 2.x bits per value of cartesian_tree, which instead
+pays a sequence of select0 and excess_rmq operations per query.
+As in cartesian_tree, ties are resolved in favour of the leftmost value.
+*/
+struct sparse_table_rmq {
+    static const uint32_t BLOCK_SIZE = 64;
+
+    /* scanning a range is never faster than querying the RMQ, that scans
+       the values already */
+    static const uint32_t SCAN_THRESHOLD = 0;
+
+    sparse_table_rmq() {}
+
+    template <typename T, typename Comparator>
+    void build(std::vector<T> const& v, Comparator const&) {
+        static_assert(std::is_same<Comparator, std::less<T>>::value,
+                      "only range minimum queries are supported");
+        static_assert(std::is_unsigned<T>::value and
+                          sizeof(T) <= sizeof(id_type),
+                      "values must fit in an id_type");
+        m_values.assign(v.begin(), v.end());
+        m_levels.clear();
+        m_table.clear();
+        if (m_values.empty()) return;
+
+        uint64_t num_blocks = (m_values.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        m_table.reserve(num_blocks * (util::floor_log2(num_blocks) + 1));
+        m_levels.push_back(0);
+        for (uint64_t b = 0; b != num_blocks; ++b) {
+            uint64_t end =
+                std::min<uint64_t>((b + 1) * BLOCK_SIZE, m_values.size());
+            m_table.push_back(scan(b * BLOCK_SIZE, end - 1));
+        }
+
+        /* level l holds the minimum of the blocks [b, b + 2^l) */
+        for (uint64_t width = 2; width <= num_blocks; width *= 2) {
+            uint64_t prev = m_levels.back();
+            m_levels.push_back(m_table.size());
+            for (uint64_t b = 0; b + width <= num_blocks; ++b) {
+                m_table.push_back(leftmost_min(m_table[prev + b],
+                                               m_table[prev + b + width / 2]));
+            }
+        }
+    }
+
+    // RMQ in the interval [a, b], b inclusive
+    uint64_t rmq(uint64_t a, uint64_t b) const {
+        assert(a <= b);
+        assert(b < size());
+        uint64_t block_a = a / BLOCK_SIZE;
+        uint64_t block_b = b / BLOCK_SIZE;
+        if (block_b - block_a <= 1) return scan(a, b);
+
+        uint64_t pos = scan(a, (block_a + 1) * BLOCK_SIZE - 1);
+        pos = leftmost_min(pos, blocks_rmq(block_a + 1, block_b - 1));
+        return leftmost_min(pos, scan(block_b * BLOCK_SIZE, b));
+    }
+
+    uint64_t size() const {
+        return m_values.size();
+    }
+
+    size_t bytes() const {
+        return essentials::vec_bytes(m_values) +
+               essentials::vec_bytes(m_levels) +
+               essentials::vec_bytes(m_table);
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_values);
+        visitor.visit(m_levels);
+        visitor.visit(m_table);
+    }
+
+    void swap(sparse_table_rmq& other) {
+        other.m_values.swap(m_values);
+        other.m_levels.swap(m_levels);
+        other.m_table.swap(m_table);
+    }
+
+private:
+    std::vector<id_type> m_values;
+    std::vector<uint64_t> m_levels;  // offset of each level in m_table
+    std::vector<uint32_t> m_table;   // positions of the minima
+
+    /* positions i < j: j wins only if its value is strictly smaller */
+    uint64_t leftmost_min(uint64_t i, uint64_t j) const {
+        assert(i < j);
+        return m_values[j] < m_values[i] ? j : i;
+    }
+
+    // minimum over the blocks [a, b], b inclusive
+    uint64_t blocks_rmq(uint64_t a, uint64_t b) const {
+        assert(a <= b);
+        uint64_t l = util::floor_log2(b - a + 1);
+        uint32_t const* table = m_table.data() + m_levels[l];
+        uint64_t i = table[a];
+        uint64_t j = table[b + 1 - (uint64_t(1) << l)];
+        return i == j ? i : leftmost_min(i, j);
+    }
+
+    // the minimum is found first, to let the loop be vectorised
+    uint64_t scan(uint64_t a, uint64_t b) const {
+        id_type const* values = m_values.data();
+        id_type min = values[a];
+        for (uint64_t i = a + 1; i <= b; ++i) {
+            min = std::min(min, values[i]);
+        }
+        while (values[a] != min) ++a;
+        return a;
+    }
+};
+
+}  // namespace autocomplete
@@ -5,6 +5,7 @@
 #include "autocomplete2.hpp"
 #include "autocomplete3.hpp"
 #include "autocomplete4.hpp"
+#include "autocomplete5.hpp"
 
 namespace autocomplete {
 
@@ -41,9 +42,9 @@ void completion_trie<Nodes, Pointers, LeftExtremes, Sizes>::print_stats()
 }
 
 template <typename Completions, typename Dictionary, typename InvertedIndex,
-          typename ForwardIndex>
-void autocomplete<Completions, Dictionary, InvertedIndex,
-                  ForwardIndex>::print_stats() const {
+          typename ForwardIndex, typename RMQ, typename Strategy>
+void autocomplete<Completions, Dictionary, InvertedIndex, ForwardIndex, RMQ,
+                  Strategy>::print_stats() const {
     size_t total_bytes = bytes();
     std::cout << "using " << essentials::convert(total_bytes, essentials::MiB)
               << " [MiB]: "
@@ -84,10 +85,13 @@ void autocomplete<Completions, Dictionary, InvertedIndex,
               m_forward_index.num_integers());
     print_bpi("pointers", m_forward_index.pointer_bytes(),
               m_forward_index.num_integers());
+    print_bpi("ranks", m_forward_index.ranks_bytes(),
+              m_forward_index.num_integers());
 }
 
-template <typename Completions, typename Dictionary, typename InvertedIndex>
-void autocomplete2<Completions, Dictionary, InvertedIndex>::print_stats()
+template <typename Completions, typename Dictionary, typename InvertedIndex,
+          typename RMQ>
+void autocomplete2<Completions, Dictionary, InvertedIndex, RMQ>::print_stats()
     const {
     size_t total_bytes = bytes();
     std::cout << "using " << essentials::convert(total_bytes, essentials::MiB)
@@ -121,8 +125,9 @@ void autocomplete2<Completions, Dictionary, InvertedIndex>::print_stats()
           m_completions.size());
 }
 
-template <typename Completions, typename Dictionary, typename InvertedIndex>
-void autocomplete3<Completions, Dictionary, InvertedIndex>::print_stats()
+template <typename Completions, typename Dictionary, typename InvertedIndex,
+          typename RMQ>
+void autocomplete3<Completions, Dictionary, InvertedIndex, RMQ>::print_stats()
     const {
     size_t total_bytes = bytes();
     std::cout << "using " << essentials::convert(total_bytes, essentials::MiB)
@@ -147,9 +152,9 @@ void autocomplete3<Completions, Dictionary, InvertedIndex>::print_stats()
 }
 
 template <typename Completions, typename Dictionary,
-          typename BlockedInvertedIndex>
-void autocomplete4<Completions, Dictionary, BlockedInvertedIndex>::print_stats()
-    const {
+          typename BlockedInvertedIndex, typename RMQ>
+void autocomplete4<Completions, Dictionary, BlockedInvertedIndex,
+                   RMQ>::print_stats() const {
     size_t total_bytes = bytes();
     std::cout << "using " << essentials::convert(total_bytes, essentials::MiB)
               << " [MiB]: "
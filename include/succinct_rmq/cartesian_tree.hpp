@@ -33,6 +33,9 @@ namespace autocomplete {
 //   are slightly different from those in the paper
 
 struct cartesian_tree {
+    /* ranges up to this length are faster to scan than to query */
+    static const uint32_t SCAN_THRESHOLD = 128;
+
     template <typename T>
     struct builder {
         builder(uint64_t expected_size = 0) {
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bit_vector.hpp"
+
+namespace autocomplete {
+
+/*
+Set of doc_ids that must not be reported, e.g., for legal or abuse reasons.
+A set is immutable once built: to change it, build a new one and store it
+into the index.
+*/
+struct tombstone_set {
+    tombstone_set() {}
+
+    tombstone_set(std::vector<id_type> const& doc_ids) {
+        id_type universe = 0;
+        for (auto doc_id : doc_ids) {
+            if (doc_id + 1 > universe) universe = doc_id + 1;
+        }
+        bit_vector_builder bvb(universe);
+        for (auto doc_id : doc_ids) bvb.set(doc_id);
+        m_bits.build(&bvb);
+        m_size = doc_ids.size();
+    }
+
+    inline bool contains(const id_type doc_id) const {
+        return doc_id < m_bits.size() and m_bits[doc_id];
+    }
+
+    /* number of doc_ids in the set, counting duplicates */
+    size_t size() const {
+        return m_size;
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    size_t bytes() const {
+        return m_bits.bytes();
+    }
+
+    static tombstone_set const& empty_set() {
+        static const tombstone_set s;
+        return s;
+    }
+
+private:
+    bit_vector m_bits;
+    size_t m_size = 0;
+};
+
+/*
+The epochs of the threads reading the tombstone sets, of all the indexes.
+A reader announces, in a slot of its own, the epoch in which it started;
+synchronize() starts a new epoch and waits until no reader of an older
+epoch is left. The slots of the threads that exit are reused.
+*/
+struct reader_epochs {
+    static void enter() {
+        reader& r = local();
+        if (r.depth++ == 0) r.slot->epoch.store(current().load());
+    }
+
+    static void exit() {
+        reader& r = local();
+        if (--r.depth == 0) {
+            r.slot->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    static void synchronize() {
+        uint64_t epoch = current().fetch_add(1) + 1;
+        auto& r = readers();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto const& s : r.slots) {
+            uint64_t e;
+            while ((e = s->epoch.load()) != 0 and e < epoch) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    /* a cache line per slot, not to share lines among the readers */
+    struct alignas(64) epoch_slot {
+        std::atomic<uint64_t> epoch{0};  // 0 when not reading
+        bool used = true;
+    };
+
+    struct registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<epoch_slot>> slots;
+    };
+
+    struct reader {
+        reader() {
+            auto& r = readers();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for (auto const& s : r.slots) {
+                if (!s->used) {
+                    s->used = true;
+                    slot = s.get();
+                    return;
+                }
+            }
+            r.slots.push_back(std::make_unique<epoch_slot>());
+            slot = r.slots.back().get();
+        }
+
+        ~reader() {
+            auto& r = readers();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            slot->used = false;
+        }
+
+        epoch_slot* slot;
+        uint32_t depth = 0;  // snapshots held by the thread
+    };
+
+    static std::atomic<uint64_t>& current() {
+        static std::atomic<uint64_t> epoch(1);
+        return epoch;
+    }
+
+    static registry& readers() {
+        static registry r;
+        return r;
+    }
+
+    static reader& local() {
+        static thread_local reader r;
+        return r;
+    }
+};
+
+/*
+The tombstone set in use by an index. Queries take a snapshot of the
+current set, so that a set can be atomically replaced while queries are
+running.
+The set is published through an atomic pointer: a snapshot only writes
+the slot of its thread in reader_epochs, instead of taking the lock of
+std::atomic_load on a shared_ptr. A store swaps the pointer, then waits
+for the snapshots taken before the swap to be released and releases the
+old set (RCU-style): a thread holding a snapshot must not store a set.
+*/
+struct tombstones {
+    struct snapshot {
+        explicit snapshot(tombstone_set const* set)
+            : m_set(set) {}
+
+        snapshot(snapshot const&) = delete;
+        snapshot& operator=(snapshot const&) = delete;
+
+        ~snapshot() {
+            reader_epochs::exit();
+        }
+
+        tombstone_set const& operator*() const {
+            return *m_set;
+        }
+
+        tombstone_set const* operator->() const {
+            return m_set;
+        }
+
+    private:
+        tombstone_set const* m_set;
+    };
+
+    tombstones()
+        : m_owner(std::make_shared<const tombstone_set>())
+        , m_set(m_owner.get()) {}
+
+    snapshot load() const {
+        reader_epochs::enter();
+        return snapshot(m_set.load());
+    }
+
+    void store(std::shared_ptr<const tombstone_set> set) {
+        assert(set);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_set.store(set.get());
+        reader_epochs::synchronize();
+        m_owner.swap(set);  // the old set is released with set
+    }
+
+private:
+    std::mutex m_mutex;  // serializes the stores
+    std::shared_ptr<const tombstone_set> m_owner;
+    std::atomic<tombstone_set const*> m_set;
+};
+
+}  // namespace autocomplete
@@ -10,7 +10,9 @@
 #include "autocomplete2.hpp"
 #include "autocomplete3.hpp"
 #include "autocomplete4.hpp"
+#include "autocomplete5.hpp"
 #include "compact_vector.hpp"
+#include "sparse_table_rmq.hpp"
 #include "ef/ef_sequence.hpp"
 #include "ef/compact_ef.hpp"
 
@@ -22,6 +24,9 @@ typedef uint_vec<uint64_t> uint64_vec;
 typedef completion_trie<ef::ef_sequence, ef::ef_sequence, ef::ef_sequence,
                         ef::ef_sequence>
     ef_completion_trie;
+typedef completion_trie<interleaved_nodes, interleaved_pointers,
+                        ef::ef_sequence, ef::ef_sequence>
+    interleaved_completion_trie;
 typedef fc_dictionary<> fc_dictionary_type;
 typedef integer_fc_dictionary<> integer_fc_dictionary_type;
 typedef inverted_index<ef::compact_ef> ef_inverted_index;
@@ -44,4 +49,30 @@ typedef autocomplete4<integer_fc_dictionary_type, fc_dictionary_type,
                       ef_blocked_inverted_index>
     ef_autocomplete_type4;
 
+typedef autocomplete5<ef_completion_trie, fc_dictionary_type, ef_inverted_index,
+                      compact_forward_index>
+    ef_autocomplete_type5;
+
+/* the same indexes, with sparse_table_rmq in place of cartesian_tree:
+   larger, but faster to answer the top-k queries over ranges */
+typedef autocomplete<ef_completion_trie, fc_dictionary_type, ef_inverted_index,
+                     compact_forward_index, sparse_table_rmq>
+    ef_autocomplete_type1_st;
+
+typedef autocomplete2<integer_fc_dictionary_type, fc_dictionary_type,
+                      ef_inverted_index, sparse_table_rmq>
+    ef_autocomplete_type2_st;
+
+typedef autocomplete3<integer_fc_dictionary_type, fc_dictionary_type,
+                      ef_inverted_index, sparse_table_rmq>
+    ef_autocomplete_type3_st;
+
+typedef autocomplete4<integer_fc_dictionary_type, fc_dictionary_type,
+                      ef_blocked_inverted_index, sparse_table_rmq>
+    ef_autocomplete_type4_st;
+
+typedef autocomplete5<ef_completion_trie, fc_dictionary_type, ef_inverted_index,
+                      compact_forward_index, sparse_table_rmq>
+    ef_autocomplete_type5_st;
+
 }  // namespace autocomplete
\ No newline at end of file
@@ -73,6 +73,10 @@ struct uint_vec {
         return m_data[i];
     }
 
+    inline void prefetch(uint64_t i) const {
+        if (i < size()) util::prefetch(m_data.data() + i);
+    }
+
     uint64_t find(const range r, UintType id) const {
         assert(r.is_valid());
         assert(r.end <= size());
@@ -2,14 +2,27 @@
 
 #include "compact_vector.hpp"
 #include "util_types.hpp"
+#include "min_heap.hpp"
+#include "tombstones.hpp"
+#include "constants.hpp"
 
 namespace autocomplete {
 
 template <typename RMQ>
 struct unsorted_list {
-    static const uint32_t SCAN_THRESHOLD = 64;
+    static const uint32_t SCAN_THRESHOLD = RMQ::SCAN_THRESHOLD;
+    typedef min_heap<scored_range, scored_range_comparator> topk_queue_type;
 
-    unsorted_list() {}
+    unsorted_list() {
+        reserve(m_q);
+    }
+
+    /* one range is popped and at most two are pushed per value visited:
+       the deleted values are visited without being reported, so the queue
+       holds at most k + 1 + (num. deleted) ranges */
+    static void reserve(topk_queue_type& q, size_t num_deleted = 0) {
+        q.reserve(constants::MAX_K + 1 + num_deleted);
+    }
 
     void build(std::vector<id_type> const& list) {
         essentials::logger("building unsorted_list...");
@@ -19,15 +32,25 @@ struct unsorted_list {
     }
 
     uint32_t topk(const range r, const uint32_t k, std::vector<id_type>& topk,
-                  bool unique = false  // return unique results
-    ) {
+                  bool unique = false,  // return unique results
+                  tombstone_set const& deleted = tombstone_set::empty_set()) {
+        return this->topk(r, k, topk, m_q, unique, deleted);
+    }
+
+    /* the queue q is scratch memory, so that threads can share the list */
+    uint32_t topk(const range r, const uint32_t k, std::vector<id_type>& topk,
+                  topk_queue_type& q, bool unique = false,
+                  tombstone_set const& deleted =
+                      tombstone_set::empty_set()) const {
         uint32_t range_len = r.end - r.begin;
         if (range_len <= k) {  // report everything in range
+            m_list.decode(r.begin, range_len, topk.data());
+            uint32_t results = 0;
             for (uint32_t i = 0; i != range_len; ++i) {
-                topk[i] = m_list.access(r.begin + i);
+                if (!deleted.contains(topk[i])) topk[results++] = topk[i];
             }
-            std::sort(topk.begin(), topk.begin() + range_len);
-            return range_len;
+            std::sort(topk.begin(), topk.begin() + results);
+            return results;
         }
 
         scored_range sr;
@@ -35,44 +58,53 @@ struct unsorted_list {
         sr.min_pos = m_rmq.rmq(sr.r.begin, sr.r.end);
         sr.min_val = m_list.access(sr.min_pos);
 
-        m_q.clear();
-        m_q.push(sr);
+        // NOTE: allocates only for a larger set of deleted values
+        reserve(q, deleted.size());
+        q.clear();
+        q.push(sr);
 
         uint32_t i = 0;
-        while (!m_q.empty()) {
-            scored_range min = m_q.top();
-
-            if (!unique or
-                (unique and !std::binary_search(topk.begin(), topk.begin() + i,
-                                                min.min_val))) {
+        while (!q.empty()) {
+            scored_range min = q.top();
+
+            // NOTE: deleted values are not reported but their range is
+            // split as usual, so we keep going until k live values are found
+            if (!deleted.contains(min.min_val) and
+                (!unique or
+                 (unique and !std::binary_search(topk.begin(),
+                                                 topk.begin() + i,
+                                                 min.min_val)))) {
                 topk[i++] = min.min_val;
                 if (i == k) break;
             }
 
-            m_q.pop();
-
+            /* the left range, if any, replaces the minimum in place */
             if (min.min_pos > 0 and min.min_pos - 1 >= min.r.begin) {
                 scored_range left;
                 left.r = {min.r.begin, min.min_pos - 1};
                 if (left.r.end - left.r.begin <= SCAN_THRESHOLD) {
-                    left.min_pos = rmq(left.r.begin, left.r.end);
+                    left.min_pos = util::scan_rmq<SCAN_THRESHOLD>(
+                        m_list, left.r.begin, left.r.end);
                 } else {
                     left.min_pos = m_rmq.rmq(left.r.begin, left.r.end);
                 }
                 left.min_val = m_list.access(left.min_pos);
-                m_q.push(left);
+                q.replace_top(left);
+            } else {
+                q.pop();
             }
 
             if (min.min_pos < size() - 1 and min.r.end >= min.min_pos + 1) {
                 scored_range right;
                 right.r = {min.min_pos + 1, min.r.end};
                 if (right.r.end - right.r.begin <= SCAN_THRESHOLD) {
-                    right.min_pos = rmq(right.r.begin, right.r.end);
+                    right.min_pos = util::scan_rmq<SCAN_THRESHOLD>(
+                        m_list, right.r.begin, right.r.end);
                 } else {
                     right.min_pos = m_rmq.rmq(right.r.begin, right.r.end);
                 }
                 right.min_val = m_list.access(right.min_pos);
-                m_q.push(right);
+                q.push(right);
             }
         }
 
@@ -94,56 +126,9 @@ struct unsorted_list {
     }
 
 private:
-    struct topk_queue {
-        void push(scored_range sr) {
-            m_q.push_back(sr);
-            std::push_heap(m_q.begin(), m_q.end(), m_comparator);
-        }
-
-        scored_range top() {
-            return m_q.front();
-        }
-
-        void pop() {
-            std::pop_heap(m_q.begin(), m_q.end(), m_comparator);
-            m_q.pop_back();
-        }
-
-        void clear() {
-            m_q.clear();
-        }
-
-        bool empty() const {
-            return m_q.empty();
-        }
-
-    private:
-        std::vector<scored_range> m_q;
-
-        typedef std::function<bool(scored_range const&, scored_range const&)>
-            scrored_range_comparator_type;
-        scrored_range_comparator_type m_comparator = [](scored_range const& l,
-                                                        scored_range const& r) {
-            return scored_range::greater(l, r);
-        };
-    };
-
-    topk_queue m_q;
+    topk_queue_type m_q;
     RMQ m_rmq;
     compact_vector m_list;
-
-    uint64_t rmq(uint64_t lo, uint64_t hi) {  // inclusive endpoints
-        uint64_t pos = lo;
-        id_type min = id_type(-1);
-        for (uint64_t i = lo; i <= hi; ++i) {
-            id_type val = m_list.access(i);
-            if (val < min) {
-                min = val;
-                pos = i;
-            }
-        }
-        return pos;
-    }
 };
 
 }  // namespace autocomplete
\ No newline at end of file
@@ -4,14 +4,21 @@
 
 #include <string.h>
 #include <sys/time.h>
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <ctime>
 #include <iostream>
 #include <locale>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <smmintrin.h>
 #include <xmmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #include "../external/essentials/include/essentials.hpp"
 
@@ -92,6 +99,34 @@ uint64_t next_geq(S const& sequence, uint64_t lower_bound, uint64_t lo,
     return global::not_found;
 }
 
+/* position of the minimum of sequence[lo..hi], inclusive endpoints, by
+   a linear scan of at most MaxLength + 1 values: these are decoded in
+   bulk, unless they are too few for it to pay off */
+template <uint32_t MaxLength, typename S>
+uint64_t scan_rmq(S const& sequence, uint64_t lo, uint64_t hi) {
+    assert(hi - lo <= MaxLength);
+    uint64_t n = hi - lo + 1;
+    if (n < 32) {  // not worth decoding the values in bulk
+        uint64_t pos = lo;
+        id_type min = id_type(-1);
+        for (uint64_t i = lo; i <= hi; ++i) {
+            id_type val = sequence.access(i);
+            if (val < min) {
+                min = val;
+                pos = i;
+            }
+        }
+        return pos;
+    }
+    id_type values[MaxLength + 1];
+    sequence.decode(lo, n, values);
+    id_type min = values[0];
+    for (uint64_t i = 1; i != n; ++i) min = std::min(min, values[i]);
+    uint64_t pos = 0;
+    while (values[pos] != min) ++pos;
+    return lo + pos;
+}
+
 }  // namespace util
 
 namespace tables {
@@ -345,6 +380,53 @@ inline IntType1 ceil_div(IntType1 dividend, IntType2 divisor) {
     IntType1 d = IntType1(divisor);
     return IntType1(dividend + d - 1) / d;
 }
+
+template <uint64_t Width>
+constexpr uint64_t width_mask() {
+    return Width == 64 ? uint64_t(-1) : (uint64_t(1) << Width) - 1;
+}
+
+/* the Width bits of data starting at bit pos */
+template <uint64_t Width>
+inline uint64_t get_bits(uint64_t const* data, uint64_t pos) {
+    static_assert(Width > 0 and Width <= 64, "invalid width");
+    uint64_t block = pos >> 6;
+    uint64_t shift = pos & 63;
+    return shift + Width <= 64
+               ? data[block] >> shift & width_mask<Width>()
+               : (data[block] >> shift) |
+                     (data[block + 1] << (64 - shift) & width_mask<Width>());
+}
+
+namespace detail {
+template <uint64_t Width, typename F>
+decltype(auto) call_with_width(F& f) {
+    return f(std::integral_constant<uint64_t, Width>());
+}
+
+template <typename F, uint64_t... Width>
+constexpr auto width_table(std::index_sequence<Width...>) {
+    typedef decltype(call_with_width<1>(std::declval<F&>())) result_type;
+    // width 0 is not valid
+    return std::array<result_type (*)(F&), sizeof...(Width)>{
+        {&call_with_width<Width ? Width : 1, F>...}};
+}
+}  // namespace detail
+
+/*
+Call f(std::integral_constant<uint64_t, width>()), where width is in
+[1, 64]: f is compiled for every width, so that the bit-packed accesses
+in its loops use constant shifts and masks, and the instance of f is
+taken from a table indexed by width.
+Dispatch once per loop, not once per access.
+*/
+template <typename F>
+decltype(auto) with_width(uint64_t width, F&& f) {
+    assert(width > 0 and width <= 64);
+    static constexpr auto table = detail::width_table<std::decay_t<F>>(
+        std::make_index_sequence<65>());
+    return table[width](f);
+}
 }  // namespace util
 
 }  // namespace autocomplete
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <functional>
 #include <chrono>
 
@@ -58,6 +59,16 @@ bool range::contains(uint64_t val) const {
     return false;
 }
 
+/* sorted list of disjoint ranges */
+struct range_list : std::vector<range> {
+    bool contains(uint64_t val) const {
+        auto it = std::upper_bound(
+            begin(), end(), val,
+            [](uint64_t val, range const& r) { return val < r.begin; });
+        return it != begin() and (it - 1)->contains(val);
+    }
+};
+
 struct scored_range {
     range r;
     uint32_t min_pos;
@@ -68,6 +79,12 @@ struct scored_range {
     }
 };
 
+struct scored_range_comparator {
+    bool operator()(scored_range const& l, scored_range const& r) const {
+        return scored_range::greater(l, r);
+    }
+};
+
 template <typename Iterator>
 struct scored_range_with_list_iterator {
     typedef Iterator iterator_type;
@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# Split a collection into shards and build an index per shard, each in
+# its own process, to be served by sharded_autocomplete.
+# From within the build directory, e.g.:
+# bash ../script/build_shards.sh ef_type1 ../test_data/trec_05_efficiency_queries/trec_05_efficiency_queries.completions 4 trec05 range
+
+type=$1            # index type, as given to ./build
+collection=$2      # .completions file
+num_shards=$3
+output_basename=$4 # the shards are <output_basename>.<i>.{completions,ids,bin}
+policy=${5:-range}
+
+./shard $collection $num_shards $output_basename -p $policy || exit 1
+
+test_data=$(cd $(dirname $0)/../test_data && pwd)
+for ((i = 0; i < num_shards; i++)); do
+    (
+        set -e
+        shard=$(realpath $output_basename.$i.completions)
+        cd $test_data
+        python extract_dict.py $shard
+        python map_dataset.py $shard
+        python build_stats.py $shard.mapped
+        python build_inverted_and_forward.py $shard
+        cd - > /dev/null
+        ./build $type $shard -o $output_basename.$i.bin -c 0.0001
+    ) > $output_basename.$i.log 2>&1 &
+    pids[$i]=$!
+done
+status=0
+for ((i = 0; i < num_shards; i++)); do
+    if ! wait ${pids[$i]}; then
+        echo "shard $i failed: see $output_basename.$i.log"
+        status=1
+    fi
+done
+exit $status
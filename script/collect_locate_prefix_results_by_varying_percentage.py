@@ -1,6 +1,6 @@
 import sys, os
 
-type = sys.argv[1] # 'trie' or 'fc'
+type = sys.argv[1] # 'trie', 'interleaved_trie' or 'fc'
 collection_basename = sys.argv[2]
 num_queries = sys.argv[3]
 
@@ -17,13 +17,14 @@ void build(parameters const& params, std::string const& output_filename) {
     }
 }
 
+template <typename Index>
 void build_type4(parameters const& params, const float c,
                  std::string const& output_filename) {
-    ef_autocomplete_type4 index(params, c);
+    Index index(params, c);
     index.print_stats();
     if (output_filename != "") {
         essentials::logger("saving data structure to disk...");
-        essentials::save<ef_autocomplete_type4>(index, output_filename.c_str());
+        essentials::save<Index>(index, output_filename.c_str());
         essentials::logger("DONE");
     }
 }
@@ -53,7 +54,20 @@ int main(int argc, char** argv) {
         build<ef_autocomplete_type3>(params, output_filename);
     } else if (type == "ef_type4") {
         auto c = parser.get<float>("c");
-        build_type4(params, c, output_filename);
+        build_type4<ef_autocomplete_type4>(params, c, output_filename);
+    } else if (type == "ef_type5") {
+        build<ef_autocomplete_type5>(params, output_filename);
+    } else if (type == "ef_type1_st") {
+        build<ef_autocomplete_type1_st>(params, output_filename);
+    } else if (type == "ef_type2_st") {
+        build<ef_autocomplete_type2_st>(params, output_filename);
+    } else if (type == "ef_type3_st") {
+        build<ef_autocomplete_type3_st>(params, output_filename);
+    } else if (type == "ef_type4_st") {
+        auto c = parser.get<float>("c");
+        build_type4<ef_autocomplete_type4_st>(params, c, output_filename);
+    } else if (type == "ef_type5_st") {
+        build<ef_autocomplete_type5_st>(params, output_filename);
     } else {
         return 1;
     }
@@ -56,6 +56,9 @@ int main(int argc, char** argv) {
     } else if (type == "ef_type4") {
         check_topk<ef_autocomplete_type4>(binary_filename1, binary_filename2, k,
                                           max_num_queries, keep);
+    } else if (type == "ef_type5") {
+        check_topk<ef_autocomplete_type5>(binary_filename1, binary_filename2, k,
+                                          max_num_queries, keep);
     } else {
         return 1;
     }
@@ -0,0 +1,59 @@
+#include <iostream>
+
+#include "types.hpp"
+#include "delta_index.hpp"
+#include "../external/cmd_line_parser/include/parser.hpp"
+
+using namespace autocomplete;
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("collection_filename",
+               "Collection filename, i.e., the .completions file the static "
+               "index was built from.");
+    parser.add("delta_filename",
+               "File with the inserted completions, one 'doc_id completion' "
+               "per line.");
+    parser.add("output_filename",
+               "Output collection filename: pre-process it and build the new "
+               "static index from it.");
+    parser.add("separators",
+               "Characters separating the terms, besides whitespace, as "
+               "given to the normalise tool.",
+               "-s", false);
+    if (!parser.parse()) return 1;
+
+    auto collection_filename = parser.get<std::string>("collection_filename");
+    auto delta_filename = parser.get<std::string>("delta_filename");
+    auto output_filename = parser.get<std::string>("output_filename");
+
+    delta_index delta;
+    if (parser.parsed("separators")) {
+        delta.set_normaliser(
+            normaliser(parser.get<std::string>("separators")));
+    }
+    {
+        std::ifstream input(delta_filename.c_str(), std::ios_base::in);
+        if (!input.good()) {
+            std::cerr << "cannot open file '" << delta_filename << "'"
+                      << std::endl;
+            return 1;
+        }
+        delta.load(input);
+        essentials::logger("loaded " + std::to_string(delta.size()) +
+                           " completions to fold");
+    }
+
+    std::ifstream collection(collection_filename.c_str(), std::ios_base::in);
+    if (!collection.good()) {
+        std::cerr << "cannot open file '" << collection_filename << "'"
+                  << std::endl;
+        return 1;
+    }
+    std::ofstream output(output_filename.c_str(), std::ios_base::out);
+    essentials::logger("folding...");
+    delta.fold(collection, output);
+    essentials::logger("DONE");
+
+    return 0;
+}
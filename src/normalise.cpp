@@ -0,0 +1,82 @@
+#include <iostream>
+
+#include "types.hpp"
+#include "../external/cmd_line_parser/include/parser.hpp"
+
+using namespace autocomplete;
+
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("collection_filename",
+               "Collection filename, one 'doc_id completion' per line.");
+    parser.add("output_filename",
+               "Output collection filename: pre-process it and build the "
+               "index from it.");
+    parser.add("separators",
+               "Characters separating the terms, besides whitespace: the "
+               "index must be given the same ones.",
+               "-s", false);
+    if (!parser.parse()) return 1;
+
+    auto collection_filename = parser.get<std::string>("collection_filename");
+    auto output_filename = parser.get<std::string>("output_filename");
+    std::string separators;
+    if (parser.parsed("separators")) {
+        separators = parser.get<std::string>("separators");
+    }
+
+    std::ifstream input(collection_filename.c_str(), std::ios_base::in);
+    if (!input.good()) {
+        std::cerr << "cannot open file '" << collection_filename << "'"
+                  << std::endl;
+        return 1;
+    }
+
+    essentials::logger("normalising...");
+    normaliser normalise(separators);
+    std::vector<std::pair<std::string, id_type>> completions;
+    uint64_t skipped = 0;
+    std::string line;
+    while (std::getline(input, line)) {
+        size_t pos = line.find(' ');
+        if (pos == std::string::npos) continue;
+        byte_range in = string_to_byte_range(line);
+        in.begin += pos + 1;
+        if (in.end - in.begin > normaliser::BUFFER_SIZE) {
+            ++skipped;
+            continue;
+        }
+        byte_range out = normalise(in);
+        /* drop the leading and trailing separators */
+        if (out.begin != out.end and *out.begin == ' ') ++out.begin;
+        if (out.begin != out.end and *(out.end - 1) == ' ') --out.end;
+        if (out.begin == out.end) {
+            ++skipped;
+            continue;
+        }
+        completions.emplace_back(std::string(out.begin, out.end),
+                                 std::stoul(line.substr(0, pos)));
+    }
+    input.close();
+
+    /* completions that become equal keep the best score */
+    essentials::logger("sorting...");
+    std::sort(completions.begin(), completions.end());
+    auto end = std::unique(
+        completions.begin(), completions.end(),
+        [](auto const& l, auto const& r) { return l.first == r.first; });
+    uint64_t merged = std::distance(end, completions.end());
+    completions.erase(end, completions.end());
+
+    std::ofstream output(output_filename.c_str(), std::ios_base::out);
+    for (auto const& c : completions) {
+        output << c.second << ' ' << c.first << '\n';
+    }
+    output.close();
+    essentials::logger("written " + std::to_string(completions.size()) +
+                       " completions (" + std::to_string(merged) +
+                       " merged, " + std::to_string(skipped) + " skipped)");
+    essentials::logger("DONE");
+
+    return 0;
+}
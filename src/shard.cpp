@@ -0,0 +1,98 @@
+#include <iostream>
+
+#include "types.hpp"
+#include "sharded_autocomplete.hpp"
+#include "../external/cmd_line_parser/include/parser.hpp"
+
+using namespace autocomplete;
+
+/*
+Split a collection into shards, written as the collections
+<output_basename>.<i>.completions, for i = 0..num_shards-1, to be
+pre-processed and indexed independently (see script/build_shards.sh).
+The completions of a shard keep their lexicographic order and their
+doc_ids are re-assigned as 0,1,2,... by increasing doc_id: the doc_id
+in the whole collection of each doc_id of the shard is written, one per
+line, to <output_basename>.<i>.ids.
+*/
+int main(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("collection_filename", "Collection filename.");
+    parser.add("num_shards", "Number of shards.");
+    parser.add("output_basename", "Output basename of the shards.");
+    parser.add("policy",
+               "Sharding policy: 'range' (default) for ranges of doc_ids, "
+               "'hash' for a hash of the doc_ids.",
+               "-p", false);
+    if (!parser.parse()) return 1;
+
+    auto collection_filename = parser.get<std::string>("collection_filename");
+    auto num_shards = parser.get<uint32_t>("num_shards");
+    auto output_basename = parser.get<std::string>("output_basename");
+    std::string policy = "range";
+    if (parser.parsed("policy")) policy = parser.get<std::string>("policy");
+
+    std::vector<id_type> doc_ids;
+    {
+        std::ifstream input(collection_filename.c_str(), std::ios_base::in);
+        if (!input.good()) {
+            std::cerr << "cannot open file '" << collection_filename << "'"
+                      << std::endl;
+            return 1;
+        }
+        std::string line;
+        while (std::getline(input, line)) {
+            doc_ids.push_back(std::stoul(line));
+        }
+    }
+    if (doc_ids.empty()) {
+        std::cerr << "the collection is empty" << std::endl;
+        return 1;
+    }
+    uint64_t universe = *std::max_element(doc_ids.begin(), doc_ids.end()) + 1;
+    shard_partitioner partitioner(policy, num_shards, universe);
+
+    std::vector<std::vector<id_type>> shard_doc_ids(num_shards);
+    for (auto doc_id : doc_ids) {
+        shard_doc_ids[partitioner(doc_id)].push_back(doc_id);
+    }
+    for (uint32_t i = 0; i != num_shards; ++i) {
+        auto& ids = shard_doc_ids[i];
+        if (ids.empty()) {
+            std::cerr << "shard " << i << " is empty: use fewer shards"
+                      << std::endl;
+            return 1;
+        }
+        std::sort(ids.begin(), ids.end());
+        std::ofstream output(
+            (output_basename + "." + std::to_string(i) + ".ids").c_str(),
+            std::ios_base::out);
+        for (auto doc_id : ids) output << doc_id << '\n';
+        essentials::logger("shard " + std::to_string(i) + ": " +
+                           std::to_string(ids.size()) + " completions");
+    }
+
+    std::ifstream input(collection_filename.c_str(), std::ios_base::in);
+    std::vector<std::ofstream> outputs;
+    for (uint32_t i = 0; i != num_shards; ++i) {
+        outputs.emplace_back(
+            (output_basename + "." + std::to_string(i) + ".completions")
+                .c_str(),
+            std::ios_base::out);
+    }
+    std::string line;
+    while (std::getline(input, line)) {
+        size_t pos = line.find(' ');
+        id_type doc_id = std::stoul(line);
+        uint32_t i = partitioner(doc_id);
+        auto const& ids = shard_doc_ids[i];
+        id_type local_doc_id =
+            std::lower_bound(ids.begin(), ids.end(), doc_id) - ids.begin();
+        outputs[i] << local_doc_id
+                   << (pos == std::string::npos ? "" : line.substr(pos))
+                   << '\n';
+    }
+    essentials::logger("DONE");
+
+    return 0;
+}
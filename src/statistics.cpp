@@ -30,6 +30,18 @@ int main(int argc, char** argv) {
         print_stats<ef_autocomplete_type3>(index_filename);
     } else if (type == "ef_type4") {
         print_stats<ef_autocomplete_type4>(index_filename);
+    } else if (type == "ef_type5") {
+        print_stats<ef_autocomplete_type5>(index_filename);
+    } else if (type == "ef_type1_st") {
+        print_stats<ef_autocomplete_type1_st>(index_filename);
+    } else if (type == "ef_type2_st") {
+        print_stats<ef_autocomplete_type2_st>(index_filename);
+    } else if (type == "ef_type3_st") {
+        print_stats<ef_autocomplete_type3_st>(index_filename);
+    } else if (type == "ef_type4_st") {
+        print_stats<ef_autocomplete_type4_st>(index_filename);
+    } else if (type == "ef_type5_st") {
+        print_stats<ef_autocomplete_type5_st>(index_filename);
     } else {
         return 1;
     }
@@ -1,116 +1,484 @@
 #include <iostream>
 #include <string>
-#include <sstream>
-#include <iomanip>
+#include <atomic>
+#include <csignal>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
 
 #include "constants.hpp"
 #include "types.hpp"
 #include "probe.hpp"
+#include "huge_pages.hpp"
+#include "rpc_protocol.hpp"
+#include "metrics.hpp"
+#include "numa.hpp"
 
 #include "../external/mongoose/mongoose.h"
 
-// -- Helper function to escape output
-// http://stackoverflow.com/questions/7724448/simple-json-string-escape-for-c/33799784#33799784
-std::string escape_json(std::string const& s) {
-    std::ostringstream o;
-    for (auto c = s.cbegin(); c != s.cend(); c++) {
-        if (*c == '"' || *c == '\\' || ('\x00' <= *c && *c <= '\x1f')) {
-            o << "\\u" << std::hex << std::setw(4) << std::setfill('0')
-              << (int)*c;
+using namespace autocomplete;
+
+/* JSON escaping of the string s into a buffer that has room for 6 bytes
+   per input byte: return the end of the output */
+char* escape_json(byte_range s, char* out) {
+    static const char* hex = "0123456789abcdef";
+    for (auto c = s.begin; c != s.end; ++c) {
+        if (*c == '"' || *c == '\\' || *c <= 0x1f) {
+            memcpy(out, "\\u00", 4);
+            out[4] = hex[*c >> 4];
+            out[5] = hex[*c & 0xf];
+            out += 6;
         } else {
-            o << *c;
+            *out++ = *c;
         }
     }
-    return o.str();
+    return out;
 }
-// --
 
-using namespace autocomplete;
+std::string escape_json(std::string const& s) {
+    std::string escaped(6 * s.size(), '\0');
+    uint8_t const* begin = reinterpret_cast<uint8_t const*>(s.data());
+    char* end = escape_json({begin, begin + s.size()}, &escaped[0]);
+    escaped.resize(end - escaped.data());
+    return escaped;
+}
+
+char* append(char const* s, char* out) {
+    size_t len = strlen(s);
+    memcpy(out, s, len);
+    return out + len;
+}
 
 typedef ef_autocomplete_type1 topk_index_type;
 
 static std::string s_http_port("8000");
 static struct mg_serve_http_opts s_http_server_opts;
-static topk_index_type topk_index;
+
+/* /topcomp requests are answered without allocating: the query and the
+   response are written into buffers that are reused by every request
+   of the thread */
+static thread_local std::string s_query;
+static thread_local char
+    s_response[6 * constants::POOL_SIZE + 64 * constants::MAX_K];
+
+/* the binary protocol of rpc_protocol.hpp is served on a port of its own:
+   the responses to the requests received are written into s_rpc_response,
+   reused as well */
+static std::string s_rpc_port;
+static thread_local std::string s_rpc_response;
+
+/*
+The index in use can be replaced without downtime: a new index is loaded
+by a background thread and published with an atomic store. Each request
+takes its own reference to the index, so the old index is released as
+soon as no request is using it any longer.
+A reload is triggered by SIGHUP or by the admin endpoint /admin/reload.
+
+In NUMA mode, the requests are served by threads_per_node threads on
+every NUMA node, each running its own event loop on the same ports, and
+there is a replica of the index per node, loaded by a thread bound to the
+node and shared by the threads of the node: every thread queries it with
+a query context of its own (see numa.hpp).
+Otherwise, a single thread serves the requests with a single index.
+*/
+static std::vector<std::shared_ptr<topk_index_type>> s_replicas;
+static thread_local uint32_t s_node = 0;  // the replica of the thread
+static thread_local topk_index_type::query_context s_context;
+static numa_topology s_numa;
+static uint32_t s_threads_per_node = 0;  // 0: NUMA mode off
+/* in NUMA mode, admin requests are served by several threads at once */
+static std::mutex s_index_filename_mutex;
+static std::string s_index_filename;
+static std::string s_blocklist_filename;
+static search_budget s_budget;
+static std::atomic<bool> s_reloading(false);
+static volatile std::sig_atomic_t s_reload_requested = 0;
+
+static void on_sighup(int) {
+    s_reload_requested = 1;
+}
+
+static double to_MiB(size_t bytes) {
+    return static_cast<double>(bytes) / essentials::MiB;
+}
+
+/* blocklist format: the doc_ids to suppress, separated by white spaces */
+static std::shared_ptr<const tombstone_set> load_blocklist(
+    std::string const& blocklist_filename) {
+    std::vector<id_type> doc_ids;
+    if (blocklist_filename != "") {
+        std::ifstream input(blocklist_filename.c_str(), std::ios_base::in);
+        if (!input.good()) {
+            throw std::runtime_error("cannot open file '" +
+                                     blocklist_filename + "'");
+        }
+        id_type doc_id;
+        while (input >> doc_id) doc_ids.push_back(doc_id);
+    }
+    return std::make_shared<const tombstone_set>(doc_ids);
+}
+
+/* the arrays of the index are backed by huge pages, if the kernel
+   allows it, to reduce the dTLB misses of the queries */
+static void load_index(topk_index_type& index, std::string const& filename) {
+    essentials::load(index, filename.c_str());
+    auto advisor = use_huge_pages(index);
+    essentials::logger(std::to_string(to_MiB(advisor.advised_bytes())) +
+                       " MiB of the index advised for huge pages, " +
+                       std::to_string(to_MiB(advisor.collapsed_bytes())) +
+                       " MiB backed by huge pages");
+}
+
+static std::shared_ptr<topk_index_type> current_index() {
+    return std::atomic_load(&s_replicas[s_node]);
+}
+
+/* in NUMA mode, a replica per node, loaded by a thread bound to the node */
+static std::vector<std::shared_ptr<topk_index_type>> load_replicas(
+    std::string const& filename, std::string const& blocklist_filename) {
+    auto deleted = load_blocklist(blocklist_filename);
+    uint32_t num_replicas = s_threads_per_node ? s_numa.num_nodes() : 1;
+    std::vector<std::shared_ptr<topk_index_type>> replicas(num_replicas);
+    std::vector<std::exception_ptr> errors(num_replicas);
+    auto load = [&](uint32_t node) {
+        try {
+            auto index = std::make_shared<topk_index_type>();
+            load_index(*index, filename);
+            index->set_tombstones(deleted);
+            index->set_search_budget(s_budget);
+            replicas[node] = std::move(index);
+        } catch (...) {
+            errors[node] = std::current_exception();
+        }
+    };
+    if (s_threads_per_node) {
+        s_numa.for_each_node(load);
+    } else {
+        load(0);
+    }
+    for (auto const& e : errors) {
+        if (e) std::rethrow_exception(e);
+    }
+    return replicas;
+}
+
+static void reload(std::string const index_filename,
+                   std::string const blocklist_filename) {
+    essentials::logger("loading index from '" + index_filename + "'...");
+    try {
+        auto replicas = load_replicas(index_filename, blocklist_filename);
+        size_t index_bytes = replicas.front()->bytes();
+        for (size_t i = 0; i != replicas.size(); ++i) {
+            std::atomic_store(&s_replicas[i], std::move(replicas[i]));
+        }
+        /* both indexes are resident until the swap, hence the peak */
+        essentials::logger(
+            "index swapped: " + std::to_string(to_MiB(index_bytes)) +
+            " MiB for the new index, times " +
+            std::to_string(s_replicas.size()) +
+            " replicas; peak RSS during the swap " +
+            std::to_string(to_MiB(essentials::maxrss_in_bytes())) + " MiB");
+    } catch (std::exception const& e) {
+        essentials::logger("reload failed: " + std::string(e.what()) +
+                           "; keeping the old index");
+    }
+    s_reloading = false;
+}
+
+static std::string index_filename() {
+    std::lock_guard<std::mutex> lock(s_index_filename_mutex);
+    return s_index_filename;
+}
+
+/* reload the index from filename, or from the current index filename
+   if empty: return false if a reload is in progress */
+static bool start_reload(std::string const& filename) {
+    bool expected = false;
+    if (!s_reloading.compare_exchange_strong(expected, true)) return false;
+    std::string reloaded;
+    {
+        std::lock_guard<std::mutex> lock(s_index_filename_mutex);
+        if (filename != "") s_index_filename = filename;
+        reloaded = s_index_filename;
+    }
+    std::thread(reload, reloaded, s_blocklist_filename).detach();
+    return true;
+}
+
+/* every query is timed, by stage, into the metrics exposed by /metrics */
+static server_metrics s_metrics;
+
+static std::pair<topk_index_type::iterator_type, bool> topk(
+    topk_index_type const& index, std::string const& query, size_t k,
+    bool conjunctive) {
+    thread_metrics& metrics = s_metrics.local();
+    metrics_probe probe(metrics);
+    auto start = metrics_probe::clock_type::now();
+    auto it = conjunctive ? index.conjunctive_topk(s_context, query, k, probe)
+                          : index.prefix_topk(s_context, query, k, probe);
+    bool partial = conjunctive and s_context.budget.partial();
+    metrics.record_query(conjunctive, metrics_probe::nanosec_since(start),
+                         it.size(), partial);
+    return {it, partial};
+}
+
+static bool is_local(struct mg_connection* nc) {
+    return nc->sa.sin.sin_family == AF_INET and
+           nc->sa.sin.sin_addr.s_addr == htonl(INADDR_LOOPBACK);
+}
+
+static void send_json(struct mg_connection* nc, int status_code,
+                      std::string const& data) {
+    mg_send_head(nc, status_code, data.size(),
+                 "Content-Type: application/json");
+    mg_send(nc, data.data(), data.size());
+}
+
+static void admin_handler(struct mg_connection* nc, std::string const& uri,
+                          struct http_message* hm) {
+    if (!is_local(nc)) {
+        mg_http_send_error(nc, 403, "Forbidden");
+        return;
+    }
+
+    if (uri == "/admin/reload") {
+        char filename_buf[256];
+        int filename_len =
+            mg_get_http_var(&(hm->query_string), "filename", filename_buf,
+                            sizeof(filename_buf));
+        std::string filename(filename_buf,
+                             filename_len > 0 ? filename_len : 0);
+        if (!start_reload(filename)) {
+            send_json(nc, 409, "{\"error\":\"reload in progress\"}\n");
+            return;
+        }
+        send_json(nc, 202,
+                  "{\"reloading\":\"" + escape_json(index_filename()) +
+                      "\"}\n");
+    } else if (uri == "/admin/blocklist") {
+        try {
+            auto deleted = load_blocklist(s_blocklist_filename);
+            for (auto& replica : s_replicas) {
+                std::atomic_load(&replica)->set_tombstones(deleted);
+            }
+            send_json(nc, 200,
+                      "{\"blocked\":" + std::to_string(deleted->size()) +
+                          "}\n");
+        } catch (std::exception const& e) {
+            send_json(nc, 500,
+                      "{\"error\":\"" + escape_json(e.what()) + "\"}\n");
+        }
+    } else if (uri == "/admin/status") {
+        auto index = current_index();
+        send_json(
+            nc, 200,
+            "{\"index_filename\":\"" + escape_json(index_filename()) +
+                "\",\"index_MiB\":" + std::to_string(to_MiB(index->bytes())) +
+                ",\"replicas\":" + std::to_string(s_replicas.size()) +
+                ",\"peak_rss_MiB\":" +
+                std::to_string(to_MiB(essentials::maxrss_in_bytes())) +
+                ",\"reloading\":" + (s_reloading ? "true" : "false") + "}\n");
+    } else {
+        mg_http_send_error(nc, 404, "Not Found");
+    }
+}
 
 static void ev_handler(struct mg_connection* nc, int ev, void* p) {
     if (ev == MG_EV_HTTP_REQUEST) {
         struct http_message* hm = (struct http_message*)p;
-        std::string uri = std::string(hm->uri.p, (hm->uri.p) + (hm->uri.len));
+        struct mg_str const& uri = hm->uri;
 
-        if (uri == "/topcomp") {
-            std::string query = "";
+        if (uri.len >= 7 and strncmp(uri.p, "/admin/", 7) == 0) {
+            admin_handler(nc, std::string(uri.p, uri.p + uri.len), hm);
+        } else if (mg_vcmp(&uri, "/topcomp") == 0) {
             size_t k = 10;
             char query_buf[constants::MAX_NUM_CHARS_PER_QUERY];
             int query_len = mg_get_http_var(&(hm->query_string), "q", query_buf,
                                             constants::MAX_NUM_CHARS_PER_QUERY);
-            if (query_len > 0) {
-                query = std::string(query_buf, query_buf + query_len);
-            }
+            s_query.assign(query_buf, query_len > 0 ? query_len : 0);
             char k_buf[16];
             int k_len = mg_get_http_var(&(hm->query_string), "k", k_buf, 16);
-            if (k_len > 0) {
-                k = std::stoull(std::string(k_buf, k_buf + k_len));
-            }
+            if (k_len > 0) k = std::strtoull(k_buf, nullptr, 10);
+            k = std::min<size_t>(k, constants::MAX_K);
 
-            std::string data;
-            nop_probe probe;
-            // auto it = topk_index.topk(query, k probe);
-            // auto it = topk_index.prefix_topk(query, k, probe);
-            auto it = topk_index.conjunctive_topk(query, k, probe);
-            if (it.empty()) {
-                data = "{\"suggestions\":[\"value\":\"\",\"data\":\"\"]}\n";
-            } else {
-                data = "{\"suggestions\":[";
+            char* out = s_response;
+            out = append("{\"suggestions\":[", out);
+            bool partial = false;
+            /* no search for k = 0: the top-k loops stop only when k
+               results are found */
+            if (k != 0) {
+                auto topk_index = current_index();
+                constexpr bool conjunctive = true;
+                auto results = topk(*topk_index, s_query, k, conjunctive);
+                auto it = results.first;
                 for (size_t i = 0; i != it.size(); ++i, ++it) {
                     auto completion = *it;
-                    if (i > 0) data += ",";
-                    data += "{\"value\":\"" +
-                            escape_json(std::string(completion.string.begin,
-                                                    completion.string.end)) +
-                            "\",";
-                    data += "\"data\":\"" + std::to_string(i) + "\"}";
+                    if (i > 0) *out++ = ',';
+                    out = append("{\"value\":\"", out);
+                    out = escape_json(completion.string, out);
+                    out += sprintf(out, "\",\"data\":\"%zu\"}", i);
                 }
-                data += "]}\n";
+                partial = results.second;
             }
-            /* Send headers */
-            mg_printf(nc, "%s",
-                      "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
-            mg_printf_http_chunk(nc, data.c_str(), data.size());
-            mg_send_http_chunk(nc, "",
-                               0);  // send empty chunk, the end of response
+            out = append("],\"partial\":", out);
+            out = append(partial ? "true}\n" : "false}\n", out);
+            assert(size_t(out - s_response) <= sizeof(s_response));
+            /* the size is known: no need for chunked encoding */
+            mg_send_head(nc, 200, out - s_response,
+                         "Content-Type: application/json");
+            mg_send(nc, s_response, out - s_response);
+        } else if (mg_vcmp(&uri, "/metrics") == 0) {
+            auto topk_index = current_index();
+            std::string metrics = s_metrics.scrape(*topk_index);
+            mg_send_head(nc, 200, metrics.size(),
+                         "Content-Type: text/plain; version=0.0.4");
+            mg_send(nc, metrics.data(), metrics.size());
         } else {
             mg_serve_http(nc, (struct http_message*)p, s_http_server_opts);
         }
     }
 }
 
+/* all the complete requests received are answered, in order, with a single
+   send; a connection sending a malformed request is closed, after the
+   responses to the requests before it */
+static void rpc_handler(struct mg_connection* nc, int ev, void*) {
+    if (ev != MG_EV_RECV) return;
+    struct mbuf& received = nc->recv_mbuf;
+    uint8_t const* begin = reinterpret_cast<uint8_t const*>(received.buf);
+    byte_range requests = {begin, begin + received.len};
+    auto topk_index = current_index();
+    s_rpc_response.clear();
+    size_t answered = 0;
+    try {
+        while (size_t size = rpc::frame_size(requests)) {
+            rpc::answer({requests.begin, requests.begin + size}, s_query,
+                        s_rpc_response,
+                        [&](rpc::query_mode mode, uint32_t k,
+                            std::string const& query) {
+                            return topk(*topk_index, query, k,
+                                        mode == rpc::query_mode::conjunctive);
+                        });
+            requests.begin += size;
+            answered = s_rpc_response.size();
+        }
+    } catch (std::exception const& e) {
+        essentials::logger("closing binary protocol connection: " +
+                           std::string(e.what()));
+        s_rpc_response.resize(answered);
+        nc->flags |= MG_F_SEND_AND_CLOSE;
+    }
+    mbuf_remove(&received, requests.begin - begin);
+    if (answered) mg_send(nc, s_rpc_response.data(), answered);
+}
+
+/* in NUMA mode, every thread listens on the ports with a socket of its
+   own, the kernel spreading the connections among the sockets */
+static int listen_shared(std::string const& port) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+    int on = 1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(std::strtoul(port.c_str(), nullptr, 10));
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0 or
+        bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0 or
+        listen(sock, SOMAXCONN) != 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static struct mg_connection* bind_port(struct mg_mgr* mgr,
+                                       std::string const& port,
+                                       mg_event_handler_t handler) {
+    if (!s_threads_per_node) return mg_bind(mgr, port.c_str(), handler);
+    int sock = listen_shared(port);
+    if (sock < 0) return NULL;
+    struct mg_connection* nc = mg_add_sock(mgr, sock, handler);
+    if (nc != NULL) nc->flags |= MG_F_LISTENING;
+    return nc;
+}
+
+/* the event loop of a thread, querying the replica of the node */
+static void serve(uint32_t node, bool reloads) {
+    if (s_threads_per_node) s_numa.bind_to_node(node);
+    s_node = node;
+    s_query.reserve(constants::MAX_NUM_CHARS_PER_QUERY);
+
+    struct mg_mgr mgr;
+    mg_mgr_init(&mgr, NULL);
+    struct mg_connection* nc = bind_port(&mgr, s_http_port, ev_handler);
+    if (nc == NULL) {
+        std::cerr << "cannot bind port " << s_http_port << std::endl;
+        std::exit(1);
+    }
+    mg_set_protocol_http_websocket(nc);
+    if (s_rpc_port != "" and bind_port(&mgr, s_rpc_port, rpc_handler) == NULL) {
+        std::cerr << "cannot bind port " << s_rpc_port << std::endl;
+        std::exit(1);
+    }
+
+    while (true) {
+        mg_mgr_poll(&mgr, 1000);
+        if (reloads and s_reload_requested) {
+            s_reload_requested = 0;
+            if (!start_reload("")) essentials::logger("reload in progress");
+        }
+    }
+    mg_mgr_free(&mgr);
+}
+
 int main(int argc, char** argv) {
     int mandatory = 2;
     if (argc < mandatory + 1) {
-        std::cout << argv[0] << " <port> <index_filename>" << std::endl;
+        std::cout << argv[0]
+                  << " <port> <index_filename> [blocklist_filename]"
+                     " [max_microsec_per_query] [rpc_port]"
+                     " [threads_per_node]"
+                  << std::endl;
         return 1;
     }
 
     s_http_port = argv[1];
-    char const* index_filename = argv[2];
-    essentials::load(topk_index, index_filename);
-
-    struct mg_mgr mgr;
-    struct mg_connection* nc;
-
-    mg_mgr_init(&mgr, NULL);
-    nc = mg_bind(&mgr, s_http_port.c_str(), ev_handler);
+    s_index_filename = argv[2];
+    if (argc > mandatory + 1) s_blocklist_filename = argv[3];
+    if (argc > mandatory + 2 and argv[4][0] != '\0') {
+        s_budget = search_budget(search_budget::UNLIMITED,
+                                 std::strtoull(argv[4], nullptr, 10));
+    }
+    if (argc > mandatory + 3) s_rpc_port = argv[5];
+    if (argc > mandatory + 4) {
+        s_threads_per_node = std::strtoul(argv[6], nullptr, 10);
+    }
+    s_replicas = load_replicas(s_index_filename, s_blocklist_filename);
+    std::signal(SIGHUP, on_sighup);
 
-    // Set up HTTP server parameters
-    mg_set_protocol_http_websocket(nc);
     s_http_server_opts.document_root = "../web";
     s_http_server_opts.enable_directory_listing = "no";
 
     printf("Starting web server on port %s\n", s_http_port.c_str());
+    if (s_rpc_port != "") {
+        printf("Serving the binary protocol on port %s\n", s_rpc_port.c_str());
+    }
+    if (s_threads_per_node) {
+        printf("NUMA mode: %u threads on each of the %u nodes\n",
+               s_threads_per_node, s_numa.num_nodes());
+    }
 
-    while (true) mg_mgr_poll(&mgr, 1000);
-    mg_mgr_free(&mgr);
+    std::vector<std::thread> threads;
+    for (uint32_t node = 0; node != s_replicas.size(); ++node) {
+        for (uint32_t i = node == 0; i < s_threads_per_node; ++i) {
+            threads.emplace_back(serve, node, false);
+        }
+    }
+    constexpr bool reloads = true;
+    serve(0, reloads);
 
     return 0;
 }
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "test_common.hpp"
+
+using namespace autocomplete;
+
+/* count the allocations made through the global operator new, in all
+   its forms: the ones not replaced here call one of them, from any
+   thread, as the ones of a search_pool */
+static std::atomic<uint64_t> num_allocations(0);
+
+static void* allocate(size_t size) noexcept {
+    ++num_allocations;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+static void* allocate(size_t size, std::align_val_t alignment) noexcept {
+    ++num_allocations;
+    size_t a = static_cast<size_t>(alignment);
+    /* the size must be a multiple of the alignment */
+    return std::aligned_alloc(a, (std::max<size_t>(size, 1) + a - 1) / a * a);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+/* GCC pairs the malloc in allocate with the operator delete below */
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    void* p = allocate(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, std::nothrow_t const&) noexcept {
+    return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    void* p = allocate(size, alignment);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, std::align_val_t alignment,
+                   std::nothrow_t const&) noexcept {
+    return allocate(size, alignment);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::nothrow_t const&) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t,
+                     std::nothrow_t const&) noexcept {
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+template <typename Index, typename TopK>
+uint64_t allocations_per_pass(Index& index,
+                              std::vector<std::string> const& queries,
+                              TopK topk) {
+    uint64_t before = num_allocations;
+    for (auto const& query : queries) topk(index, query);
+    return num_allocations - before;
+}
+
+/* the queries of the warm-up and the ones run after it: these are not
+   seen during the warm-up and keep only the first character of their last
+   token, so that their suffix ranges are wider */
+struct query_sets {
+    std::vector<std::string> warmup;
+    std::vector<std::string> unseen;
+};
+
+/* after a pass over the warm-up queries has grown the buffers of the
+   index, the unseen queries allocate only when their ranges are wider than
+   all the previous ones, as the heaps are sized for the ranges pushed and
+   keep their capacity: a second pass over them must not allocate memory */
+template <typename Index, typename TopK>
+void test_allocations(Index& index, query_sets const& queries, TopK topk,
+                      char const* name) {
+    allocations_per_pass(index, queries.warmup, topk);
+    uint64_t allocations = allocations_per_pass(index, queries.unseen, topk);
+    REQUIRE_MESSAGE(allocations < queries.unseen.size() / 2,
+                    allocations << " allocations for "
+                                << queries.unseen.size() << " unseen " << name
+                                << " queries");
+    allocations = allocations_per_pass(index, queries.unseen, topk);
+    REQUIRE_MESSAGE(allocations == 0, allocations << " allocations for "
+                                                  << queries.unseen.size()
+                                                  << " " << name
+                                                  << " queries");
+}
+
+template <typename Index>
+void test_allocations(Index& index, query_sets const& queries) {
+    constexpr uint32_t k = 7;
+    nop_probe probe;
+    test_allocations(
+        index, queries,
+        [&](Index& index, std::string const& query) {
+            index.prefix_topk(query, k, probe);
+        },
+        "prefix_topk");
+    test_allocations(
+        index, queries,
+        [&](Index& index, std::string const& query) {
+            index.conjunctive_topk(query, k, probe);
+        },
+        "conjunctive_topk");
+    test_allocations(
+        index, queries,
+        [&](Index& index, std::string const& query) {
+            index.fuzzy_conjunctive_topk(query, k,
+                                         constants::MAX_FUZZY_EDITS, probe);
+        },
+        "fuzzy_conjunctive_topk");
+}
+
+/* with min_candidates = 0, most conjunctive queries are split into
+   segments: the buffers of the segments must be reused as well */
+template <typename Index>
+void test_parallel_allocations(Index& index, query_sets const& queries) {
+    constexpr uint32_t k = 7;
+    nop_probe probe;
+    auto pool = std::make_shared<search_pool>(3);
+    index.set_parallelism(intra_query_parallelism(pool, 16, 0));
+    test_allocations(
+        index, queries,
+        [&](Index& index, std::string const& query) {
+            index.conjunctive_topk(query, k, probe);
+        },
+        "parallel conjunctive_topk");
+    REQUIRE(index.parallel_queries() > 0);
+    index.set_parallelism(intra_query_parallelism());
+}
+
+/* the deleted doc_ids are visited without being reported: the queues
+   must be sized for them at the warm-up after the tombstones are set */
+template <typename Index>
+void test_allocations_with_tombstones(Index& index,
+                                      query_sets const& queries,
+                                      uint64_t universe) {
+    std::vector<id_type> deleted;
+    for (id_type doc_id = 0; doc_id < universe; doc_id += 3) {
+        deleted.push_back(doc_id);
+    }
+    index.set_tombstones(std::make_shared<const tombstone_set>(deleted));
+    test_allocations(index, queries);
+    index.set_tombstones(std::make_shared<const tombstone_set>());
+}
+
+TEST_CASE("test allocation-free queries") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    query_sets queries;
+    for (uint32_t num_terms = 1; num_terms <= 5; ++num_terms) {
+        std::string filename =
+            params.collection_basename +
+            ".queries/queries.length=" + std::to_string(num_terms);
+        std::ifstream querylog(filename.c_str());
+        REQUIRE_MESSAGE(querylog.is_open(),
+                        "cannot open file '" << filename << "'");
+        load_queries(queries.warmup, 150, 0.5, querylog);
+        load_queries(queries.unseen, 150, 0.0, querylog);
+        querylog.close();
+    }
+
+    {
+        ef_autocomplete_type1 index(params);
+        test_allocations(index, queries);
+        test_allocations_with_tombstones(index, queries, params.universe);
+    }
+    {
+        ef_autocomplete_type2 index(params);
+        test_allocations(index, queries);
+        test_allocations_with_tombstones(index, queries, params.universe);
+    }
+    {
+        ef_autocomplete_type3 index(params);
+        test_allocations(index, queries);
+        test_allocations_with_tombstones(index, queries, params.universe);
+        test_parallel_allocations(index, queries);
+    }
+    {
+        ef_autocomplete_type4 index(params, 0.0001);
+        test_allocations(index, queries);
+        test_allocations_with_tombstones(index, queries, params.universe);
+        test_parallel_allocations(index, queries);
+    }
+    {
+        /* the heap of the suffix lists, of ef_type3, on the forward
+           index of ef_type1 */
+        ef_autocomplete_type5 index(params);
+        index.set_strategy(conjunctive_strategy::heap);
+        test_allocations(index, queries);
+        test_allocations_with_tombstones(index, queries, params.universe);
+    }
+}
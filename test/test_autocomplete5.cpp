@@ -0,0 +1,63 @@
+#include "test_common.hpp"
+
+using namespace autocomplete;
+
+typedef ef_autocomplete_type5::strategy strategy;
+
+/*
+The strategy used for the conjunctive step must not change the results,
+that must be the same as the ones of autocomplete (type 1).
+*/
+template <typename Index>
+std::vector<id_type> conjunctive_topk(Index& index, std::string const& query,
+                                      bool fuzzy) {
+    constexpr uint32_t k = 10;
+    nop_probe probe;
+    auto it = fuzzy ? index.fuzzy_conjunctive_topk(query, k, 1, probe)
+                    : index.conjunctive_topk(query, k, probe);
+    std::vector<id_type> doc_ids;
+    for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+        doc_ids.push_back((*it).score);
+    }
+    return doc_ids;
+}
+
+TEST_CASE("test autocomplete5 strategies") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    ef_autocomplete_type1 type1(params);
+    ef_autocomplete_type5 index(params);
+
+    for (uint32_t num_terms = 1; num_terms <= 3; ++num_terms) {
+        std::vector<std::string> queries;
+        std::string filename =
+            params.collection_basename +
+            ".queries/queries.length=" + std::to_string(num_terms);
+        std::ifstream querylog(filename.c_str());
+        REQUIRE_MESSAGE(querylog.is_open(),
+                        "cannot open file '" << filename << "'");
+        load_queries(queries, 300, 0.25, querylog);
+        querylog.close();
+
+        for (auto const& query : queries) {
+            for (bool fuzzy : {false, true}) {
+                auto expected = conjunctive_topk(type1, query, fuzzy);
+                for (auto s :
+                     {strategy::adaptive, strategy::forward, strategy::heap}) {
+                    index.set_strategy(s);
+                    auto got = conjunctive_topk(index, query, fuzzy);
+                    REQUIRE_MESSAGE(got == expected,
+                                    "wrong results for '" << query << "'");
+                }
+            }
+        }
+    }
+
+    index.set_strategy(strategy::heap);
+    uint64_t heap_queries = index.heap_queries();
+    conjunctive_topk(index, "new", false);
+    conjunctive_topk(index, "new yo", false);
+    REQUIRE(index.heap_queries() == heap_queries + 1);
+}
@@ -45,3 +45,43 @@ TEST_CASE("test compact_forward_index::iterator") {
         std::remove(output_filename);
     }
 };
+
+TEST_CASE("test compact_forward_index::intersects") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    compact_forward_index::builder builder(params);
+    compact_forward_index index;
+    builder.build(index);
+
+    essentials::uniform_int_rng<uint64_t> rng(1, params.num_terms, 13);
+    for (id_type doc_id = 0; doc_id != index.num_docs(); ++doc_id) {
+        std::vector<id_type> terms;
+        auto it = index.iterator(doc_id);
+        for (uint64_t i = 0; i != it.size(); ++i, ++it) terms.push_back(*it);
+
+        range_list ranges;
+        for (uint64_t i = 0; i != 3; ++i) {
+            uint64_t begin = rng.gen();
+            uint64_t end = std::min<uint64_t>(begin + rng.gen() % 1000,
+                                              params.num_terms);
+            if (!ranges.empty() and begin <= ranges.back().end) break;
+            ranges.push_back({begin, end});
+        }
+        /* a range including one term of the completion */
+        auto t = terms[rng.gen() % terms.size()];
+        range r{t - rng.gen() % t, t + rng.gen() % 3};
+
+        for (auto q : {r, ranges.front()}) {
+            bool expected =
+                std::any_of(terms.begin(), terms.end(),
+                            [&](id_type x) { return q.contains(x); });
+            REQUIRE(index.intersects(doc_id, q) == expected);
+        }
+        bool expected =
+            std::any_of(terms.begin(), terms.end(),
+                        [&](id_type x) { return ranges.contains(x); });
+        REQUIRE(index.intersects(doc_id, ranges) == expected);
+    }
+}
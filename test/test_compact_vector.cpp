@@ -0,0 +1,71 @@
+#include "test_common.hpp"
+
+using namespace autocomplete;
+
+TEST_CASE("test compact_vector::decode") {
+    essentials::uniform_int_rng<uint64_t> rng(0, uint64_t(-1), 13);
+    for (uint64_t width = 1; width <= 64; ++width) {
+        uint64_t mask = width == 64 ? uint64_t(-1) : (uint64_t(1) << width) - 1;
+        std::vector<uint64_t> values(1000);
+        for (auto& x : values) x = rng.gen() & mask;
+        compact_vector cv;
+        cv.build(values.begin(), values.size(), width);
+
+        std::vector<uint64_t> out(values.size());
+        std::vector<uint32_t> out32(values.size());
+        /* short runs, runs not aligned to the blocks of 64 values,
+           and runs spanning several blocks */
+        for (uint64_t begin : {0, 1, 63, 64, 100, 511}) {
+            for (uint64_t n : {0, 1, 7, 8, 9, 31, 64, 129, 400}) {
+                cv.decode(begin, n, out.data());
+                for (uint64_t i = 0; i != n; ++i) {
+                    REQUIRE_MESSAGE(out[i] == values[begin + i],
+                                    "width " << width << ", begin " << begin
+                                             << ", n " << n);
+                }
+                if (width > 32) continue;
+                cv.decode(begin, n, out32.data());
+                for (uint64_t i = 0; i != n; ++i) {
+                    REQUIRE(out32[i] == values[begin + i]);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("test width-specialised accessors") {
+    essentials::uniform_int_rng<uint64_t> rng(0, uint64_t(-1), 13);
+    for (uint64_t width = 1; width <= 64; ++width) {
+        uint64_t mask = width == 64 ? uint64_t(-1) : (uint64_t(1) << width) - 1;
+        std::vector<uint64_t> values(300);
+        for (auto& x : values) x = rng.gen() & mask;
+
+        compact_vector cv;
+        cv.build(values.begin(), values.size(), width);
+        /* preceded by 3 bits, so that the values are not aligned as in cv */
+        bit_vector_builder bvb;
+        bvb.append_bits(5, 3);
+        for (auto x : values) bvb.append_bits(x, width);
+        bit_vector bv;
+        bv.build(&bvb);
+        bits_getter getter(bv, 3, width);
+
+        util::with_width(width, [&](auto w) {
+            REQUIRE(w == width);
+            for (uint64_t i = 0; i != values.size(); ++i) {
+                REQUIRE(cv.access<w>(i) == values[i]);
+                REQUIRE(getter.access<w>(i) == values[i]);
+            }
+        });
+    }
+
+    bit_vector_builder bvb;
+    bvb.append_bits(5, 3);
+    bvb.append_bits(0xabcdef12, 32);
+    bvb.append_bits(42, 6);
+    bit_vector bv;
+    bv.build(&bvb);
+    REQUIRE(bv.get_bits<3>(0) == 5);
+    REQUIRE(bv.get_bits<32>(3) == 0xabcdef12);
+    REQUIRE(bv.get_bits<6>(35) == 42);
+}
@@ -2,24 +2,23 @@
 
 using namespace autocomplete;
 
-typedef ef_completion_trie completion_trie_type;
-
-TEST_CASE("test completion_trie::is_member()") {
+template <typename CompletionTrie>
+void test_is_member() {
     char const* output_filename = testing::tmp_filename.c_str();
     parameters params;
     params.collection_basename = testing::test_filename.c_str();
     params.load();
 
     {
-        completion_trie_type::builder builder(params);
-        completion_trie_type ct;
+        typename CompletionTrie::builder builder(params);
+        CompletionTrie ct;
         builder.build(ct);
         REQUIRE(ct.size() == params.num_completions);
-        essentials::save<completion_trie_type>(ct, output_filename);
+        essentials::save<CompletionTrie>(ct, output_filename);
     }
 
     {
-        completion_trie_type ct;
+        CompletionTrie ct;
         essentials::load(ct, output_filename);
         REQUIRE(ct.size() == params.num_completions);
         std::ifstream input(params.collection_basename + ".mapped",
@@ -35,3 +34,11 @@ TEST_CASE("test completion_trie::is_member()") {
         std::remove(output_filename);
     }
 }
+
+TEST_CASE("test completion_trie::is_member()") {
+    test_is_member<ef_completion_trie>();
+}
+
+TEST_CASE("test interleaved completion_trie::is_member()") {
+    test_is_member<interleaved_completion_trie>();
+}
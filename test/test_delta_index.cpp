@@ -0,0 +1,272 @@
+#include "test_common.hpp"
+#include "delta_index.hpp"
+
+using namespace autocomplete;
+
+typedef ef_autocomplete_type1 index_type;
+
+std::vector<std::string> tokenise(std::string const& s) {
+    std::vector<std::string> tokens;
+    byte_range_iterator it(string_to_byte_range(s));
+    while (it.has_next()) {
+        byte_range t = it.next();
+        tokens.emplace_back(t.begin, t.end);
+    }
+    return tokens;
+}
+
+bool starts_with(std::string const& s, std::string const& p) {
+    return s.compare(0, p.size(), p) == 0;
+}
+
+std::string normalize(std::string const& s) {
+    std::string normalized;
+    for (auto const& t : tokenise(s)) normalized += t + " ";
+    normalized.pop_back();
+    return normalized;
+}
+
+TEST_CASE("test delta_index") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    std::vector<std::string> strings;
+    {
+        std::string line;
+        std::ifstream input(params.collection_basename.c_str(),
+                            std::ios_base::in);
+        while (std::getline(input, line)) {
+            strings.push_back(line.substr(line.find(' ') + 1));
+        }
+    }
+
+    constexpr uint32_t num_insertions = 5000;
+    essentials::uniform_int_rng<uint32_t> random_string(0, strings.size() - 1);
+    std::vector<std::pair<id_type, std::string>> inserted;
+    {
+        std::vector<id_type> doc_ids(num_insertions);
+        std::iota(doc_ids.begin(), doc_ids.end(), 0);
+        std::shuffle(doc_ids.begin(), doc_ids.end(), std::mt19937(13));
+        for (auto doc_id : doc_ids) {
+            auto const& s = strings[random_string.gen()];
+            bool found = false;
+            for (auto const& p : inserted) {
+                if (p.second == s) found = true;
+            }
+            if (!found) inserted.emplace_back(doc_id, normalize(s));
+        }
+    }
+
+    delta_index delta;
+    for (auto const& p : inserted) REQUIRE(delta.insert(p.first, p.second));
+    REQUIRE(delta.size() == inserted.size());
+
+    constexpr uint32_t k = 7;
+    for (uint32_t i = 0; i != 1000; ++i) {
+        auto const& s = inserted[i % inserted.size()].second;
+        auto tokens = tokenise(s);
+        std::string query;
+        for (size_t j = 0; j + 1 < tokens.size(); ++j) query += tokens[j] + " ";
+        query += tokens.back().substr(0, 1 + i % tokens.back().size());
+
+        std::vector<id_type> expected;
+        for (auto const& p : inserted) {
+            if (starts_with(p.second, query)) expected.push_back(p.first);
+        }
+        std::sort(expected.begin(), expected.end());
+        if (expected.size() > k) expected.resize(k);
+
+        uint32_t results = delta.prefix_topk(query, k);
+        REQUIRE_MESSAGE(results == expected.size(),
+                        "prefix_topk: wrong number of results for '" << query
+                                                                     << "'");
+        for (uint32_t j = 0; j != results; ++j) {
+            REQUIRE(delta.topk()[j].first == expected[j]);
+        }
+
+        /* conjunctive query: the terms in reverse order */
+        auto query_tokens = tokenise(query);
+        std::reverse(query_tokens.begin(), query_tokens.end() - 1);
+        query.clear();
+        for (auto const& t : query_tokens) query += t + " ";
+        query.pop_back();
+
+        expected.clear();
+        for (auto const& p : inserted) {
+            auto completion_tokens = tokenise(p.second);
+            bool match = true;
+            for (size_t j = 0; j + 1 < query_tokens.size(); ++j) {
+                if (std::find(completion_tokens.begin(),
+                              completion_tokens.end(),
+                              query_tokens[j]) == completion_tokens.end()) {
+                    match = false;
+                }
+            }
+            bool suffix_match = false;
+            for (auto const& t : completion_tokens) {
+                if (starts_with(t, query_tokens.back())) suffix_match = true;
+            }
+            if (match and suffix_match) expected.push_back(p.first);
+        }
+        std::sort(expected.begin(), expected.end());
+        if (expected.size() > k) expected.resize(k);
+
+        results = delta.conjunctive_topk(query, k);
+        REQUIRE_MESSAGE(results == expected.size(),
+                        "conjunctive_topk: wrong number of results for '"
+                            << query << "'");
+        for (uint32_t j = 0; j != results; ++j) {
+            REQUIRE(delta.topk()[j].first == expected[j]);
+        }
+    }
+
+    /* k = 0 asks for no results, whatever the query matches */
+    for (auto const& query : {"", "a", "new york ci", "york new"}) {
+        REQUIRE(delta.prefix_topk(query, 0) == 0);
+        REQUIRE(delta.topk().empty());
+        REQUIRE(delta.conjunctive_topk(query, 0) == 0);
+        REQUIRE(delta.topk().empty());
+    }
+}
+
+/* a thread inserts while another queries: a query sees each completion
+   either not inserted yet or inserted, with its string */
+TEST_CASE("test delta_index insertions while querying") {
+    constexpr uint32_t num_insertions = 20000;
+    std::vector<std::string> completions;
+    for (uint32_t i = 0; i != num_insertions; ++i) {
+        completions.push_back("new completion " + std::to_string(i));
+    }
+
+    delta_index delta;
+    std::atomic<bool> done(false);
+    uint32_t inserted = 0;
+    std::thread writer([&] {
+        for (uint32_t i = 0; i != num_insertions; ++i) {
+            inserted += delta.insert(i, completions[i]);
+        }
+        done = true;
+    });
+
+    constexpr uint32_t k = 10;
+    uint64_t num_queries = 0;
+    while (!done or num_queries == 0) {
+        bool conjunctive = num_queries % 2;
+        uint32_t results = conjunctive
+                               ? delta.conjunctive_topk("completion ne", k)
+                               : delta.prefix_topk("new comp", k);
+        auto const& topk = delta.topk();
+        for (uint32_t i = 0; i != results; ++i) {
+            auto doc_id = topk[i].first;
+            REQUIRE(doc_id < num_insertions);
+            REQUIRE(delta.string(topk[i].second) == completions[doc_id]);
+            if (i > 0) REQUIRE(topk[i - 1].first < doc_id);
+        }
+        ++num_queries;
+    }
+    writer.join();
+
+    REQUIRE(inserted == num_insertions);
+    REQUIRE(delta.size() == num_insertions);
+    REQUIRE(delta.prefix_topk("new comp", k) == k);
+    for (uint32_t i = 0; i != k; ++i) REQUIRE(delta.topk()[i].first == i);
+}
+
+TEST_CASE("test delta_autocomplete") {
+    char const* output_filename = testing::tmp_filename.c_str();
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    {
+        index_type index(params);
+        essentials::save<index_type>(index, output_filename);
+    }
+
+    delta_autocomplete<index_type> index;
+    essentials::load(index, output_filename);
+
+    uint32_t k = 7;
+    nop_probe probe;
+
+    std::string already_indexed;
+    {
+        auto it = index.static_index().prefix_topk("for s", k, probe);
+        REQUIRE(it.size() > 0);
+        for (uint32_t i = 0; i != it.size() - 1; ++i) ++it;
+        auto completion = *it;
+        already_indexed.assign(completion.string.begin, completion.string.end);
+    }
+
+    REQUIRE(index.insert(0, "zzyzx trending query"));
+    REQUIRE(index.insert(1, "florida zzyzx"));
+    REQUIRE(index.insert(2, already_indexed));
+
+    auto check_sorted = [&](scored_string_pool::iterator it) {
+        for (uint32_t i = 1; i < it.size(); ++i) {
+            REQUIRE((*it.pool())[i - 1].score <= (*it.pool())[i].score);
+        }
+    };
+
+    auto it = index.prefix_topk("zzyzx tr", k, probe);
+    REQUIRE(it.size() == 1);
+    REQUIRE((*it).score == 0);
+
+    it = index.prefix_topk("for s", k, probe);
+    check_sorted(it);
+    uint32_t occurrences = 0;
+    for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+        auto completion = *it;
+        std::string s(completion.string.begin, completion.string.end);
+        if (s == already_indexed) {
+            REQUIRE(completion.score == 2);
+            ++occurrences;
+        }
+    }
+    REQUIRE(occurrences == 1);
+
+    it = index.conjunctive_topk("query zzy", k, probe);
+    REQUIRE(it.size() == 1);
+    REQUIRE((*it).score == 0);
+
+    it = index.conjunctive_topk("zzy", k, probe);
+    check_sorted(it);
+    REQUIRE(it.size() == 2);
+
+    it = index.conjunctive_topk("florida zz", k, probe);
+    REQUIRE(it.size() == 1);
+    REQUIRE((*it).score == 1);
+
+    it = index.conjunctive_topk("flo", k, probe);
+    check_sorted(it);
+    REQUIRE(it.size() == k);
+    REQUIRE((*it).score == 1);
+
+    /* re-inserted with a worse score: the delta overrides the static copy */
+    std::string best;
+    {
+        auto it = index.static_index().prefix_topk("for s", k, probe);
+        auto completion = *it;
+        best.assign(completion.string.begin, completion.string.end);
+    }
+    const id_type worst = params.num_completions + 1;
+    REQUIRE(index.insert(worst, best));
+    it = index.prefix_topk("for s", constants::MAX_K, probe);
+    check_sorted(it);
+    for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+        auto completion = *it;
+        std::string s(completion.string.begin, completion.string.end);
+        if (s == best) REQUIRE(completion.score == worst);
+    }
+
+    /* the completions of the delta are blocked as well */
+    index.set_tombstones(std::make_shared<const tombstone_set>(
+        std::vector<id_type>{0, 1}));
+    it = index.prefix_topk("zzyzx tr", k, probe);
+    REQUIRE(it.size() == 0);
+    it = index.conjunctive_topk("florida zz", k, probe);
+    REQUIRE(it.size() == 0);
+
+    std::remove(output_filename);
+}
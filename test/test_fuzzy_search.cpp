@@ -0,0 +1,240 @@
+#include "test_common.hpp"
+
+using namespace autocomplete;
+
+std::vector<std::string> tokenise(std::string const& s) {
+    std::vector<std::string> tokens;
+    byte_range_iterator it(string_to_byte_range(s));
+    while (it.has_next()) {
+        byte_range t = it.next();
+        tokens.emplace_back(t.begin, t.end);
+    }
+    return tokens;
+}
+
+/* minimum edit distance between p and a prefix of t */
+uint32_t prefix_distance(std::string const& t, std::string const& p) {
+    std::vector<std::vector<uint32_t>> d(t.size() + 1,
+                                         std::vector<uint32_t>(p.size() + 1));
+    for (uint32_t j = 0; j <= p.size(); ++j) d[0][j] = j;
+    uint32_t min = d[0][p.size()];
+    for (uint32_t i = 1; i <= t.size(); ++i) {
+        d[i][0] = i;
+        for (uint32_t j = 1; j <= p.size(); ++j) {
+            d[i][j] = std::min({d[i - 1][j] + 1, d[i][j - 1] + 1,
+                                d[i - 1][j - 1] + (t[i - 1] != p[j - 1])});
+            if (i > 1 and j > 1 and t[i - 1] == p[j - 2] and
+                t[i - 2] == p[j - 1]) {
+                d[i][j] = std::min(d[i][j], d[i - 2][j - 2] + 1);
+            }
+        }
+        min = std::min(min, d[i][p.size()]);
+    }
+    return min;
+}
+
+std::string add_typo(std::string s,
+                     essentials::uniform_int_rng<uint32_t>& rng) {
+    char c = 'a' + rng.gen() % 26;
+    uint32_t pos = rng.gen() % s.size();
+    switch (rng.gen() % 4) {
+        case 0:
+            s[pos] = c;
+            break;
+        case 1:
+            s.insert(s.begin() + pos, c);
+            break;
+        case 2:
+            s.erase(s.begin() + pos);
+            break;
+        default:
+            if (pos + 1 < s.size()) std::swap(s[pos], s[pos + 1]);
+    }
+    return s;
+}
+
+TEST_CASE("test fuzzy_locate_prefix") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    fc_dictionary_type dict;
+    {
+        fc_dictionary_type::builder builder(params);
+        builder.build(dict);
+    }
+
+    std::vector<std::string> terms;
+    {
+        std::string term;
+        std::ifstream input((params.collection_basename + ".dict").c_str(),
+                            std::ios_base::in);
+        while (input >> term) terms.push_back(term);
+    }
+    REQUIRE(terms.size() == dict.size());
+
+    essentials::uniform_int_rng<uint32_t> rng(0, terms.size() - 1, 13);
+    uint32_t complete = 0;
+    constexpr uint32_t num_queries = 300;
+    for (uint32_t i = 0; i != num_queries; ++i) {
+        std::string query = terms[rng.gen()];
+        if (query.size() > 3) query.resize(3 + rng.gen() % (query.size() - 3));
+        query = add_typo(query, rng);
+        if (i % 3 == 0) query = add_typo(query, rng);
+
+        uint32_t edits =
+            fuzzy_edits(query.size(), constants::MAX_FUZZY_EDITS);
+        range_list ranges;
+        if (!fuzzy_locate_prefix(dict, string_to_byte_range(query),
+                                 constants::MAX_FUZZY_EDITS, ranges)) {
+            continue;
+        }
+        ++complete;
+
+        /* locate the children of every node larger than a bucket */
+        range_list trie_ranges;
+        fuzzy_prefix_search<fc_dictionary_type> search(dict, 16);
+        if (search.search(string_to_byte_range(query),
+                          constants::MAX_FUZZY_EDITS, trie_ranges)) {
+            REQUIRE(trie_ranges.size() == ranges.size());
+            for (uint32_t j = 0; j != ranges.size(); ++j) {
+                REQUIRE(trie_ranges[j].begin == ranges[j].begin);
+                REQUIRE(trie_ranges[j].end == ranges[j].end);
+            }
+        }
+
+        for (uint32_t j = 1; j < ranges.size(); ++j) {
+            REQUIRE(ranges[j - 1].end + 1 < ranges[j].begin);
+        }
+        for (uint64_t id = 0; id != terms.size(); ++id) {
+            constexpr uint32_t l = constants::FUZZY_EXACT_PREFIX_LENGTH;
+            bool expected = terms[id].compare(0, l, query, 0, l) == 0 and
+                            prefix_distance(terms[id], query) <= edits;
+            REQUIRE_MESSAGE(ranges.contains(id) == expected,
+                            "term '" << terms[id] << "' for query '" << query
+                                     << "': expected " << expected);
+        }
+    }
+    REQUIRE(complete > num_queries / 2);
+}
+
+template <typename Index>
+void test_fuzzy_conjunctive_topk(
+    Index& index, std::vector<std::string> const& queries,
+    std::vector<std::vector<id_type>> const& expected, uint32_t k) {
+    nop_probe probe;
+    for (uint32_t i = 0; i != queries.size(); ++i) {
+        auto it = index.fuzzy_conjunctive_topk(
+            queries[i], k, constants::MAX_FUZZY_EDITS, probe);
+        REQUIRE_MESSAGE(it.size() == expected[i].size(),
+                        "got " << it.size() << " results for '" << queries[i]
+                               << "' but expected " << expected[i].size());
+        for (uint32_t j = 0; j != it.size(); ++j, ++it) {
+            REQUIRE_MESSAGE((*it).score == expected[i][j],
+                            "got doc_id " << (*it).score << " for '"
+                                          << queries[i] << "' but expected "
+                                          << expected[i][j]);
+        }
+    }
+}
+
+TEST_CASE("test fuzzy_conjunctive_topk") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    fc_dictionary_type dict;
+    {
+        fc_dictionary_type::builder builder(params);
+        builder.build(dict);
+    }
+
+    std::vector<std::string> terms;
+    {
+        std::string term;
+        std::ifstream input((params.collection_basename + ".dict").c_str(),
+                            std::ios_base::in);
+        while (input >> term) terms.push_back(term);
+    }
+
+    /* the completions as sorted lists of 0-based term ids */
+    std::vector<std::pair<id_type, std::vector<id_type>>> docs;
+    std::vector<std::string> strings;
+    {
+        std::string line;
+        std::ifstream input(params.collection_basename.c_str(),
+                            std::ios_base::in);
+        while (std::getline(input, line)) {
+            auto pos = line.find(' ');
+            id_type doc_id = std::stoul(line.substr(0, pos));
+            strings.push_back(line.substr(pos + 1));
+            std::vector<id_type> term_ids;
+            for (auto const& t : tokenise(strings.back())) {
+                term_ids.push_back(testing::locate(terms, t) - 1);
+            }
+            std::sort(term_ids.begin(), term_ids.end());
+            docs.emplace_back(doc_id, term_ids);
+        }
+    }
+    std::sort(docs.begin(), docs.end());
+
+    constexpr uint32_t k = 7;
+    std::vector<std::string> queries;
+    std::vector<std::vector<id_type>> expected;
+    essentials::uniform_int_rng<uint32_t> rng(0, strings.size() - 1, 13);
+    while (queries.size() != 200) {
+        auto tokens = tokenise(strings[rng.gen()]);
+        if (tokens.back().size() < constants::MIN_CHARS_FOR_ONE_EDIT) continue;
+        uint32_t num_prefix_terms = std::min<uint32_t>(
+            tokens.size() - 1, queries.size() % 3);
+        std::string query;
+        std::vector<id_type> prefix;
+        for (uint32_t i = 0; i != num_prefix_terms; ++i) {
+            query += tokens[i] + " ";
+            prefix.push_back(testing::locate(terms, tokens[i]) - 1);
+        }
+        std::string suffix = add_typo(tokens.back(), rng);
+        if (suffix.empty()) continue;
+        query += suffix;
+
+        range_list ranges;
+        if (!fuzzy_locate_prefix(dict, string_to_byte_range(suffix),
+                                 constants::MAX_FUZZY_EDITS, ranges)) {
+            continue;
+        }
+
+        std::vector<id_type> topk;
+        for (auto const& doc : docs) {
+            auto const& term_ids = doc.second;
+            bool match =
+                std::any_of(term_ids.begin(), term_ids.end(),
+                            [&](id_type t) { return ranges.contains(t); });
+            for (auto t : prefix) {
+                match = match and std::binary_search(term_ids.begin(),
+                                                     term_ids.end(), t);
+            }
+            if (match) topk.push_back(doc.first);
+            if (topk.size() == k) break;
+        }
+
+        queries.push_back(query);
+        expected.push_back(topk);
+    }
+
+    {
+        ef_autocomplete_type1 index(params);
+        test_fuzzy_conjunctive_topk(index, queries, expected, k);
+    }
+    {
+        ef_autocomplete_type2 index(params);
+        test_fuzzy_conjunctive_topk(index, queries, expected, k);
+    }
+    {
+        ef_autocomplete_type3 index(params);
+        test_fuzzy_conjunctive_topk(index, queries, expected, k);
+    }
+    {
+        ef_autocomplete_type4 index(params, 0.0001);
+        test_fuzzy_conjunctive_topk(index, queries, expected, k);
+    }
+}
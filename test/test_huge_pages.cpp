@@ -0,0 +1,29 @@
+#include "test_common.hpp"
+#include "huge_pages.hpp"
+
+using namespace autocomplete;
+
+TEST_CASE("test huge_pages_advisor") {
+    /* 16 MiB, so that at least 7 huge pages are aligned within it */
+    uint64_t n = (uint64_t(16) << 20) * 8 / 20;
+    std::vector<uint64_t> values(n);
+    for (uint64_t i = 0; i != n; ++i) values[i] = (i * 13) % (1 << 20);
+    compact_vector cv;
+    cv.build(values.begin(), n, 20);
+
+    auto advisor = use_huge_pages(cv);
+    REQUIRE(advisor.advised_bytes() <= cv.bytes());
+    REQUIRE(advisor.collapsed_bytes() <= advisor.advised_bytes());
+    REQUIRE(advisor.advised_bytes() % huge_pages_advisor::HUGE_PAGE_SIZE == 0);
+
+    std::ifstream thp("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string mode;
+    std::getline(thp, mode);
+    if (mode.find("[never]") == std::string::npos and !mode.empty()) {
+        REQUIRE(advisor.advised_bytes() >=
+                7 * huge_pages_advisor::HUGE_PAGE_SIZE);
+    }
+
+    /* the data is not moved */
+    for (uint64_t i = 0; i != n; ++i) REQUIRE(cv[i] == values[i]);
+}
@@ -133,3 +133,90 @@ TEST_CASE("test inverted_index::intersection_iterator") {
         std::remove(output_filename);
     }
 }
+
+TEST_CASE("test top-k over a list of ranges") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    inverted_index_type index;
+    {
+        inverted_index_type::builder builder(params);
+        builder.build(index);
+    }
+
+    std::vector<std::vector<id_type>> lists(params.num_terms);
+    {
+        std::ifstream input((params.collection_basename + ".inverted").c_str(),
+                            std::ios_base::in);
+        for (auto& list : lists) {
+            uint32_t n = 0;
+            input >> n;
+            list.resize(n);
+            for (auto& x : list) input >> x;
+        }
+        input.close();
+    }
+
+    minimal_docids<cartesian_tree, inverted_index_type> minimal_docs_list;
+    {
+        std::vector<id_type> minimal_docids;
+        for (auto const& list : lists) minimal_docids.push_back(list.front());
+        minimal_docs_list.build(minimal_docids);
+    }
+
+    static const uint32_t k = 10;
+    essentials::uniform_int_rng<uint32_t> random(0, params.num_terms - 1, 13);
+    std::vector<id_type> topk_scores(constants::MAX_K);
+    for (uint32_t i = 0; i != 2000; ++i) {
+        /* up to 4 disjoint ranges of 0-based term ids */
+        std::vector<uint32_t> begins(1 + i % 4);
+        for (auto& x : begins) x = random.gen();
+        std::sort(begins.begin(), begins.end());
+        range_list ranges;
+        for (auto begin : begins) {
+            if (!ranges.empty() and ranges.back().end + 1 >= begin) continue;
+            uint64_t end = std::min<uint64_t>(begin + random.gen() % 100,
+                                              params.num_terms - 1);
+            ranges.push_back({begin, end});
+        }
+        /* make the ranges disjoint */
+        for (uint32_t j = 1; j < ranges.size(); ++j) {
+            if (ranges[j - 1].end >= ranges[j].begin) {
+                ranges[j - 1].end = ranges[j].begin - 1;
+            }
+        }
+
+        std::vector<id_type> expected;
+        for (auto r : ranges) {
+            for (uint64_t t = r.begin; t <= r.end; ++t) {
+                expected.insert(expected.end(), lists[t].begin(),
+                                lists[t].end());
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        expected.erase(std::unique(expected.begin(), expected.end()),
+                       expected.end());
+        if (expected.size() > k) expected.resize(k);
+
+        range_list exclusive_ranges = ranges;  // minimal_docids convention
+        for (auto& r : exclusive_ranges) r.end += 1;
+        uint32_t results = minimal_docs_list.topk(index, exclusive_ranges, k,
+                                                  topk_scores);
+        REQUIRE(results == expected.size());
+        for (uint32_t j = 0; j != results; ++j) {
+            REQUIRE(topk_scores[j] == expected[j]);
+        }
+
+        range_list term_id_ranges = ranges;  // 1-based term ids
+        for (auto& r : term_id_ranges) {
+            r.begin += 1;
+            r.end += 1;
+        }
+        results = heap_topk(index, term_id_ranges, k, topk_scores);
+        REQUIRE(results == expected.size());
+        for (uint32_t j = 0; j != results; ++j) {
+            REQUIRE(topk_scores[j] == expected[j]);
+        }
+    }
+}
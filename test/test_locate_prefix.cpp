@@ -62,6 +62,7 @@ TEST_CASE("test locate_prefix()") {
     static std::vector<uint32_t> query_terms = {1, 2, 3, 4, 5, 6, 7};
 
     completion_trie_type ct_index;
+    interleaved_completion_trie interleaved_index;
     integer_fc_dictionary_type fc_index;
 
     {
@@ -70,6 +71,12 @@ TEST_CASE("test locate_prefix()") {
         REQUIRE(ct_index.size() == params.num_completions);
     }
 
+    {
+        interleaved_completion_trie::builder builder(params);
+        builder.build(interleaved_index);
+        REQUIRE(interleaved_index.size() == params.num_completions);
+    }
+
     {
         integer_fc_dictionary_type::builder builder(params);
         builder.build(fc_index);
@@ -96,6 +103,7 @@ TEST_CASE("test locate_prefix()") {
             }
 
             test_locate_prefix(dict, ct_index, queries, strings);
+            test_locate_prefix(dict, interleaved_index, queries, strings);
             test_locate_prefix(dict, fc_index, queries, strings);
         }
     }
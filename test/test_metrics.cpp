@@ -0,0 +1,112 @@
+#include <thread>
+
+#include "test_common.hpp"
+#include "metrics.hpp"
+
+using namespace autocomplete;
+
+/* the value of the sample named name in the scraped text */
+double value(std::string const& scraped, std::string const& name) {
+    size_t pos = scraped.find("\n" + name + " ");
+    REQUIRE_MESSAGE(pos != std::string::npos, "no sample '" << name << "'");
+    return std::stod(scraped.substr(pos + name.size() + 2));
+}
+
+struct two_components {
+    template <typename F>
+    void for_each_component(F f) const {
+        f("first", 100);
+        f("second", 23);
+    }
+};
+
+TEST_CASE("test server_metrics") {
+    constexpr uint32_t num_threads = 4;
+    constexpr uint32_t num_queries = 10000;
+    server_metrics metrics;
+
+    /* the i-th query takes i % 100 microseconds and has i % 3 results */
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t != num_threads; ++t) {
+        threads.emplace_back([&] {
+            thread_metrics& local = metrics.local();
+            for (uint32_t i = 0; i != num_queries; ++i) {
+                local.record_query(i % 2, (i % 100) * 1000, i % 3, i % 5 == 0);
+                local.stages[1].record((i % 100) * 1000);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    std::string scraped = metrics.scrape(two_components());
+    double total = num_threads * num_queries;
+    REQUIRE(value(scraped, "autocomplete_queries_total{type=\"prefix\"}") ==
+            total / 2);
+    REQUIRE(value(scraped,
+                  "autocomplete_queries_total{type=\"conjunctive\"}") ==
+            total / 2);
+    /* the rate is computed by Prometheus from the counter */
+    REQUIRE(scraped.find("per_second") == std::string::npos);
+
+    uint64_t results = 0, empty = 0;
+    for (uint32_t i = 0; i != num_queries; ++i) {
+        results += i % 3;
+        empty += i % 3 == 0;
+    }
+    REQUIRE(value(scraped, "autocomplete_results_total") ==
+            num_threads * results);
+    REQUIRE(value(scraped, "autocomplete_empty_results_total") ==
+            num_threads * empty);
+    REQUIRE(value(scraped, "autocomplete_partial_results_total") == total / 5);
+
+    /* i % 100 <= 10 for 11 queries out of 100 */
+    std::string latency = "autocomplete_query_latency_seconds";
+    REQUIRE(value(scraped, latency + "_bucket{le=\"1e-05\"}") ==
+            total * 11 / 100);
+    REQUIRE(value(scraped, latency + "_bucket{le=\"+Inf\"}") == total);
+    REQUIRE(value(scraped, latency + "_count") == total);
+    std::string stage = "autocomplete_stage_latency_seconds_count{stage=";
+    REQUIRE(value(scraped, stage + "\"search\"}") == total);
+    REQUIRE(value(scraped, stage + "\"parse\"}") == 0);
+
+    REQUIRE(value(scraped, "autocomplete_index_bytes{component=\"first\"}") ==
+            100);
+    REQUIRE(value(scraped, "autocomplete_index_bytes{component=\"second\"}") ==
+            23);
+}
+
+TEST_CASE("test metrics_probe") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+    ef_autocomplete_type1 index(params);
+
+    std::vector<std::string> queries;
+    std::string filename =
+        params.collection_basename + ".queries/queries.length=2";
+    std::ifstream querylog(filename.c_str());
+    REQUIRE_MESSAGE(querylog.is_open(), "cannot open file '" << filename
+                                                             << "'");
+    load_queries(queries, 300, 0.25, querylog);
+
+    server_metrics metrics;
+    thread_metrics& local = metrics.local();
+    metrics_probe probe(local);
+    uint64_t reported = 0;
+    for (auto const& query : queries) {
+        reported += index.conjunctive_topk(query, 10, probe).size();
+    }
+
+    std::string scraped = metrics.scrape(index);
+    /* the queries whose terms are all found are searched and reported */
+    std::string stage = "autocomplete_stage_latency_seconds_count{stage=";
+    double searched = value(scraped, stage + "\"search\"}");
+    REQUIRE(value(scraped, stage + "\"parse\"}") == queries.size());
+    REQUIRE(searched > 0);
+    REQUIRE(searched <= queries.size());
+    REQUIRE(reported > 0);
+
+    size_t bytes = 0;
+    index.for_each_component([&](char const*, size_t b) { bytes += b; });
+    REQUIRE(bytes == index.bytes());
+}
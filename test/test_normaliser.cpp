@@ -0,0 +1,113 @@
+#include "test_common.hpp"
+
+using namespace autocomplete;
+
+std::string normalise(normaliser& n, std::string const& s) {
+    byte_range r = n(s);
+    return std::string(r.begin, r.end);
+}
+
+TEST_CASE("test normaliser") {
+    normaliser n;
+
+    std::vector<std::pair<std::string, std::string>> cases = {
+        {"", ""},
+        {"hello world", "hello world"},
+        {"Hello WORLD", "hello world"},
+        {"  two\t\tspaces  ", " two spaces "},
+        {"Crème Brûlée", "creme brulee"},
+        {"Straße STRASSE", "strasse strasse"},
+        {"Æsir Øresund Łódź Œuvre", "aesir oresund lodz oeuvre"},
+        {"ÀÉÎÕÜ àéîõü ÿ", "aeiou aeiou y"},
+        {"e\xcc\x81t\xc3\xa9", "ete"},  // combining acute accent
+        {"ＡＢＣ１２３", "abc123"},      // full-width forms
+        {"\xef\xac\x81le \xef\xac\x84", "file ffl"},  // ligatures
+        {"no\xc2\xa0" "break", "no break"},
+        {"ΆΣΠΡΟΣ άσπρος", "ασπροσ ασπροσ"},
+        {"Ёлка МОСКВА й", "елка москва и"},
+        {"日本語", "日本語"},  // kept as it is
+        {"bad \xff\xc3 bytes", "bad \xff\xc3 bytes"},
+        {"a-b/c", "a-b/c"},
+    };
+    for (auto const& c : cases) {
+        REQUIRE_MESSAGE(normalise(n, c.first) == c.second,
+                        "'" << c.first << "' was normalised to '"
+                            << normalise(n, c.first) << "' instead of '"
+                            << c.second << "'");
+        /* normalising is idempotent */
+        REQUIRE(normalise(n, c.second) == c.second);
+    }
+
+    normaliser with_separators("-/");
+    REQUIRE(normalise(with_separators, "a-b/c --d") == "a b c d");
+    REQUIRE_THROWS(normaliser("\xc3\xa9"));
+
+    /* longer inputs are truncated on a character boundary */
+    std::string s(normaliser::BUFFER_SIZE - 1, 'a');
+    REQUIRE(normalise(n, s + "é") == s);
+    REQUIRE(normalise(n, s + "éé") == s);
+    REQUIRE(normalise(n, s + "a") == s + "a");
+
+    /* characters: a, é, 日, 😀, then the invalid bytes one at a time */
+    std::string chars = "a\xc3\xa9\xe6\x97\xa5\xf0\x9f\x98\x80\xff\xc3";
+    auto p = reinterpret_cast<uint8_t const*>(chars.data());
+    auto end = p + chars.size();
+    std::vector<uint32_t> lengths;
+    for (; p != end; p += lengths.back()) {
+        lengths.push_back(normaliser::char_length(p, end));
+    }
+    std::vector<uint32_t> expected = {1, 2, 3, 4, 1, 1};
+    REQUIRE(lengths == expected);
+}
+
+TEST_CASE("test normalised queries") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    /* the test collection is normalised already */
+    {
+        normaliser n;
+        std::ifstream input(params.collection_basename.c_str(),
+                            std::ios_base::in);
+        std::string line;
+        while (std::getline(input, line)) {
+            std::string s = line.substr(line.find(' ') + 1);
+            REQUIRE(normalise(n, s) == s);
+        }
+    }
+
+    std::vector<std::string> queries;
+    {
+        std::ifstream querylog((params.collection_basename +
+                                ".queries/queries.length=2")
+                                   .c_str());
+        REQUIRE(querylog.is_open());
+        load_queries(queries, 300, 0.5, querylog);
+    }
+
+    ef_autocomplete_type1 index(params);
+    nop_probe probe;
+    for (auto const& query : queries) {
+        std::string upper = query;
+        for (auto& c : upper) c = std::toupper(c);
+        std::string spaced = "  " + upper;
+        size_t pos = upper.find(' ');
+        if (pos != std::string::npos) spaced.replace(pos + 2, 1, " \t ");
+
+        std::vector<id_type> expected;
+        auto it = index.conjunctive_topk(query, constants::MAX_K, probe);
+        for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+            expected.push_back((*it).score);
+        }
+        for (auto const& q : {upper, spaced}) {
+            it = index.conjunctive_topk(q, constants::MAX_K, probe);
+            REQUIRE_MESSAGE(it.size() == expected.size(),
+                            "got " << it.size() << " results for '" << q
+                                   << "' but expected " << expected.size());
+            for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+                REQUIRE((*it).score == expected[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#include <cstdio>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_common.hpp"
+#include "numa.hpp"
+
+using namespace autocomplete;
+
+TEST_CASE("test numa_topology") {
+    numa_topology numa;
+    REQUIRE(numa.num_nodes() > 0);
+
+    std::vector<bool> seen;
+    for (uint32_t node = 0; node != numa.num_nodes(); ++node) {
+        REQUIRE(!numa.cpus(node).empty());
+        for (auto cpu : numa.cpus(node)) {
+            if (cpu >= seen.size()) seen.resize(cpu + 1, false);
+            REQUIRE_MESSAGE(!seen[cpu], "cpu " << cpu << " in two nodes");
+            seen[cpu] = true;
+        }
+    }
+
+    cpu_set_t affinity;
+    sched_getaffinity(0, sizeof(affinity), &affinity);
+    for (uint32_t node = 0; node != numa.num_nodes(); ++node) {
+        /* the CPUs of a node may be all outside of our cpuset */
+        if (!numa.bind_to_node(node)) continue;
+        auto const& cpus = numa.cpus(node);
+        int cpu = sched_getcpu();
+        REQUIRE(std::find(cpus.begin(), cpus.end(), cpu) != cpus.end());
+    }
+    sched_setaffinity(0, sizeof(affinity), &affinity);
+}
+
+TEST_CASE("test numa_topology with gaps in the node ids") {
+    REQUIRE(numa_topology::parse_list("0-1,3\n") ==
+            std::vector<uint32_t>({0, 1, 3}));
+    REQUIRE(numa_topology::parse_list("5") == std::vector<uint32_t>({5}));
+    REQUIRE(numa_topology::parse_list("\n").empty());
+
+    /* node 1 is offline, node 3 has no CPU */
+    std::string root = testing::tmp_filename + ".node";
+    std::vector<std::pair<uint32_t, std::string>> nodes = {
+        {0, "0-1"}, {2, "2,4"}, {3, ""}, {4, "3"}};
+    mkdir(root.c_str(), 0755);
+    std::ofstream(root + "/online") << "0,2-4\n";
+    for (auto const& node : nodes) {
+        std::string dir = root + "/node" + std::to_string(node.first);
+        mkdir(dir.c_str(), 0755);
+        std::ofstream(dir + "/cpulist") << node.second << "\n";
+    }
+
+    numa_topology numa(root);
+    REQUIRE(numa.num_nodes() == 3);
+    REQUIRE(numa.id(0) == 0);
+    REQUIRE(numa.id(1) == 2);
+    REQUIRE(numa.id(2) == 4);
+    REQUIRE(numa.cpus(1) == std::vector<uint32_t>({2, 4}));
+    REQUIRE(numa.cpus(2) == std::vector<uint32_t>({3}));
+
+    for (auto const& node : nodes) {
+        std::string dir = root + "/node" + std::to_string(node.first);
+        std::remove((dir + "/cpulist").c_str());
+        rmdir(dir.c_str());
+    }
+    std::remove((root + "/online").c_str());
+    rmdir(root.c_str());
+}
+
+/* the threads of a node share its replica, each with its own context */
+TEST_CASE("test index shared by threads") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+    ef_autocomplete_type1 index(params);
+
+    std::vector<std::string> queries;
+    std::string filename = params.collection_basename +
+                           ".queries/queries.length=3";
+    std::ifstream querylog(filename.c_str());
+    REQUIRE_MESSAGE(querylog.is_open(), "cannot open file '" << filename
+                                                             << "'");
+    load_queries(queries, 300, 0.25, querylog);
+
+    constexpr uint32_t k = 7;
+    nop_probe probe;
+    std::vector<std::vector<id_type>> expected;
+    for (auto const& query : queries) {
+        auto it = index.conjunctive_topk(query, k, probe);
+        expected.emplace_back();
+        for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+            expected.back().push_back((*it).score);
+        }
+    }
+
+    constexpr uint32_t num_threads = 4;
+    std::vector<uint64_t> mismatches(num_threads, 0);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t != num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            ef_autocomplete_type1::query_context ctx;
+            nop_probe probe;
+            ef_autocomplete_type1 const& shared = index;
+            for (uint32_t run = 0; run != 10; ++run) {
+                for (size_t q = 0; q != queries.size(); ++q) {
+                    auto it = shared.conjunctive_topk(ctx, queries[q], k,
+                                                      probe);
+                    bool equal = it.size() == expected[q].size();
+                    for (uint32_t i = 0; equal and i != it.size(); ++i, ++it) {
+                        equal = (*it).score == expected[q][i];
+                    }
+                    mismatches[t] += !equal;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    for (auto m : mismatches) REQUIRE(m == 0);
+}
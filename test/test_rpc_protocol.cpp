@@ -0,0 +1,194 @@
+#include "test_common.hpp"
+#include "rpc_protocol.hpp"
+
+using namespace autocomplete;
+
+typedef ef_autocomplete_type1 index_type;
+
+struct result {
+    id_type doc_id;
+    std::string string;
+};
+
+std::vector<result> topk(index_type& index, std::string const& query,
+                         uint32_t k, rpc::query_mode mode) {
+    nop_probe probe;
+    auto it = mode == rpc::query_mode::prefix
+                  ? index.prefix_topk(query, k, probe)
+                  : index.conjunctive_topk(query, k, probe);
+    std::vector<result> results;
+    for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+        auto sbr = *it;
+        results.push_back(
+            {sbr.score, std::string(sbr.string.begin, sbr.string.end)});
+    }
+    return results;
+}
+
+byte_range as_bytes(std::string const& s, size_t begin, size_t end) {
+    uint8_t const* data = reinterpret_cast<uint8_t const*>(s.data());
+    return {data + begin, data + end};
+}
+
+TEST_CASE("test rpc protocol") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+    index_type index(params);
+
+    std::vector<std::string> queries;
+    for (uint32_t num_terms = 1; num_terms <= 3; ++num_terms) {
+        std::string filename =
+            params.collection_basename +
+            ".queries/queries.length=" + std::to_string(num_terms);
+        std::ifstream querylog(filename.c_str());
+        REQUIRE_MESSAGE(querylog.is_open(),
+                        "cannot open file '" << filename << "'");
+        load_queries(queries, 100, 0.25, querylog);
+    }
+
+    /* a batch of queries per request, all the requests pipelined */
+    constexpr uint32_t k = 7;
+    constexpr uint32_t batch_size = 16;
+    std::string requests;
+    uint32_t num_requests = 0;
+    for (size_t i = 0; i < queries.size(); i += batch_size) {
+        rpc::frame_writer request(requests, num_requests++);
+        for (size_t j = i; j != std::min(i + batch_size, queries.size());
+             ++j) {
+            request.add_query(j % 2 ? rpc::query_mode::conjunctive
+                                    : rpc::query_mode::prefix,
+                              k, queries[j]);
+        }
+        request.finish();
+    }
+
+    /* the bytes are received a few at a time: a frame is answered only
+       when complete */
+    std::string query;
+    std::string responses;
+    size_t begin = 0;
+    for (size_t end = 0; end != requests.size();) {
+        end = std::min<size_t>(end + 5, requests.size());
+        while (size_t size = rpc::frame_size(as_bytes(requests, begin, end))) {
+            rpc::answer(index, as_bytes(requests, begin, begin + size), query,
+                        responses);
+            begin += size;
+        }
+    }
+    REQUIRE(begin == requests.size());
+
+    size_t q = 0;
+    begin = 0;
+    for (uint32_t id = 0; id != num_requests; ++id) {
+        size_t size =
+            rpc::frame_size(as_bytes(responses, begin, responses.size()));
+        REQUIRE(size > 0);
+        rpc::response_reader response(
+            as_bytes(responses, begin, begin + size));
+        begin += size;
+        REQUIRE(response.id() == id);
+        for (uint32_t i = 0; i != response.num_queries(); ++i, ++q) {
+            auto mode = q % 2 ? rpc::query_mode::conjunctive
+                              : rpc::query_mode::prefix;
+            auto expected = topk(index, queries[q], k, mode);
+            auto got = response.next();
+            REQUIRE(!got.partial);
+            REQUIRE_MESSAGE(got.size == expected.size(),
+                            "got " << got.size << " results for '"
+                                   << queries[q] << "' but expected "
+                                   << expected.size());
+            for (uint32_t j = 0; j != got.size; ++j) {
+                auto string = got.string(j);
+                REQUIRE(got.doc_id(j) == expected[j].doc_id);
+                REQUIRE(std::string(string.begin, string.end) ==
+                        expected[j].string);
+            }
+        }
+    }
+    REQUIRE(q == queries.size());
+    REQUIRE(begin == responses.size());
+}
+
+TEST_CASE("test rpc protocol errors") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+    index_type index(params);
+    std::string query;
+    std::string response;
+
+    /* the integers are little-endian, whatever the host */
+    std::string request;
+    rpc::write<uint32_t>(request, 0x01020304);
+    rpc::write<uint16_t>(request, 0x0506);
+    REQUIRE(request == std::string("\x04\x03\x02\x01\x06\x05", 6));
+
+    request.clear();
+    rpc::write<uint32_t>(request, rpc::max_frame_bytes + 1);
+    REQUIRE_THROWS(rpc::frame_size(as_bytes(request, 0, request.size())));
+
+    /* a frame announcing more queries than it carries */
+    request.clear();
+    rpc::frame_writer truncated(request, 0);
+    truncated.add_query(rpc::query_mode::prefix, 10, "a");
+    truncated.finish();
+    request[8] = 2;
+    REQUIRE_THROWS(rpc::answer(index, as_bytes(request, 0, request.size()),
+                               query, response));
+
+    /* a query with k = 0 has no results, and the next one is answered */
+    request.clear();
+    rpc::frame_writer zero_k(request, 3);
+    zero_k.add_query(rpc::query_mode::conjunctive, 0, "a");
+    zero_k.add_query(rpc::query_mode::prefix, 0, "b");
+    zero_k.add_query(rpc::query_mode::prefix, 10, "a");
+    zero_k.finish();
+    rpc::answer(index, as_bytes(request, 0, request.size()), query, response);
+    {
+        rpc::response_reader reader(as_bytes(response, 0, response.size()));
+        REQUIRE(reader.id() == 3);
+        REQUIRE(reader.num_queries() == 3);
+        for (uint32_t i = 0; i != 2; ++i) {
+            auto got = reader.next();
+            REQUIRE(!got.partial);
+            REQUIRE(got.size == 0);
+        }
+        auto got = reader.next();
+        REQUIRE(got.size ==
+                topk(index, "a", 10, rpc::query_mode::prefix).size());
+    }
+    response.clear();
+
+    /* a query too long is rejected, and the next one is answered */
+    request.clear();
+    std::string longest(constants::MAX_NUM_CHARS_PER_QUERY, 'a');
+    rpc::frame_writer too_long(request, 4);
+    too_long.add_query(rpc::query_mode::prefix, 10, longest + "a");
+    too_long.add_query(rpc::query_mode::prefix, 10, longest);
+    too_long.add_query(rpc::query_mode::prefix, 10, "a");
+    too_long.finish();
+    rpc::answer(index, as_bytes(request, 0, request.size()), query, response);
+    {
+        rpc::response_reader reader(as_bytes(response, 0, response.size()));
+        REQUIRE(reader.id() == 4);
+        REQUIRE(reader.num_queries() == 3);
+        auto got = reader.next();
+        REQUIRE(got.error);
+        REQUIRE(got.size == 0);
+        got = reader.next();
+        REQUIRE(!got.error);
+        got = reader.next();
+        REQUIRE(!got.error);
+        REQUIRE(got.size ==
+                topk(index, "a", 10, rpc::query_mode::prefix).size());
+    }
+    response.clear();
+
+    request.clear();
+    rpc::frame_writer unknown_mode(request, 0);
+    unknown_mode.add_query(rpc::query_mode(7), 10, "a");
+    unknown_mode.finish();
+    REQUIRE_THROWS(rpc::answer(index, as_bytes(request, 0, request.size()),
+                               query, response));
+}
@@ -0,0 +1,196 @@
+#include "test_common.hpp"
+
+using namespace autocomplete;
+
+/*
+A conjunctive query that runs out of budget must report the first
+results of the same query without budget, and be flagged as partial
+if it reports fewer of them.
+*/
+template <typename Index>
+uint64_t test_search_budget(Index& index,
+                            std::vector<std::string> const& queries,
+                            const uint64_t max_postings) {
+    constexpr uint32_t k = 10;
+    nop_probe probe;
+    uint64_t partial = 0;
+    for (auto const& query : queries) {
+        index.set_search_budget(search_budget());
+        auto it = index.conjunctive_topk(query, k, probe);
+        REQUIRE(!index.partial());
+        std::vector<id_type> expected;
+        for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+            expected.push_back((*it).score);
+        }
+
+        index.set_search_budget(search_budget(max_postings));
+        it = index.conjunctive_topk(query, k, probe);
+        REQUIRE_MESSAGE(it.size() <= expected.size(),
+                        "got " << it.size() << " results for '" << query
+                               << "' but expected at most "
+                               << expected.size());
+        if (!index.partial()) {
+            REQUIRE_MESSAGE(it.size() == expected.size(),
+                            "got " << it.size() << " results for '" << query
+                                   << "' but expected " << expected.size());
+        }
+        partial += index.partial();
+        for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+            REQUIRE_MESSAGE((*it).score == expected[i],
+                            "got doc_id " << (*it).score << " for '" << query
+                                          << "' but expected " << expected[i]);
+        }
+    }
+    index.set_search_budget(search_budget());
+    return partial;
+}
+
+template <typename Index>
+void test_search_budget(Index& index, parameters const& params) {
+    for (uint32_t num_terms = 2; num_terms <= 3; ++num_terms) {
+        std::vector<std::string> queries;
+        std::string filename =
+            params.collection_basename +
+            ".queries/queries.length=" + std::to_string(num_terms);
+        std::ifstream querylog(filename.c_str());
+        REQUIRE_MESSAGE(querylog.is_open(),
+                        "cannot open file '" << filename << "'");
+        load_queries(queries, 300, 0.25, querylog);
+        querylog.close();
+        REQUIRE(test_search_budget(index, queries, 1) > 0);
+        for (uint64_t max_postings : {8, 64, 1024}) {
+            test_search_budget(index, queries, max_postings);
+        }
+    }
+}
+
+TEST_CASE("test search_budget") {
+    search_budget unlimited;
+    REQUIRE(unlimited.unlimited());
+    for (uint32_t i = 0; i != 10000; ++i) REQUIRE(unlimited.spend());
+    REQUIRE(!unlimited.partial());
+
+    search_budget budget(3);
+    for (uint32_t run = 0; run != 2; ++run) {
+        budget.start();
+        for (uint32_t i = 0; i != 3; ++i) REQUIRE(budget.spend());
+        REQUIRE(!budget.partial());
+        REQUIRE(!budget.spend());
+        REQUIRE(budget.partial());
+        REQUIRE(budget.postings() == 3);
+    }
+
+    /* the clock is read after the first CLOCK_INTERVAL postings */
+    search_budget expired(search_budget::UNLIMITED, 0);
+    for (uint32_t i = 0; i != search_budget::CLOCK_INTERVAL; ++i) {
+        REQUIRE(expired.spend());
+    }
+    REQUIRE(!expired.spend());
+    REQUIRE(expired.partial());
+}
+
+/*
+The budget must bound an intersection that visits many postings but finds
+few doc_ids: the pair of terms, among the ones with the longest lists,
+with the fewest doc_ids in common per posting visited.
+*/
+TEST_CASE("test search_budget on a sparse intersection") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    ef_inverted_index::builder builder(params);
+    ef_inverted_index index;
+    builder.build(index);
+
+    auto size = [&](id_type t) { return index.iterator(t - 1).size(); };
+    constexpr uint32_t num_longest = 32;
+    std::vector<id_type> terms(index.num_terms());
+    std::iota(terms.begin(), terms.end(), 1);
+    std::partial_sort(
+        terms.begin(), terms.begin() + num_longest, terms.end(),
+        [&](id_type l, id_type r) { return size(l) > size(r); });
+
+    ef_inverted_index::intersection_iterator_type it;
+    auto intersect = [&](std::vector<id_type> const& q,
+                         search_budget& budget) {
+        budget.start();
+        index.intersection_iterator(q, it, 0, &budget);
+        uint64_t n = 0;
+        for (; it.has_next(); ++it) ++n;
+        return n;
+    };
+
+    std::vector<id_type> sparse;
+    uint64_t num_docs = 0;
+    uint64_t num_postings = 0;
+    for (uint32_t i = 0; i != num_longest; ++i) {
+        for (uint32_t j = i + 1; j != num_longest; ++j) {
+            std::vector<id_type> q = {std::min(terms[i], terms[j]),
+                                      std::max(terms[i], terms[j])};
+            search_budget unlimited;
+            uint64_t n = intersect(q, unlimited);
+            REQUIRE(!unlimited.partial());
+            if (sparse.empty() or
+                n * num_postings < num_docs * unlimited.postings()) {
+                sparse = q;
+                num_docs = n;
+                num_postings = unlimited.postings();
+            }
+        }
+    }
+    REQUIRE(num_docs < num_postings / 2);
+
+    /* more postings than the doc_ids found: spent by the iterator */
+    search_budget budget(num_postings / 2);
+    intersect(sparse, budget);
+    REQUIRE(budget.partial());
+    REQUIRE(budget.postings() == num_postings / 2);
+
+    REQUIRE(num_postings > search_budget::CLOCK_INTERVAL);
+    search_budget expired(search_budget::UNLIMITED, 0);
+    intersect(sparse, expired);
+    REQUIRE(expired.partial());
+    REQUIRE(expired.postings() == search_budget::CLOCK_INTERVAL);
+}
+
+/*
+A single-term query of ef_type3 merges the lists of all the terms of its
+range, without intersecting them: the merge must spend the budget too.
+*/
+TEST_CASE("test ef_type3 single-term conjunctive_topk with a search budget") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    ef_autocomplete_type3 index(params);
+    std::vector<std::string> queries;
+    for (char c = 'a'; c <= 'z'; ++c) queries.emplace_back(1, c);
+    REQUIRE(test_search_budget(index, queries, 1) > 0);
+    for (uint64_t max_postings : {8, 64, 1024}) {
+        test_search_budget(index, queries, max_postings);
+    }
+}
+
+TEST_CASE("test autocomplete conjunctive_topk with a search budget") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    {
+        ef_autocomplete_type1 index(params);
+        test_search_budget(index, params);
+    }
+    {
+        ef_autocomplete_type2 index(params);
+        test_search_budget(index, params);
+    }
+    {
+        ef_autocomplete_type3 index(params);
+        test_search_budget(index, params);
+    }
+    {
+        ef_autocomplete_type4 index(params, 0.0001);
+        test_search_budget(index, params);
+    }
+}
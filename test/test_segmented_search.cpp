@@ -0,0 +1,100 @@
+#include "test_common.hpp"
+#include "segmented_search.hpp"
+
+using namespace autocomplete;
+
+TEST_CASE("test segmented_topk") {
+    constexpr uint64_t num_docs = 100000;
+    constexpr uint32_t k = 10;
+    auto pool = std::make_shared<search_pool>(3);
+    std::vector<id_type> topk_scores(k);
+
+    /* the results are the multiples of step, from first */
+    for (id_type first : {0, 5000, 51234, 99990}) {
+        for (id_type step : {1, 7, 1000, 30000}) {
+            std::vector<id_type> expected;
+            for (id_type doc_id = first;
+                 doc_id < num_docs and expected.size() != k; ++doc_id) {
+                if (doc_id % step == 0) expected.push_back(doc_id);
+            }
+            for (uint32_t num_segments : {1, 2, 8, 64}) {
+                segmented_buffers buffers;
+                buffers.resize(num_segments);
+                auto search = [&](uint32_t, id_type begin, id_type end,
+                                  id_type* out, auto stop) {
+                    uint32_t results = 0;
+                    for (id_type doc_id = std::max(begin, first);
+                         doc_id < end and !stop(); ++doc_id) {
+                        if (doc_id % step != 0) continue;
+                        out[results++] = doc_id;
+                        if (results == k) break;
+                    }
+                    return results;
+                };
+                uint32_t results = segmented_topk(*pool, num_docs, k, buffers,
+                                                  topk_scores, search);
+                REQUIRE(results == expected.size());
+                for (uint32_t i = 0; i != results; ++i) {
+                    REQUIRE(topk_scores[i] == expected[i]);
+                }
+            }
+        }
+    }
+}
+
+template <typename Index>
+void test_parallel_conjunctive_topk(Index& index,
+                                    std::vector<std::string> const& queries) {
+    constexpr uint32_t k = 7;
+    nop_probe probe;
+    std::vector<std::vector<id_type>> expected;
+    for (auto const& query : queries) {
+        auto it = index.conjunctive_topk(query, k, probe);
+        expected.emplace_back();
+        for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+            expected.back().push_back((*it).score);
+        }
+    }
+
+    /* with min_candidates = 0, all the queries are heavy,
+       but the ones with more suffix lists than candidates */
+    auto pool = std::make_shared<search_pool>(3);
+    index.set_parallelism(intra_query_parallelism(pool, 16, 0));
+    for (size_t q = 0; q != queries.size(); ++q) {
+        auto it = index.conjunctive_topk(queries[q], k, probe);
+        REQUIRE_MESSAGE(it.size() == expected[q].size(),
+                        "got " << it.size() << " results for '" << queries[q]
+                               << "' but expected " << expected[q].size());
+        for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+            REQUIRE((*it).score == expected[q][i]);
+        }
+    }
+    REQUIRE(index.parallel_queries() > 0);
+    index.set_parallelism(intra_query_parallelism());
+}
+
+TEST_CASE("test parallel conjunctive_topk") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    std::vector<std::string> queries;
+    for (uint32_t num_terms = 2; num_terms <= 4; ++num_terms) {
+        std::string filename =
+            params.collection_basename +
+            ".queries/queries.length=" + std::to_string(num_terms);
+        std::ifstream querylog(filename.c_str());
+        REQUIRE_MESSAGE(querylog.is_open(),
+                        "cannot open file '" << filename << "'");
+        load_queries(queries, 300, 0.25, querylog);
+    }
+
+    {
+        ef_autocomplete_type3 index(params);
+        test_parallel_conjunctive_topk(index, queries);
+    }
+    {
+        ef_autocomplete_type4 index(params, 0.0001);
+        test_parallel_conjunctive_topk(index, queries);
+    }
+}
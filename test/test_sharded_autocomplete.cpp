@@ -0,0 +1,133 @@
+#include "test_common.hpp"
+#include "sharded_autocomplete.hpp"
+
+using namespace autocomplete;
+
+typedef ef_autocomplete_type1 index_type;
+
+struct result {
+    id_type doc_id;
+    std::string string;
+};
+
+template <typename Index>
+std::vector<result> topk(Index& index, std::string const& query, uint32_t k,
+                         bool conjunctive) {
+    nop_probe probe;
+    auto it = conjunctive ? index.conjunctive_topk(query, k, probe)
+                          : index.prefix_topk(query, k, probe);
+    std::vector<result> results;
+    for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+        auto sbr = *it;
+        results.push_back(
+            {sbr.score, std::string(sbr.string.begin, sbr.string.end)});
+    }
+    return results;
+}
+
+/*
+A shard is a copy of the same index, whose i-th doc_id is mapped to
+shard_doc_id(s, i) in shard s: the expected results are the ones of the
+index, mapped in the same way, merged by doc_id.
+*/
+template <typename ShardDocId>
+void test_sharded(std::vector<std::string> const& queries,
+                  uint32_t num_shards, ShardDocId shard_doc_id) {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    index_type index;
+    essentials::load(index, testing::tmp_filename.c_str());
+    sharded_autocomplete<index_type> sharded;
+    for (uint32_t s = 0; s != num_shards; ++s) {
+        std::vector<id_type> doc_ids(params.universe);
+        for (id_type i = 0; i != params.universe; ++i) {
+            doc_ids[i] = shard_doc_id(s, i);
+        }
+        sharded.add_shard(testing::tmp_filename, std::move(doc_ids));
+    }
+    REQUIRE(sharded.num_shards() == num_shards);
+
+    constexpr uint32_t k = 7;
+    for (bool conjunctive : {false, true}) {
+        for (auto const& query : queries) {
+            std::vector<result> expected;
+            for (auto const& r : topk(index, query, k, conjunctive)) {
+                for (uint32_t s = 0; s != num_shards; ++s) {
+                    expected.push_back({shard_doc_id(s, r.doc_id), r.string});
+                }
+            }
+            std::sort(expected.begin(), expected.end(),
+                      [](result const& x, result const& y) {
+                          return x.doc_id < y.doc_id;
+                      });
+            if (expected.size() > k) expected.resize(k);
+
+            auto got = topk(sharded, query, k, conjunctive);
+            REQUIRE_MESSAGE(got.size() == expected.size(),
+                            "got " << got.size() << " results for '" << query
+                                   << "' but expected " << expected.size());
+            for (uint32_t i = 0; i != got.size(); ++i) {
+                REQUIRE(got[i].doc_id == expected[i].doc_id);
+                REQUIRE(got[i].string == expected[i].string);
+            }
+        }
+    }
+}
+
+TEST_CASE("test sharded_autocomplete") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+    {
+        index_type index(params);
+        essentials::save<index_type>(index, testing::tmp_filename.c_str());
+    }
+
+    std::vector<std::string> queries;
+    for (uint32_t num_terms = 1; num_terms <= 3; ++num_terms) {
+        std::string filename =
+            params.collection_basename +
+            ".queries/queries.length=" + std::to_string(num_terms);
+        std::ifstream querylog(filename.c_str());
+        REQUIRE_MESSAGE(querylog.is_open(),
+                        "cannot open file '" << filename << "'");
+        load_queries(queries, 100, 0.25, querylog);
+    }
+
+    /* the results of the shards alternate */
+    test_sharded(queries, 2,
+                 [](uint32_t s, id_type i) { return 2 * i + s; });
+
+    /* as with the "range" policy: the results of the first shard come
+       first, so that it is enough for the queries with k results there */
+    id_type universe = params.universe;
+    test_sharded(queries, 3, [=](uint32_t s, id_type i) {
+        return s * universe + i;
+    });
+
+    std::remove(testing::tmp_filename.c_str());
+}
+
+TEST_CASE("test shard_partitioner") {
+    constexpr uint32_t num_shards = 4;
+    constexpr uint64_t universe = 1000;
+    for (std::string policy : {"range", "hash"}) {
+        shard_partitioner partitioner(policy, num_shards, universe);
+        std::vector<uint32_t> sizes(num_shards, 0);
+        uint32_t prev = 0;
+        for (id_type doc_id = 0; doc_id != universe; ++doc_id) {
+            uint32_t s = partitioner(doc_id);
+            REQUIRE(s < num_shards);
+            if (policy == "range") {
+                REQUIRE(s >= prev);
+                prev = s;
+            }
+            ++sizes[s];
+        }
+        for (auto size : sizes) REQUIRE(size > universe / num_shards / 2);
+    }
+    REQUIRE_THROWS(shard_partitioner("random", num_shards, universe));
+    REQUIRE_THROWS(shard_partitioner("range", 0, universe));
+}
@@ -0,0 +1,136 @@
+#include <atomic>
+#include <thread>
+
+#include "test_common.hpp"
+
+using namespace autocomplete;
+
+/*
+Delete every other result of a top-MAX_K query: a top-k query, with
+k < MAX_K, must then return the first k results that are still alive.
+*/
+template <typename Index>
+void test_tombstones(Index& index, std::vector<std::string> const& queries,
+                     bool conjunctive) {
+    constexpr uint32_t k = 5;
+    nop_probe probe;
+    for (auto const& query : queries) {
+        index.set_tombstones(std::make_shared<const tombstone_set>());
+        auto it = conjunctive
+                      ? index.conjunctive_topk(query, constants::MAX_K, probe)
+                      : index.prefix_topk(query, constants::MAX_K, probe);
+
+        std::vector<id_type> deleted;
+        std::vector<id_type> expected;
+        for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+            auto doc_id = (*it).score;
+            if (i % 2 == 0) {
+                deleted.push_back(doc_id);
+            } else {
+                expected.push_back(doc_id);
+            }
+        }
+        if (expected.size() > k) expected.resize(k);
+
+        index.set_tombstones(std::make_shared<const tombstone_set>(deleted));
+        it = conjunctive ? index.conjunctive_topk(query, k, probe)
+                         : index.prefix_topk(query, k, probe);
+
+        REQUIRE_MESSAGE(it.size() == expected.size(),
+                        "got " << it.size() << " results for '" << query
+                               << "' but expected " << expected.size());
+        for (uint32_t i = 0; i != it.size(); ++i, ++it) {
+            REQUIRE_MESSAGE((*it).score == expected[i],
+                            "got doc_id " << (*it).score << " for '" << query
+                                          << "' but expected " << expected[i]);
+        }
+    }
+    index.set_tombstones(std::make_shared<const tombstone_set>());
+}
+
+template <typename Index>
+void test_tombstones(Index& index, parameters const& params) {
+    for (uint32_t num_terms = 1; num_terms <= 3; ++num_terms) {
+        std::vector<std::string> queries;
+        std::string filename =
+            params.collection_basename +
+            ".queries/queries.length=" + std::to_string(num_terms);
+        std::ifstream querylog(filename.c_str());
+        REQUIRE_MESSAGE(querylog.is_open(),
+                        "cannot open file '" << filename << "'");
+        load_queries(queries, 300, 0.25, querylog);
+        querylog.close();
+        test_tombstones(index, queries, false);
+        test_tombstones(index, queries, true);
+    }
+}
+
+TEST_CASE("test tombstone_set") {
+    std::vector<id_type> doc_ids = {3, 10, 64, 65, 1000};
+    tombstone_set deleted(doc_ids);
+    REQUIRE(deleted.size() == doc_ids.size());
+    for (id_type doc_id = 0; doc_id != 2000; ++doc_id) {
+        bool expected = std::find(doc_ids.begin(), doc_ids.end(), doc_id) !=
+                        doc_ids.end();
+        REQUIRE(deleted.contains(doc_id) == expected);
+    }
+    REQUIRE(!tombstone_set::empty_set().contains(0));
+}
+
+/*
+Readers take snapshots while a writer replaces the set: every snapshot
+must see a whole set, never an older one than a previous snapshot of its
+thread, and the replaced sets are released (see the sanitizers).
+*/
+TEST_CASE("test tombstones replaced while read") {
+    constexpr id_type num_sets = 2000;
+    tombstones current;
+    current.store(std::make_shared<const tombstone_set>(
+        std::vector<id_type>{0}));
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> errors(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t != 4; ++t) {
+        readers.emplace_back([&] {
+            id_type last = 0;
+            while (!done.load()) {
+                auto deleted = current.load();
+                id_type id = last;
+                while (id != num_sets and !deleted->contains(id)) ++id;
+                if (deleted->size() != 1 or id == num_sets) ++errors;
+                last = id;
+            }
+        });
+    }
+    for (id_type id = 1; id != num_sets; ++id) {
+        current.store(std::make_shared<const tombstone_set>(
+            std::vector<id_type>{id}));
+    }
+    done.store(true);
+    for (auto& t : readers) t.join();
+    REQUIRE(errors.load() == 0);
+    REQUIRE(current.load()->contains(num_sets - 1));
+}
+
+TEST_CASE("test autocomplete topk functions with tombstones") {
+    parameters params;
+    params.collection_basename = testing::test_filename.c_str();
+    params.load();
+
+    {
+        ef_autocomplete_type1 index(params);
+        test_tombstones(index, params);
+    }
+    {
+        ef_autocomplete_type2 index(params);
+        test_tombstones(index, params);
+    }
+    {
+        ef_autocomplete_type3 index(params);
+        test_tombstones(index, params);
+    }
+    {
+        ef_autocomplete_type4 index(params, 0.0001);
+        test_tombstones(index, params);
+    }
+}
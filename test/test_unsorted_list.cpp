@@ -169,4 +169,61 @@ TEST_CASE("test unsorted_list on minimal doc_ids") {
 
         std::remove(output_filename);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("test sparse_table_rmq") {
+    char const* output_filename = testing::tmp_filename.c_str();
+    essentials::uniform_int_rng<uint32_t> rng(0, 1000, 13);
+
+    /* around the block boundaries, with many ties */
+    for (uint64_t n : {1, 2, 63, 64, 65, 128, 129, 1000, 5000}) {
+        std::vector<id_type> values(n);
+        for (auto& x : values) x = rng.gen();
+
+        sparse_table_rmq rmq;
+        rmq.build(values, std::less<id_type>());
+        cartesian_tree tree;
+        tree.build(values, std::less<id_type>());
+        REQUIRE(rmq.size() == n);
+
+        for (uint64_t a = 0; a < n; a += 1 + a / 8) {
+            uint64_t expected = a;
+            for (uint64_t b = a; b != n; ++b) {
+                if (values[b] < values[expected]) expected = b;
+                uint64_t pos = rmq.rmq(a, b);
+                REQUIRE_MESSAGE(pos == expected, "rmq(" << a << ", " << b
+                                                        << ") = " << pos
+                                                        << " instead of "
+                                                        << expected);
+                REQUIRE(pos == tree.rmq(a, b));
+            }
+        }
+    }
+
+    /* top-k queries, after a round trip to disk */
+    std::vector<id_type> doc_ids(10000);
+    std::iota(doc_ids.begin(), doc_ids.end(), 0);
+    std::shuffle(doc_ids.begin(), doc_ids.end(), std::mt19937_64(13));
+    {
+        unsorted_list<sparse_table_rmq> list;
+        list.build(doc_ids);
+        essentials::save<unsorted_list<sparse_table_rmq>>(list,
+                                                         output_filename);
+    }
+
+    unsorted_list<sparse_table_rmq> list;
+    essentials::load(list, output_filename);
+    constexpr uint32_t k = 10;
+    std::vector<id_type> topk(constants::MAX_K);
+    std::vector<id_type> expected(doc_ids.size());
+    for (auto q : gen_random_queries(5000, doc_ids.size())) {
+        uint32_t expected_results = naive_topk(doc_ids, q, k, expected);
+        uint32_t results = list.topk(q, k, topk);
+        REQUIRE(results == expected_results);
+        for (uint32_t i = 0; i != results; ++i) {
+            REQUIRE(topk[i] == expected[i]);
+        }
+    }
+
+    std::remove(output_filename);
+}